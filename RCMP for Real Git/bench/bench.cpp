@@ -0,0 +1,736 @@
+//
+//  bench.cpp
+//  RCMP for Real Git
+//
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#include <git2.h>
+#include <libAmy/libAmy.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "../git_hook.h"
+#include "../timing.h"
+#include "receiver.h"
+using namespace std;
+
+
+/*!
+ \brief the ID git gives the old side of a push that creates a ref
+ */
+static const char zero_id[] = "0000000000000000000000000000000000000000";
+
+
+/*!
+ \brief a push for the hook to handle, as git would give it on stdin
+ */
+struct push
+{
+	char old_id[41];
+	char new_id[41];
+	char ref[256];
+};
+
+
+/*!
+ \brief the same numbers every time, so the same repos come out every time
+ */
+class sequence
+{
+public:
+	sequence(uint32_t seed) : state(seed ? seed : 1) {}
+	
+	uint32_t next(uint32_t below)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state % below;
+	}
+
+private:
+	uint32_t state;
+};
+
+
+/*!
+ \brief the directories of a commit's tree, and the tree itself
+ */
+struct tree_state
+{
+	vector<git_oid> dirs;
+	vector<bool> used;
+	git_oid root;
+	bool have_root;
+};
+
+
+/*!
+ \brief writes a repository of a known shape straight into its object store
+ 
+ Files live in numbered directories one level down, which is enough to make
+ tree diffs skip what didn't change the way they do in real repos.  Changes
+ are staged with write and go into the next commit.
+ */
+class synthetic_repo
+{
+public:
+	synthetic_repo(const string &path) : repo(NULL), when(1350000000), author(NULL)
+	{
+		state.have_root = false;
+		
+		if(git_repository_init(&repo, path.c_str(), 1) != 0)
+			repo = NULL;
+		else
+			git_signature_new(&author, "A. U. Thor", "author@example.com", when, 0);
+	}
+	
+	~synthetic_repo()
+	{
+		if(author != NULL) git_signature_free(author);
+		if(repo != NULL) git_repository_free(repo);
+	}
+	
+	bool ok() const { return repo != NULL && author != NULL; }
+	
+	/*!
+	 \brief stage a new version of a file
+	 \param dir		which directory it's in
+	 \param file		which file it is in there
+	 \param version	anything that makes this version different
+	 \param lines		how long it is
+	 */
+	void write(size_t dir, size_t file, unsigned version, unsigned lines)
+	{
+		char name[32];
+		string content;
+		git_oid blob;
+		
+		for(unsigned line = 0; line < lines; line++)
+		{
+			char text[96];
+			snprintf(text, sizeof(text), "file %lu of directory %lu, line %u of version %u\n",
+				 (unsigned long)file, (unsigned long)dir, line, version);
+			content += text;
+		}
+		
+		if(dir >= state.dirs.size())
+		{
+			state.dirs.resize(dir + 1);
+			state.used.resize(dir + 1, false);
+		}
+		
+		git_blob_create_frombuffer(&blob, repo, content.data(), content.length());
+		snprintf(name, sizeof(name), "f%05lu.txt", (unsigned long)file);
+		staged[dir][name] = blob;
+	}
+	
+	/*!
+	 \brief commit what's staged
+	 \param parents	the parents, none for the first commit
+	 \param message	what it says
+	 \returns the new commit's ID
+	 */
+	git_oid commit(const vector<git_oid> &parents, const char *message)
+	{
+		vector<const git_commit *> parent_commits;
+		git_oid id;
+		
+		write_trees();
+		
+		for(size_t i = 0; i < parents.size(); i++)
+		{
+			git_commit *parent;
+			if(git_commit_lookup(&parent, repo, &parents[i]) == 0)
+				parent_commits.push_back(parent);
+		}
+		
+		git_tree *tree;
+		git_tree_lookup(&tree, repo, &state.root);
+		
+		// a minute apart, so sorting by time keeps them in order
+		git_signature_free(author);
+		git_signature_new(&author, "A. U. Thor", "author@example.com", when += 60, 0);
+		git_commit_create(&id, repo, NULL, author, author, NULL, message, tree,
+				  (int)parent_commits.size(),
+				  parent_commits.empty() ? NULL : &parent_commits[0]);
+		
+		git_tree_free(tree);
+		for(size_t i = 0; i < parent_commits.size(); i++)
+			git_commit_free(const_cast<git_commit *>(parent_commits[i]));
+		return id;
+	}
+	
+	/*!
+	 \brief commit with one parent
+	 */
+	git_oid commit(const git_oid &parent, const char *message)
+	{
+		return commit(vector<git_oid>(1, parent), message);
+	}
+	
+	tree_state &tree() { return state; }
+
+private:
+	git_repository *repo;
+	git_time_t when;
+	git_signature *author;
+	tree_state state;
+	map<size_t, map<string, git_oid> > staged;
+	
+	/*!
+	 \brief write the trees of every directory that has something staged, then
+	        the root tree
+	 */
+	void write_trees()
+	{
+		git_treebuilder *builder;
+		git_tree *source;
+		
+		for(map<size_t, map<string, git_oid> >::iterator dir = staged.begin();
+		    dir != staged.end(); ++dir)
+		{
+			source = NULL;
+			if(state.used[dir->first])
+				git_tree_lookup(&source, repo, &state.dirs[dir->first]);
+			
+			git_treebuilder_create(&builder, source);
+			for(map<string, git_oid>::iterator file = dir->second.begin();
+			    file != dir->second.end(); ++file)
+				git_treebuilder_insert(NULL, builder, file->first.c_str(),
+						       &file->second, GIT_FILEMODE_BLOB);
+			git_treebuilder_write(&state.dirs[dir->first], repo, builder);
+			git_treebuilder_free(builder);
+			if(source != NULL) git_tree_free(source);
+			state.used[dir->first] = true;
+		}
+		staged.clear();
+		
+		// the root is always written again whole, it's one entry a directory
+		git_treebuilder_create(&builder, NULL);
+		for(size_t dir = 0; dir < state.dirs.size(); dir++)
+		{
+			char name[16];
+			if(!state.used[dir]) continue;
+			snprintf(name, sizeof(name), "d%04lu", (unsigned long)dir);
+			git_treebuilder_insert(NULL, builder, name, &state.dirs[dir], GIT_FILEMODE_TREE);
+		}
+		git_treebuilder_write(&state.root, repo, builder);
+		git_treebuilder_free(builder);
+		state.have_root = true;
+	}
+};
+
+
+/*!
+ \brief scale a count, never to nothing
+ */
+static size_t scaled(size_t count, double scale)
+{
+	size_t result = (size_t)(count * scale);
+	return result ? result : 1;
+}
+
+
+/*!
+ \brief fill in the push from commit IDs
+ */
+static void set_push(push &out, const git_oid *old_oid, const git_oid &new_oid, const char *ref)
+{
+	if(old_oid == NULL)
+		strcpy(out.old_id, zero_id);
+	else
+		git_oid_fmt(out.old_id, old_oid);
+	out.old_id[40] = '\0';
+	git_oid_fmt(out.new_id, &new_oid);
+	out.new_id[40] = '\0';
+	snprintf(out.ref, sizeof(out.ref), "%s", ref);
+}
+
+
+/*!
+ \brief commits on top of each other, each changing a few files
+ */
+static bool make_linear(synthetic_repo &repo, double scale, push &out)
+{
+	const size_t dirs = 64, files = 32, commits = scaled(2000, scale);
+	sequence random(1);
+	
+	for(size_t dir = 0; dir < dirs; dir++)
+		for(size_t file = 0; file < files; file++)
+			repo.write(dir, file, 0, 40);
+	git_oid base = repo.commit(vector<git_oid>(), "Initial import");
+	
+	git_oid tip = base;
+	for(size_t commit = 1; commit <= commits; commit++)
+	{
+		for(int change = 0; change < 3; change++)
+			repo.write(random.next(dirs), random.next(files), (unsigned)commit, 40);
+		tip = repo.commit(tip, "Change a few files\n\nThis is the kind of thing that happens all day.\n");
+	}
+	
+	set_push(out, &base, tip, "refs/heads/master");
+	return true;
+}
+
+
+/*!
+ \brief branches that each change their own directory, brought back together
+        by one octopus merge
+ */
+static bool make_wide_merge(synthetic_repo &repo, double scale, push &out)
+{
+	const size_t branches = 32, files = 16, commits = scaled(16, scale);
+	
+	for(size_t dir = 0; dir < branches; dir++)
+		for(size_t file = 0; file < files; file++)
+			repo.write(dir, file, 0, 40);
+	git_oid base = repo.commit(vector<git_oid>(), "Initial import");
+	tree_state base_tree = repo.tree();
+	
+	vector<git_oid> tips;
+	vector<git_oid> branch_dirs;
+	for(size_t branch = 0; branch < branches; branch++)
+	{
+		git_oid tip = base;
+		repo.tree() = base_tree;
+		for(size_t commit = 1; commit <= commits; commit++)
+		{
+			repo.write(branch, commit % files, (unsigned)commit, 40);
+			tip = repo.commit(tip, "Work on a topic branch");
+		}
+		tips.push_back(tip);
+		branch_dirs.push_back(repo.tree().dirs[branch]);
+	}
+	
+	// every branch only touched its own directory, so the merge is easy
+	repo.tree() = base_tree;
+	for(size_t branch = 0; branch < branches; branch++)
+		repo.tree().dirs[branch] = branch_dirs[branch];
+	git_oid merge = repo.commit(tips, "Merge every topic branch");
+	
+	set_push(out, &base, merge, "refs/heads/master");
+	return true;
+}
+
+
+/*!
+ \brief a tree of a hundred thousand files, with a few changing at a time
+ */
+static bool make_huge_tree(synthetic_repo &repo, double scale, push &out)
+{
+	const size_t dirs = 400, files = scaled(256, scale), commits = 200;
+	sequence random(3);
+	
+	for(size_t dir = 0; dir < dirs; dir++)
+		for(size_t file = 0; file < files; file++)
+			repo.write(dir, file, 0, 4);
+	git_oid base = repo.commit(vector<git_oid>(), "Initial import");
+	
+	git_oid tip = base;
+	for(size_t commit = 1; commit <= commits; commit++)
+	{
+		repo.write(random.next(dirs), random.next(files), (unsigned)commit, 4);
+		repo.write(random.next(dirs), random.next(files), (unsigned)commit, 4);
+		tip = repo.commit(tip, "Change two files somewhere in a big tree");
+	}
+	
+	set_push(out, &base, tip, "refs/heads/master");
+	return true;
+}
+
+
+/*!
+ \brief every commit adds lots of little files, so the payload is mostly paths
+ */
+static bool make_small_files(synthetic_repo &repo, double scale, push &out)
+{
+	const size_t commits = scaled(500, scale), files = 100, per_dir = 1000;
+	
+	repo.write(0, 0, 0, 1);
+	git_oid base = repo.commit(vector<git_oid>(), "Initial import");
+	
+	git_oid tip = base;
+	size_t added = 1;
+	for(size_t commit = 1; commit <= commits; commit++)
+	{
+		for(size_t file = 0; file < files; file++, added++)
+			repo.write(added / per_dir, added % per_dir, 0, 1);
+		tip = repo.commit(tip, "Add a hundred files");
+	}
+	
+	set_push(out, &base, tip, "refs/heads/master");
+	return true;
+}
+
+
+/*!
+ \brief a whole history pushed at once, the way it is when a repo moves here
+ */
+static bool make_import(synthetic_repo &repo, double scale, push &out)
+{
+	const size_t dirs = 256, files = 64, commits = scaled(100000, scale);
+	sequence random(5);
+	
+	repo.write(0, 0, 0, 10);
+	git_oid base = repo.commit(vector<git_oid>(), "Initial commit");
+	
+	git_oid tip = base;
+	for(size_t commit = 1; commit <= commits; commit++)
+	{
+		repo.write(random.next(dirs), random.next(files), (unsigned)commit, 10);
+		tip = repo.commit(tip, "Imported commit");
+	}
+	
+	set_push(out, &base, tip, "refs/heads/master");
+	return true;
+}
+
+
+/*!
+ \brief a branch that didn't exist before the push, so the old ID is all zeros
+ */
+static bool make_new_branch(synthetic_repo &repo, double scale, push &out)
+{
+	const size_t dirs = 16, files = 16, commits = scaled(500, scale), topic = scaled(50, scale);
+	sequence random(6);
+	
+	for(size_t dir = 0; dir < dirs; dir++)
+		for(size_t file = 0; file < files; file++)
+			repo.write(dir, file, 0, 40);
+	git_oid tip = repo.commit(vector<git_oid>(), "Initial import");
+	
+	for(size_t commit = 1; commit <= commits + topic; commit++)
+	{
+		repo.write(random.next(dirs), random.next(files), (unsigned)commit, 40);
+		tip = repo.commit(tip, commit <= commits ? "Work on master" : "Work on a new topic");
+	}
+	
+	set_push(out, NULL, tip, "refs/heads/topic");
+	return true;
+}
+
+
+/*!
+ \brief how to make a repo of one shape
+ */
+struct scenario
+{
+	const char *name;
+	const char *description;
+	bool (*make)(synthetic_repo &, double, push &);
+};
+
+
+static const scenario scenarios[] =
+{
+	{ "linear", "2000 commits in a line, 3 files each", make_linear },
+	{ "wide-merge", "32 branches of 16 commits and an octopus merge", make_wide_merge },
+	{ "huge-tree", "200 commits to a tree of 102400 files", make_huge_tree },
+	{ "small-files", "500 commits adding 100 files each", make_small_files },
+	{ "import", "100000 commits pushed at once", make_import },
+	{ "new-branch", "a new branch of 550 commits", make_new_branch },
+};
+
+
+/*!
+ \brief what one scenario measured, sent back from the process that ran it
+ */
+struct result
+{
+	bool ok;
+	size_t commits;
+	size_t bytes;
+	size_t runs;
+	double p50, p90, p99, max;
+	double build, send;
+	long peak_kb;
+};
+
+
+static double seconds(uint64_t ns)
+{
+	return ns / 1e9;
+}
+
+
+/*!
+ \brief the time below which the given share of the runs finished
+ */
+static double percentile(const vector<double> &sorted, double share)
+{
+	size_t rank = (size_t)(share * sorted.size() + 0.999999);
+	if(rank == 0) rank = 1;
+	return sorted[min(rank, sorted.size()) - 1];
+}
+
+
+/*!
+ \brief make the scenario's repo, unless it's already there from last time
+ \param which	the scenario
+ \param path	where it goes
+ \param scale	how big it is
+ \param out		the push to give the hook
+ 
+ The push is kept next to the repo, so that it's only made the first time.
+ This happens in its own process, so that it doesn't count against the peak
+ memory of the run.
+ */
+static bool prepare(const scenario &which, const string &path, double scale, push &out)
+{
+	string push_file = path + "/bench-push";
+	FILE *saved = fopen(push_file.c_str(), "r");
+	if(saved != NULL)
+	{
+		bool read = fscanf(saved, "%40s %40s %255s", out.old_id, out.new_id, out.ref) == 3;
+		fclose(saved);
+		if(read) return true;
+	}
+	
+	fprintf(stderr, "making %s in %s... ", which.name, path.c_str());
+	uint64_t started = timing_now();
+	
+	pid_t maker = fork();
+	if(maker == 0)
+	{
+		synthetic_repo repo(path);
+		if(!repo.ok() || !which.make(repo, scale, out)) _exit(1);
+		
+		FILE *file = fopen(push_file.c_str(), "w");
+		if(file == NULL) _exit(1);
+		fprintf(file, "%s %s %s\n", out.old_id, out.new_id, out.ref);
+		_exit(fclose(file) == 0 ? 0 : 1);
+	}
+	
+	int status;
+	if(maker == -1 || waitpid(maker, &status, 0) != maker ||
+	   !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		fprintf(stderr, "failed\n");
+		return false;
+	}
+	fprintf(stderr, "%.1f s\n", seconds(timing_now() - started));
+	return prepare(which, path, scale, out);
+}
+
+
+/*!
+ \brief run the hook over a push again and again, the way main() does
+ */
+static result measure(const string &path, const push &what, const char *url, size_t runs)
+{
+	result out;
+	vector<double> totals;
+	uint64_t build = 0, send = 0;
+	
+	memset(&out, 0, sizeof(out));
+	
+	WTConnection *conn = new WTConnection(NULL);
+	conn->connect(url);
+	
+	JSONArena arena;
+	JSONArena::scope payload_arena(arena);
+	
+	// the first run warms up the caches and counts what there is to send
+	for(size_t run = 0; run <= runs; run++)
+	{
+		uint64_t started = timing_now();
+		JSONNode *node = git_hook_main(path.c_str(), what.old_id, what.new_id, what.ref);
+		if(node == NULL) break;
+		uint64_t built = timing_now();
+		bool answered = git_hook_send(conn, node, 0, url);
+		uint64_t sent = timing_now();
+		
+		if(run == 0)
+		{
+			out.ok = answered;
+			out.commits = node->at("commits").size();
+			out.bytes = node->write().length();
+		}
+		else
+		{
+			build += built - started;
+			send += sent - built;
+			totals.push_back(seconds(sent - started));
+		}
+		
+		delete node;
+		arena.release();
+	}
+	
+	conn->disconnect();
+	delete conn;
+	
+	if(totals.empty())
+	{
+		out.ok = false;
+		return out;
+	}
+	
+	sort(totals.begin(), totals.end());
+	out.runs = totals.size();
+	out.p50 = percentile(totals, 0.50);
+	out.p90 = percentile(totals, 0.90);
+	out.p99 = percentile(totals, 0.99);
+	out.max = totals.back();
+	out.build = seconds(build) / out.runs;
+	out.send = seconds(send) / out.runs;
+	
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	out.peak_kb = usage.ru_maxrss / 1024;
+#else
+	out.peak_kb = usage.ru_maxrss;
+#endif
+	return out;
+}
+
+
+/*!
+ \brief measure in a process of its own, so that the peak memory is the hook's
+ */
+static bool measure_apart(const string &path, const push &what, const char *url,
+			  size_t runs, result &out)
+{
+	int pipes[2];
+	if(pipe(pipes) != 0) return false;
+	
+	pid_t runner = fork();
+	if(runner == 0)
+	{
+		close(pipes[0]);
+		result measured = measure(path, what, url, runs);
+		ssize_t wrote = write(pipes[1], &measured, sizeof(measured));
+		_exit(wrote == sizeof(measured) ? 0 : 1);
+	}
+	close(pipes[1]);
+	
+	bool got = runner != -1 && read(pipes[0], &out, sizeof(out)) == sizeof(out);
+	close(pipes[0]);
+	if(runner != -1) waitpid(runner, NULL, 0);
+	return got && out.ok;
+}
+
+
+/*!
+ \brief print usage
+ \param prog_name	the name of the executable
+ */
+static void usage(const char *prog_name)
+{
+	fprintf(stderr, "Usage: %s [-d dir] [-n runs] [-s scale] [scenario ...]\n", prog_name);
+	fprintf(stderr, "\t-d dir\t\twhere the repos are made and kept (bench-repos)\n");
+	fprintf(stderr, "\t-n runs\t\thow many times to run the hook over each (5)\n");
+	fprintf(stderr, "\t-s scale\thow big to make them, 1 is full size (1)\n");
+	fprintf(stderr, "\nScenarios:\n");
+	for(size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+		fprintf(stderr, "\t%-12s\t%s\n", scenarios[i].name, scenarios[i].description);
+}
+
+
+/*!
+ \brief make the repos, run the hook over each of them, and say how it went
+ \param argc		number of args
+ \param argv		arguments
+ */
+int main(int argc, char * const argv[])
+{
+	string dir = "bench-repos";
+	size_t runs = 5;
+	double scale = 1.0;
+	int option;
+	
+	while((option = getopt(argc, argv, "d:n:s:h")) != -1)
+	{
+		switch(option)
+		{
+			case 'd':
+				dir = optarg;
+				break;
+			case 'n':
+				runs = strtoul(optarg, NULL, 10);
+				break;
+			case 's':
+				scale = strtod(optarg, NULL);
+				break;
+			default:
+				usage(argv[0]);
+				return option == 'h' ? 0 : 1;
+		}
+	}
+	
+	if(runs == 0 || scale <= 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	
+	vector<const scenario *> chosen;
+	for(size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+	{
+		bool wanted = optind == argc;
+		for(int arg = optind; arg < argc; arg++)
+			if(strcmp(argv[arg], scenarios[i].name) == 0) wanted = true;
+		if(wanted) chosen.push_back(&scenarios[i]);
+	}
+	if(chosen.empty())
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	
+	if(mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+	{
+		perror("can't make the repo directory");
+		return 1;
+	}
+	
+	receiver sink;
+	if(!sink.start()) return 1;
+	
+	printf("%-12s %8s %10s %9s %9s %9s %9s %9s %9s %10s %9s\n",
+	       "scenario", "commits", "bytes", "p50 ms", "p90 ms", "p99 ms", "max ms",
+	       "build ms", "send ms", "commits/s", "peak KB");
+	
+	int failed = 0;
+	for(size_t i = 0; i < chosen.size(); i++)
+	{
+		const scenario &which = *chosen[i];
+		char suffix[32];
+		push what;
+		result got;
+		
+		snprintf(suffix, sizeof(suffix), "-x%g", scale);
+		string path = dir + "/" + which.name + suffix;
+		
+		if(!prepare(which, path, scale, what) ||
+		   !measure_apart(path, what, sink.url(), runs, got))
+		{
+			printf("%-12s failed\n", which.name);
+			failed++;
+			continue;
+		}
+		
+		double mean = got.build + got.send;
+		printf("%-12s %8lu %10lu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %10.0f %9ld\n",
+		       which.name, (unsigned long)got.commits, (unsigned long)got.bytes,
+		       got.p50 * 1000, got.p90 * 1000, got.p99 * 1000, got.max * 1000,
+		       got.build * 1000, got.send * 1000,
+		       mean > 0 ? got.commits / mean : 0.0, got.peak_kb);
+		fflush(stdout);
+	}
+	
+	sink.stop();
+	return failed ? 1 : 0;
+}
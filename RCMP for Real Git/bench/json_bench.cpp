@@ -0,0 +1,1431 @@
+//
+//  json_bench.cpp
+//  RCMP for Real Git
+//
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#include "../json/libjson.h"
+#include "../json/Source/NumberToString.h"
+#include "../timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <limits>
+#include <new>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+#if __cplusplus >= 201103L
+#	define THROWS_BAD_ALLOC
+#	define THROWS_NOTHING noexcept
+#else
+#	define THROWS_BAD_ALLOC throw(std::bad_alloc)
+#	define THROWS_NOTHING throw()
+#endif
+
+
+/*!
+ \brief every allocation made by anything, libjson's strings included
+ */
+static size_t new_count = 0;
+
+void *operator new(size_t size) THROWS_BAD_ALLOC
+{
+	new_count++;
+	void *memory = malloc(size ? size : 1);
+	if(memory == NULL) throw std::bad_alloc();
+	return memory;
+}
+
+void operator delete(void *memory) THROWS_NOTHING
+{
+	free(memory);
+}
+
+
+#ifdef JSON_MEMORY_CALLBACKS
+/*!
+ \brief allocations libjson makes through json_malloc and json_realloc
+ */
+static size_t malloc_count = 0;
+
+static void *counting_malloc(size_t size)
+{
+	malloc_count++;
+	return malloc(size);
+}
+
+static void *counting_realloc(void *memory, size_t size)
+{
+	malloc_count++;
+	return realloc(memory, size);
+}
+#endif
+
+
+/*!
+ \brief how many things have been allocated so far, of each kind
+ */
+struct counts
+{
+	double nodes, internals, children, mallocs, news;
+	
+	static counts now()
+	{
+		counts result;
+#ifdef JSON_UNIT_TEST
+		result.nodes = JSONNode::getNodeAllocationCount();
+		result.internals = JSONNode::getInternalAllocationCount();
+		result.children = JSONNode::getChildrenAllocationCount();
+#else
+		// make pgo builds it with the hook's own libjson, which doesn't count them
+		result.nodes = result.internals = result.children = 0;
+#endif
+#ifdef JSON_MEMORY_CALLBACKS
+		result.mallocs = malloc_count;
+#else
+		result.mallocs = 0;
+#endif
+		result.news = new_count;
+		return result;
+	}
+	
+	counts operator-(const counts &other) const
+	{
+		counts result;
+		result.nodes = nodes - other.nodes;
+		result.internals = internals - other.internals;
+		result.children = children - other.children;
+		result.mallocs = mallocs - other.mallocs;
+		result.news = news - other.news;
+		return result;
+	}
+};
+
+
+/*!
+ \brief times a run and counts what it allocates, except while paused
+ 
+ Cases pause it around whatever they have to set up for each operation that
+ isn't what's being measured.
+ */
+class meter
+{
+public:
+	void start()
+	{
+		elapsed = 0;
+		memset(&excluded, 0, sizeof(excluded));
+		started = counts::now();
+		resumed = timing_now();
+	}
+	
+	void pause()
+	{
+		elapsed += timing_now() - resumed;
+		paused = counts::now();
+	}
+	
+	void resume()
+	{
+		counts during = counts::now() - paused;
+		excluded.nodes += during.nodes;
+		excluded.internals += during.internals;
+		excluded.children += during.children;
+		excluded.mallocs += during.mallocs;
+		excluded.news += during.news;
+		resumed = timing_now();
+	}
+	
+	void stop()
+	{
+		elapsed += timing_now() - resumed;
+		allocated = counts::now() - started - excluded;
+	}
+	
+	uint64_t elapsed;
+	counts allocated;
+
+private:
+	uint64_t resumed;
+	counts started, paused, excluded;
+};
+
+static meter timer;
+
+
+/*!
+ \brief a document to measure with
+ */
+struct corpus
+{
+	string name;
+	json_string text;
+	JSONNode tree;
+	vector<json_string> strings;
+};
+
+
+/*!
+ \brief one thing to measure
+ */
+struct bench_case
+{
+	string name;
+	size_t bytes_per_op;
+	void (*run)(const corpus *, size_t);
+	const corpus *input;
+};
+
+
+/*!
+ \brief look at every value so that none of them are left unparsed
+ */
+static size_t fetch_all(const JSONNode &node)
+{
+	size_t seen = 0;
+	for(JSONNode::const_iterator child = node.begin(); child != node.end(); ++child)
+	{
+		if(child->type() == JSON_NODE || child->type() == JSON_ARRAY)
+			seen += fetch_all(*child);
+		else
+			seen += child->as_string().length();
+	}
+	return seen;
+}
+
+
+/*!
+ \brief every string in a tree, unescaped, for measuring escaping them again
+ */
+static void collect_strings(const JSONNode &node, vector<json_string> &out)
+{
+	for(JSONNode::const_iterator child = node.begin(); child != node.end(); ++child)
+	{
+		out.push_back(child->name());
+		if(child->type() == JSON_NODE || child->type() == JSON_ARRAY)
+			collect_strings(*child, out);
+		else if(child->type() == JSON_STRING)
+			out.push_back(child->as_string());
+	}
+}
+
+
+/*!
+ \brief a payload shaped like the ones the hook sends
+ \param commits	how many commits are in it
+ */
+static json_string make_payload(size_t commits)
+{
+	JSONNode payload, commit_array(JSON_ARRAY), repo_node;
+	char text[128];
+	
+	payload.emplace_back("before", "0123456789abcdef0123456789abcdef01234567");
+	payload.emplace_back("after", "89abcdef0123456789abcdef0123456789abcdef");
+	payload.emplace_back("ref", "refs/heads/master");
+	commit_array.set_name("commits");
+	
+	for(size_t i = 0; i < commits; i++)
+	{
+		JSONNode commit_details, author_node;
+		
+		snprintf(text, sizeof(text), "%040lx", (unsigned long)(i * 2654435761u));
+		commit_details.emplace_back("id", text);
+		snprintf(text, sizeof(text), "Commit number %lu\n\nFix things in \"module\" %lu",
+			 (unsigned long)i, (unsigned long)(i % 7));
+		commit_details.emplace_back("message", text);
+		commit_details.emplace_back("timestamp", "2012-08-13T12:00:00-00:00");
+		author_node.set_name("author");
+		author_node.emplace_back("name", "A. U. Thor");
+		author_node.emplace_back("email", "author@example.com");
+		commit_details.push_back(json_move(author_node));
+		commit_details.emplace_back("url", "http://localhost/");
+		
+		const char *lists[] = { "added", "modified", "removed" };
+		for(int list = 0; list < 3; list++)
+		{
+			JSONNode files(JSON_ARRAY);
+			files.set_name(lists[list]);
+			for(size_t file = 0; file < (i + list) % 4; file++)
+			{
+				snprintf(text, sizeof(text), "src/dir%lu/file%lu.cpp",
+					 (unsigned long)(i % 13), (unsigned long)file);
+				files.emplace_back("file", text);
+			}
+			commit_details.push_back(json_move(files));
+		}
+		commit_array.push_back(json_move(commit_details));
+	}
+	payload.push_back(json_move(commit_array));
+	
+	repo_node.set_name("repository");
+	repo_node.emplace_back("name", "No Name Set");
+	repo_node.emplace_back("url", "/srv/git/repo.git/");
+	repo_node.emplace_back("description", "A repository with \"quotes\" in its description\n");
+	payload.push_back(json_move(repo_node));
+	return payload.write();
+}
+
+
+/*!
+ \brief strings that need escaping, as commit messages often do
+ */
+static json_string make_escapes(void)
+{
+	JSONNode strings(JSON_ARRAY);
+	for(int i = 0; i < 1000; i++)
+	{
+		char text[160];
+		snprintf(text, sizeof(text),
+			 "Merge \"branch %d\" into C:\\work\\tree\n\n\tFixes a\tbug in caf\xc3\xa9 %d\x01, see <http://example.com/%d>",
+			 i, i, i);
+		strings.push_back(JSONNode(JSON_TEXT(""), json_string(text)));
+	}
+	return strings.write();
+}
+
+
+/*!
+ \brief numbers, half of them whole
+ */
+static json_string make_numbers(void)
+{
+	JSONNode numbers(JSON_ARRAY);
+	for(int i = 0; i < 10000; i++)
+	{
+		if(i & 1)
+			numbers.push_back(JSONNode(JSON_TEXT(""), (json_number)(i * 1.0001 - 5000.5)));
+		else
+			numbers.push_back(JSONNode(JSON_TEXT(""), (json_int_t)(i * 2654435761u)));
+	}
+	return numbers.write();
+}
+
+
+/*!
+ \brief add a corpus, parsing it once to have a tree and its strings ready
+ */
+static bool add_corpus(vector<corpus *> &corpora, const string &name, const json_string &text)
+{
+#ifdef JSON_VALIDATE
+	if(!libjson::is_valid(text))
+	{
+		fprintf(stderr, "%s isn't JSON\n", name.c_str());
+		return false;
+	}
+	
+#endif
+	corpus *adding = new corpus;
+	adding->name = name;
+	adding->text = text;
+	adding->tree = libjson::parse(text);
+	fetch_all(adding->tree);
+	collect_strings(adding->tree, adding->strings);
+	corpora.push_back(adding);
+	return true;
+}
+
+
+/*!
+ \brief what the cases made, added up so that none of it is optimized away
+ */
+static volatile size_t sink = 0;
+
+
+static void run_parse(const corpus *input, size_t ops)
+{
+	for(size_t op = 0; op < ops; op++)
+	{
+		JSONNode parsed = libjson::parse(input->text);
+		sink += parsed.size();
+	}
+}
+
+
+#ifdef JSON_VALIDATE
+static void run_validate(const corpus *input, size_t ops)
+{
+	for(size_t op = 0; op < ops; op++)
+		sink += libjson::is_valid(input->text);
+}
+#endif
+
+
+static void run_fetch(const corpus *input, size_t ops)
+{
+	for(size_t op = 0; op < ops; op++)
+	{
+		timer.pause();
+		JSONNode parsed = libjson::parse(input->text);
+		timer.resume();
+		sink += fetch_all(parsed);
+		timer.pause();
+		parsed = JSONNode();
+		timer.resume();
+	}
+}
+
+
+static void run_write(const corpus *input, size_t ops)
+{
+	for(size_t op = 0; op < ops; op++)
+		sink += input->tree.write().length();
+}
+
+
+static void run_write_formatted(const corpus *input, size_t ops)
+{
+	for(size_t op = 0; op < ops; op++)
+		sink += input->tree.write_formatted().length();
+}
+
+
+static void run_unfix(const corpus *input, size_t ops)
+{
+	for(size_t op = 0; op < ops; op++)
+		for(size_t i = 0; i < input->strings.size(); i++)
+			sink += JSONWorker::UnfixString(input->strings[i], true).length();
+}
+
+
+#ifdef JSON_STREAM
+static void count_streamed(JSONNode &node)
+{
+	sink += node.size();
+}
+
+
+static void run_stream(const corpus *input, size_t ops)
+{
+	const size_t chunk = 4096;
+	for(size_t op = 0; op < ops; op++)
+	{
+		JSONStream stream(count_streamed);
+		for(size_t at = 0; at < input->text.length(); at += chunk)
+			stream << input->text.substr(at, chunk);
+	}
+}
+#endif
+
+
+static vector<unsigned char> binary;
+static json_string encoded;
+
+
+static void run_encode64(const corpus *, size_t ops)
+{
+	for(size_t op = 0; op < ops; op++)
+		sink += JSONBase64::json_encode64(&binary[0], binary.size()).length();
+}
+
+
+static void run_decode64(const corpus *, size_t ops)
+{
+	for(size_t op = 0; op < ops; op++)
+		sink += JSONBase64::json_decode64(encoded).length();
+}
+
+
+static const size_t number_count = 1024;
+static json_int_t whole_numbers[number_count];
+static json_number real_numbers[number_count];
+
+
+static void run_itoa(const corpus *, size_t ops)
+{
+	json_string out;
+	for(size_t op = 0; op < ops; op++)
+	{
+		out.clear();
+		NumberToString::_itoa(whole_numbers[op % number_count], out);
+		sink += out.length();
+	}
+}
+
+
+// what writing them would cost without libjson
+static void run_itoa_snprintf(const corpus *, size_t ops)
+{
+	json_string out;
+	char text[32];
+	for(size_t op = 0; op < ops; op++)
+	{
+		out.assign(text, snprintf(text, sizeof(text), "%ld", (long)whole_numbers[op % number_count]));
+		sink += out.length();
+	}
+}
+
+
+static void run_ftoa(const corpus *, size_t ops)
+{
+	json_string out;
+	for(size_t op = 0; op < ops; op++)
+	{
+		out.clear();
+		NumberToString::_ftoa(real_numbers[op % number_count], out);
+		sink += out.length();
+	}
+}
+
+
+template <size_t children>
+static void run_children(const corpus *, size_t ops)
+{
+	for(size_t op = 0; op < ops; op++)
+	{
+		JSONNode array(JSON_ARRAY);
+		for(size_t i = 0; i < children; i++)
+			array.push_back(JSONNode(JSON_TEXT(""), (json_int_t)i));
+		sink += array.size();
+	}
+}
+
+
+/*!
+ \brief one thing to check instead of measure
+ */
+struct check_case
+{
+	string name;
+	bool (*run)(void);	// says what's wrong on stderr
+};
+
+
+/*!
+ \brief whether libjson's parsers all take a document, saying so under check if they don't agree
+ */
+static bool parses(const char *check, const json_string &text)
+{
+	bool tree, tape;
+	
+#ifndef JSON_NO_EXCEPTIONS
+	try
+	{
+		tree = libjson::parse(text).type() != JSON_NULL;
+	}
+	catch(std::invalid_argument &)
+	{
+		tree = false;
+	}
+	try
+	{
+		tape = !JSONDocument(text).empty();
+	}
+	catch(std::invalid_argument &)
+	{
+		tape = false;
+	}
+#else
+	tree = libjson::parse(text).type() != JSON_NULL;
+	tape = !JSONDocument(text).empty();
+#endif
+	if(tree != tape)
+		fprintf(stderr, "%s: %s is only taken by the %s\n", check, text.c_str(), tree ? "tree" : "tape");
+#ifdef JSON_VALIDATE
+	if(tree != libjson::is_valid(text))
+		fprintf(stderr, "%s: the validator %s %s\n", check, tree ? "rejects" : "takes", text.c_str());
+#endif
+	return tree && tape;
+}
+
+
+/*!
+ \brief escapes cut short at the end of a name or a string, which the unescaping used to read past
+ */
+static bool check_escapes(void)
+{
+	static const char *short_escapes[] =
+	{
+		"\\", "\\u", "\\u0", "\\u00", "\\u004",
+#ifndef JSON_STRICT
+		"\\x", "\\x4", "\\0", "\\07", "\\1", "\\18",
+#endif
+	};
+	static const char *names[] = { "", "a", "abcdefghijklmnopqrstuvwxyz" };
+	bool ok = true;
+	
+	for(size_t i = 0; i < sizeof(short_escapes) / sizeof(short_escapes[0]); i++)
+	{
+		for(size_t name = 0; name < sizeof(names) / sizeof(names[0]); name++)
+		{
+			json_string escaped = json_string(names[name]) + short_escapes[i];
+			json_string documents[] =
+			{
+				"{\"" + escaped + "\":1}",
+				"[\"" + escaped + "\"]",
+				"{\"a\":\"" + escaped + "\"}",
+			};
+			for(size_t doc = 0; doc < sizeof(documents) / sizeof(documents[0]); doc++)
+			{
+				if(parses("escapes", documents[doc]))
+				{
+					fprintf(stderr, "escapes: %s was taken\n", documents[doc].c_str());
+					ok = false;
+				}
+			}
+		}
+	}
+	
+	// and whole ones still come out right, at the end as well
+#ifndef JSON_STRICT
+	const json_string whole = "{\"a\\101\":\"\\x42\\u0043\\104\"}";
+#else
+	const json_string whole = "{\"aA\":\"B\\u0043D\"}";
+#endif
+	if(!parses("escapes", whole))
+	{
+		fprintf(stderr, "escapes: %s wasn't taken\n", whole.c_str());
+		return false;
+	}
+	JSONNode tree = libjson::parse(whole);
+	JSONDocument tape(whole);
+	if(tree[0].name() != "aA" || tree[0].as_string() != "BCD" ||
+	   tape.root()[0].name() != "aA" || tape.root()[0].as_string() != "BCD")
+	{
+		fprintf(stderr, "escapes: %s came out as %s and %s\n", whole.c_str(),
+			tree.write().c_str(), tape.root().duplicate().write().c_str());
+		ok = false;
+	}
+	return ok;
+}
+
+
+/*!
+ \brief numbers starting with a point, which JSON_STRICT turns away since RFC 8259 wants a digit first
+ */
+static bool check_numbers(void)
+{
+	static const char *leading_points[] = { ".5", "-.5", ".5e1", "-.0" };
+	static const char *numbers[] = { "0.5", "-0.5", "5", "-0", "0.5e1" };
+	bool ok = true;
+	
+	for(size_t i = 0; i < sizeof(leading_points) / sizeof(leading_points[0]); i++)
+	{
+		const json_string document = json_string("[") + leading_points[i] + "]";
+#ifdef JSON_STRICT
+		if(parses("numbers", document))
+		{
+			fprintf(stderr, "numbers: %s was taken\n", document.c_str());
+			ok = false;
+		}
+#else
+		if(!parses("numbers", document))
+		{
+			fprintf(stderr, "numbers: %s wasn't taken\n", document.c_str());
+			ok = false;
+		}
+#endif
+	}
+	for(size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++)
+	{
+		const json_string document = json_string("[") + numbers[i] + "]";
+		if(!parses("numbers", document))
+		{
+			fprintf(stderr, "numbers: %s wasn't taken\n", document.c_str());
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+
+/*!
+ \brief whether libjson::parse takes a document, which reads it by going down a call for each level
+ */
+static bool tree_parses(const json_string &text)
+{
+#ifndef JSON_NO_EXCEPTIONS
+	try
+	{
+		return libjson::parse(text).type() != JSON_NULL;
+	}
+	catch(std::invalid_argument &)
+	{
+		return false;
+	}
+#else
+	return libjson::parse(text).type() != JSON_NULL;
+#endif
+}
+
+
+/*!
+ \brief nesting up to JSON_MAX_DEPTH is read, and anything deeper fails instead of running out of stack
+ */
+static bool check_nesting(void)
+{
+	const size_t depths[] = { JSON_MAX_DEPTH, JSON_MAX_DEPTH + 1, 100000 };
+	bool ok = true;
+	
+	for(size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+	{
+		const size_t depth = depths[i];
+		json_string arrays = json_string(depth, '[') + json_string(depth, ']');
+		json_string objects;
+		for(size_t level = 1; level < depth; level++)
+			objects += "{\"a\":";
+		objects += "{}" + json_string(depth - 1, '}');
+		
+		const json_string *documents[] = { &arrays, &objects };
+		for(size_t doc = 0; doc < sizeof(documents) / sizeof(documents[0]); doc++)
+		{
+			bool taken = tree_parses(*documents[doc]);
+			if(taken != (depth <= JSON_MAX_DEPTH))
+			{
+				fprintf(stderr, "nesting: %s %lu deep was %s\n", doc == 0 ? "arrays" : "objects",
+					(unsigned long)depth, taken ? "taken" : "not taken");
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
+
+
+/*!
+ \brief whether the checks go through every value they can instead of a sample
+ */
+static bool exhaustive = false;
+
+
+/*!
+ \brief enough significant digits for any json_number to read back
+ */
+static const int number_digits = sizeof(json_number) == sizeof(float) ? 9 : 17;
+
+
+/*!
+ \brief reads a number the way strtod does, in json_number's own precision
+ */
+static json_number read_number(const char *text)
+{
+	return sizeof(json_number) == sizeof(float) ? (json_number)strtof(text, NULL) : (json_number)strtod(text, NULL);
+}
+
+
+/*!
+ \brief how many significant digits a number was written with
+ */
+static int significant_digits(const json_string &text)
+{
+	int digits = 0, trailing_zeros = 0;
+	bool started = false;
+	for(size_t i = 0; i < text.length() && text[i] != 'e'; i++)
+	{
+		if(text[i] < '0' || text[i] > '9') continue;
+		if(text[i] != '0') started = true;
+		if(!started) continue;
+		digits++;
+		trailing_zeros = text[i] == '0' ? trailing_zeros + 1 : 0;
+	}
+	return digits == trailing_zeros ? 1 : digits - trailing_zeros;
+}
+
+
+/*!
+ \brief the fewest digits printf needs for a number to read back, which is slow
+ */
+static int fewest_digits(json_number value)
+{
+	char text[64];
+	for(int digits = 1; digits < number_digits; digits++)
+	{
+		snprintf(text, sizeof(text), "%.*g", digits, (double)value);
+		if(read_number(text) == value) return digits;
+	}
+	return number_digits;
+}
+
+
+/*!
+ \brief what the ftoa check has found so far
+ */
+struct ftoa_tally
+{
+	unsigned long checked, wrong, sampled, longer;
+	
+	ftoa_tally() : checked(0), wrong(0), sampled(0), longer(0) {}
+};
+
+
+/*!
+ \brief write a number and read it back, both with libjson and with strtod
+ \param value	the number
+ \param sample	whether to also see if it's longer than it needs to be
+ \param tally	what's been found so far
+ */
+static void check_number(json_number value, bool sample, ftoa_tally &tally)
+{
+	json_string text;
+	NumberToString::_ftoa(value, text);
+	tally.checked++;
+	
+	const json_char *runner = text.c_str();
+	json_number parsed = 0;
+	bool read = NumberToString::_parse(runner, parsed) && *runner == '\0';
+	int digits = significant_digits(text);
+	if(!read || parsed != value || read_number(text.c_str()) != value || digits > number_digits)
+	{
+		if(tally.wrong++ < 20)
+			fprintf(stderr, "ftoa: %.*g was written as %s, which reads back as %.*g\n",
+				number_digits, (double)value, text.c_str(), number_digits, (double)parsed);
+		return;
+	}
+	
+	if(!sample) return;
+	tally.sampled++;
+	if(digits > fewest_digits(value)) tally.longer++;
+}
+
+
+/*!
+ \brief that _ftoa's numbers read back as exactly what was written
+ 
+ It samples random bit patterns and some edges, or with -x goes through
+ every positive float there is, which takes about ten minutes.  Those are
+ widened when json_number is a double.  Grisu2 is allowed to be a digit
+ longer than it has to be now and then, so how often is only reported.
+ */
+static bool check_ftoa(void)
+{
+	typedef json_float_bits<sizeof(json_number)>::type number_bits;
+	ftoa_tally tally;
+	
+	if(exhaustive)
+	{
+		for(uint32_t bits = 0; bits < 0x7f800000u && tally.wrong < 20; bits++)
+		{
+			float value;
+			memcpy(&value, &bits, sizeof(value));
+			check_number((json_number)value, (bits & 0xfff) == 0, tally);
+		}
+	}
+	else
+	{
+		uint64_t state = 88172645463325252ULL;
+		while(tally.checked < 1000000 && tally.wrong < 20)
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			number_bits bits = (number_bits)state;
+			json_number value;
+			memcpy(&value, &bits, sizeof(value));
+			if(value - value == 0)	// not NaN or infinity
+				check_number(value, (tally.checked & 15) == 0, tally);
+		}
+		
+		const double edges[] =
+		{
+			0.0, -0.0, 1, -1, 0.1, 0.2, 0.3, 1e21, 1e22, 1e-6, 1e-7, 123456789, 881692032,
+			9007199254740993.0, 0.000001234, 1234567.125, 5e-324, 2.2250738585072014e-308,
+			1.7976931348623157e308, 1.4e-45, 1.1754943508222875e-38, 3.4028234663852886e38,
+		};
+		for(size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+		{
+			json_number value = (json_number)edges[i];
+			if(value - value == 0) check_number(value, true, tally);
+		}
+	}
+	
+	fprintf(stderr, "ftoa: %lu numbers written, %lu of %lu sampled were longer than they had to be\n",
+		tally.checked, tally.longer, tally.sampled);
+	return tally.wrong == 0;
+}
+
+
+/*!
+ \brief writes an integer with libjson, whichever of _itoa and _uitoa it takes
+ */
+static void write_integer(long value, json_string &text)
+{
+	NumberToString::_itoa(value, text);
+}
+
+static void write_integer(unsigned long value, json_string &text)
+{
+	NumberToString::_uitoa(value, text);
+}
+
+#ifndef JSON_ISO_STRICT
+static void write_integer(long long value, json_string &text)
+{
+	NumberToString::_itoa(value, text);
+}
+
+static void write_integer(unsigned long long value, json_string &text)
+{
+	NumberToString::_uitoa(value, text);
+}
+#endif
+
+
+/*!
+ \brief writes an integer with printf, which is what libjson has to match
+ */
+static void print_integer(long value, char *text, size_t size)
+{
+	snprintf(text, size, "%ld", value);
+}
+
+static void print_integer(unsigned long value, char *text, size_t size)
+{
+	snprintf(text, size, "%lu", value);
+}
+
+#ifndef JSON_ISO_STRICT
+static void print_integer(long long value, char *text, size_t size)
+{
+	snprintf(text, size, "%lld", value);
+}
+
+static void print_integer(unsigned long long value, char *text, size_t size)
+{
+	snprintf(text, size, "%llu", value);
+}
+#endif
+
+
+/*!
+ \brief what the itoa check has found so far
+ */
+struct itoa_tally
+{
+	unsigned long checked, wrong;
+	json_string text;
+	
+	itoa_tally() : checked(0), wrong(0) {}
+};
+
+
+template <typename T>
+static void check_integer(T value, itoa_tally &tally)
+{
+	char expected[32];
+	write_integer(value, tally.text);
+	print_integer(value, expected, sizeof(expected));
+	tally.checked++;
+	if(tally.text != expected && tally.wrong++ < 20)
+		fprintf(stderr, "itoa: %s was written as %s\n", expected, tally.text.c_str());
+}
+
+
+/*!
+ \brief every value within a hundred of one, as far as the type goes
+ */
+template <typename T>
+static void check_integers_around(T center, itoa_tally &tally)
+{
+	const T reach = 100, lowest = std::numeric_limits<T>::min(), highest = std::numeric_limits<T>::max();
+	const T to = center > highest - reach ? highest : (T)(center + reach);
+	for(T value = center < lowest + reach ? lowest : (T)(center - reach); ; value++)
+	{
+		check_integer(value, tally);
+		if(value == to) break;
+	}
+}
+
+
+/*!
+ \brief the ends of the type, where the digit count changes, and random values of every length
+ */
+template <typename T>
+static void check_integer_type(itoa_tally &tally)
+{
+	const bool is_signed = std::numeric_limits<T>::is_signed;
+	
+	check_integers_around<T>(0, tally);
+	check_integers_around(std::numeric_limits<T>::min(), tally);
+	check_integers_around(std::numeric_limits<T>::max(), tally);
+	for(T power = 1; power <= std::numeric_limits<T>::max() / 10; power *= 10)
+	{
+		check_integers_around((T)(power * 10), tally);
+		if(is_signed) check_integers_around((T)(0 - power * 10), tally);
+	}
+	for(T power = 1; power <= std::numeric_limits<T>::max() / 2; power *= 2)
+	{
+		check_integers_around((T)(power * 2), tally);
+		if(is_signed) check_integers_around((T)(0 - power * 2), tally);
+	}
+	
+	uint64_t state = 88172645463325252ULL;
+	for(int i = 0; i < 1000000; i++)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		T value = (T)(state >> (state & 63));
+		if(is_signed && (state & 64) && value > 0) value = (T)(0 - value);
+		check_integer(value, tally);
+	}
+}
+
+
+/*!
+ \brief that _itoa and _uitoa write what printf does, all the way across long and long long
+ 
+ With -x it also goes through every 32 bit value, which takes about seven minutes.
+ */
+static bool check_itoa(void)
+{
+	itoa_tally tally;
+	
+	check_integer_type<long>(tally);
+	check_integer_type<unsigned long>(tally);
+#ifndef JSON_ISO_STRICT
+	check_integer_type<long long>(tally);
+	check_integer_type<unsigned long long>(tally);
+#endif
+	
+	if(exhaustive)
+	{
+		for(long value = -2147483647L - 1; tally.wrong < 20; value++)
+		{
+			check_integer(value, tally);
+			if(value == 2147483647L) break;
+		}
+	}
+	
+	fprintf(stderr, "itoa: %lu integers written\n", tally.checked);
+	return tally.wrong == 0;
+}
+
+
+/*!
+ \brief what one Base64 code path makes of the inputs, to compare with the others
+ */
+struct base64_results
+{
+	vector<json_string> encoded;
+	vector<string> decoded;
+	vector<bool> valid;
+};
+
+
+/*!
+ \brief decode all of some text at once, noting whether it was Base64
+ */
+static void decode_base64(const json_string &encoded, base64_results &results)
+{
+	string decoded(JSONBase64::decodedSize(encoded.data(), encoded.length()) + 1, '\0');
+	results.valid.push_back(JSONBase64::json_decode64(encoded.data(), encoded.length(), (unsigned char *)&decoded[0]));
+	decoded.resize(decoded.length() - 1);
+	results.decoded.push_back(decoded);
+}
+
+
+/*!
+ \brief encode and decode everything, whole and in pieces, with whatever code libjson picks now
+ \param inputs	bytes to encode
+ \param damaged	text to decode that may not be Base64
+ \param results	what came out
+ */
+static void run_base64(const vector<string> &inputs, const vector<json_string> &damaged, base64_results &results)
+{
+	for(size_t i = 0; i < inputs.size(); i++)
+	{
+		const unsigned char *bytes = (const unsigned char *)inputs[i].data();
+		json_string encoded = JSONBase64::json_encode64(bytes, inputs[i].length());
+		results.encoded.push_back(encoded);
+		decode_base64(encoded, results);
+		
+		// pieces of odd sizes, so that groups are split across them
+		JSONBase64Encoder encoder;
+		json_string pieces(JSONBase64::encodedSize(inputs[i].length() + 2) + 4, ' ');
+		size_t written = 0;
+		for(size_t at = 0; at < inputs[i].length(); at += 7)
+			written += encoder.write(bytes + at, min((size_t)7, inputs[i].length() - at), &pieces[written]);
+		written += encoder.finish(&pieces[written]);
+		pieces.resize(written);
+		results.encoded.push_back(pieces);
+		
+		JSONBase64Decoder decoder;
+		string decoded((encoded.length() / 4 + 1) * 3 + 3, '\0');
+		written = 0;
+		for(size_t at = 0; at < encoded.length(); at += 13)
+			written += decoder.write(encoded.data() + at, min((size_t)13, encoded.length() - at),
+						 (unsigned char *)&decoded[written]);
+		written += decoder.finish((unsigned char *)&decoded[written]);
+		decoded.resize(written);
+		results.decoded.push_back(decoded);
+		results.valid.push_back(decoder.valid());
+	}
+	
+	for(size_t i = 0; i < damaged.size(); i++)
+		decode_base64(damaged[i], results);
+}
+
+
+/*!
+ \brief that the SSSE3 and AVX2 Base64 code gives exactly what the plain code does
+ 
+ Every length up to a few vectors' worth and a big one, so every way the
+ vector loops can hand the rest to the plain code is seen, and the same
+ text with a character that isn't Base64 at every place in it.  Levels
+ can only be forced in a JSON_UNIT_TEST build; otherwise only the one the
+ cpu picks is checked, and only that it decodes what it encodes.
+ */
+static bool check_base64(void)
+{
+	vector<string> inputs;
+	vector<json_string> damaged;
+	uint64_t state = 88172645463325252ULL;
+	
+	for(size_t length = 0; length <= 200; length++)
+	{
+		string input;
+		for(size_t i = 0; i < length; i++)
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			input += (char)state;
+		}
+		inputs.push_back(input);
+	}
+	string every_byte;
+	for(size_t i = 0; i < 65536; i++)
+		every_byte += (char)(i * 2654435761u >> 24);
+	inputs.push_back(every_byte);
+	
+	const json_char not_base64[] = { '!', '-', '_', '=', '\0', (json_char)0x80, (json_char)0xff };
+	for(size_t length = 4; length <= 128; length += 4)
+	{
+		json_string clean = JSONBase64::json_encode64((const unsigned char *)every_byte.data(), length / 4 * 3);
+		for(size_t at = 0; at < length; at++)
+		{
+			json_string text = clean;
+			text[at] = not_base64[at % (sizeof(not_base64) / sizeof(not_base64[0]))];
+			damaged.push_back(text);
+		}
+	}
+	
+	base64_results plain;
+#ifdef JSON_UNIT_TEST
+	JSONBase64::forceSimdLevel(0);
+#endif
+	run_base64(inputs, damaged, plain);
+	
+	bool ok = true;
+	for(size_t i = 0; i < inputs.size(); i++)
+	{
+		if(plain.decoded[i * 2] != inputs[i] || plain.decoded[i * 2 + 1] != inputs[i] ||
+		   plain.encoded[i * 2 + 1] != plain.encoded[i * 2] || !plain.valid[i * 2] || !plain.valid[i * 2 + 1])
+		{
+			fprintf(stderr, "base64: %lu bytes don't come back as they went in\n", (unsigned long)inputs[i].length());
+			ok = false;
+		}
+	}
+	
+#ifdef JSON_UNIT_TEST
+	static const char *level_names[] = { "plain", "SSSE3", "AVX2" };
+	for(int level = 1; level <= 2; level++)
+	{
+		if(!JSONBase64::forceSimdLevel(level))
+		{
+			fprintf(stderr, "base64: this cpu can't run the %s code, so it wasn't checked\n", level_names[level]);
+			continue;
+		}
+		
+		base64_results vector_results;
+		run_base64(inputs, damaged, vector_results);
+		for(size_t i = 0; i < plain.encoded.size(); i++)
+		{
+			if(vector_results.encoded[i] != plain.encoded[i])
+			{
+				fprintf(stderr, "base64: %s encodes %lu bytes differently\n", level_names[level],
+					(unsigned long)inputs[i / 2].length());
+				ok = false;
+			}
+		}
+		// what's decoded from text that isn't Base64 doesn't matter, only that it's noticed
+		for(size_t i = 0; i < plain.decoded.size(); i++)
+		{
+			if(vector_results.valid[i] != plain.valid[i] || (plain.valid[i] && vector_results.decoded[i] != plain.decoded[i]))
+			{
+				if(i < inputs.size() * 2)
+					fprintf(stderr, "base64: %s decodes %lu bytes differently\n", level_names[level],
+						(unsigned long)inputs[i / 2].length());
+				else
+					fprintf(stderr, "base64: %s decodes %s differently\n", level_names[level],
+						damaged[i - inputs.size() * 2].c_str());
+				ok = false;
+			}
+		}
+	}
+	JSONBase64::forceSimdLevel(-1);
+#endif
+	return ok;
+}
+
+
+/*!
+ \brief what a case measured, over the middle one of its runs
+ */
+struct measured
+{
+	double ns_per_op;
+	double bytes_per_second;
+	size_t ops;
+	counts per_op;
+};
+
+
+static bool faster(const pair<uint64_t, counts> &a, const pair<uint64_t, counts> &b)
+{
+	return a.first < b.first;
+}
+
+
+/*!
+ \brief run a case long enough to be worth timing, a few times over
+ \param which	the case
+ \param seconds	how long each run should take, at least
+ \param runs	how many runs to take the median of
+ */
+static measured measure(const bench_case &which, double seconds, size_t runs)
+{
+	size_t ops = 1;
+	
+	// warms the caches up as well as finding how many make a run
+	for(;;)
+	{
+		timer.start();
+		which.run(which.input, ops);
+		timer.stop();
+		if(timer.elapsed >= seconds * 1e9 || ops >= ((size_t)1 << 40)) break;
+		if(timer.elapsed * 8 < seconds * 1e9)
+			ops *= 8;
+		else
+			ops = (size_t)(ops * (seconds * 1e9 / timer.elapsed) * 1.1) + 1;
+	}
+	
+	vector<pair<uint64_t, counts> > results;
+	for(size_t run = 0; run < runs; run++)
+	{
+		timer.start();
+		which.run(which.input, ops);
+		timer.stop();
+		results.push_back(make_pair(timer.elapsed, timer.allocated));
+	}
+	
+	nth_element(results.begin(), results.begin() + runs / 2, results.end(), faster);
+	const pair<uint64_t, counts> &median = results[runs / 2];
+	
+	measured result;
+	result.ops = ops;
+	result.ns_per_op = (double)median.first / ops;
+	result.bytes_per_second = which.bytes_per_op ? which.bytes_per_op * 1e9 / result.ns_per_op : 0;
+	result.per_op.nodes = median.second.nodes / ops;
+	result.per_op.internals = median.second.internals / ops;
+	result.per_op.children = median.second.children / ops;
+	result.per_op.mallocs = median.second.mallocs / ops;
+	result.per_op.news = median.second.news / ops;
+	return result;
+}
+
+
+/*!
+ \brief print usage
+ \param prog_name	the name of the executable
+ */
+static void usage(const char *prog_name)
+{
+	fprintf(stderr, "Usage: %s [-c [-x]] [-j] [-t seconds] [-r runs] [-f file.json ...] [case ...]\n", prog_name);
+	fprintf(stderr, "\t-c\t\tcheck that the cases come out right instead of measuring them\n");
+	fprintf(stderr, "\t-x\t\tcheck every float and 32 bit integer there is instead of a sample, which takes minutes\n");
+	fprintf(stderr, "\t-j\t\tone line of JSON for each case, for comparing runs\n");
+	fprintf(stderr, "\t-t seconds\thow long each run of a case lasts, at least (0.2)\n");
+	fprintf(stderr, "\t-r runs\t\thow many runs to take the median of (5)\n");
+	fprintf(stderr, "\t-f file\t\talso measure with this document\n");
+	fprintf(stderr, "\tcase\t\tonly run cases with this in their name\n");
+}
+
+
+/*!
+ \brief measure the parts of libjson the hook leans on
+ \param argc		number of args
+ \param argv		arguments
+ */
+int main(int argc, char * const argv[])
+{
+	bool as_json = false, checking = false;
+	double seconds = 0.2;
+	size_t runs = 5;
+	vector<corpus *> corpora;
+	int option;
+
+#ifdef JSON_MEMORY_CALLBACKS
+	libjson::register_memory_callbacks(counting_malloc, counting_realloc, free);
+#endif
+	
+	add_corpus(corpora, "payload-1", make_payload(1));
+	add_corpus(corpora, "payload-100", make_payload(100));
+	add_corpus(corpora, "payload-10000", make_payload(10000));
+	add_corpus(corpora, "escapes", make_escapes());
+	add_corpus(corpora, "numbers", make_numbers());
+	
+	while((option = getopt(argc, argv, "cxjt:r:f:h")) != -1)
+	{
+		switch(option)
+		{
+			case 'c':
+				checking = true;
+				break;
+			case 'x':
+				exhaustive = true;
+				break;
+			case 'j':
+				as_json = true;
+				break;
+			case 't':
+				seconds = strtod(optarg, NULL);
+				break;
+			case 'r':
+				runs = strtoul(optarg, NULL, 10);
+				break;
+			case 'f':
+			{
+				FILE *file = fopen(optarg, "rb");
+				if(file == NULL)
+				{
+					perror(optarg);
+					return 1;
+				}
+				json_string text;
+				char buffer[65536];
+				size_t got;
+				while((got = fread(buffer, 1, sizeof(buffer), file)) > 0)
+					text.append(buffer, got);
+				fclose(file);
+				
+				const char *name = strrchr(optarg, '/');
+				if(!add_corpus(corpora, name ? name + 1 : optarg, text)) return 1;
+				break;
+			}
+			default:
+				usage(argv[0]);
+				return option == 'h' ? 0 : 1;
+		}
+	}
+	
+	if(runs == 0 || seconds <= 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	
+	if(checking)
+	{
+		check_case checks[] =
+		{
+			{ "escapes", check_escapes },
+			{ "nesting", check_nesting },
+			{ "numbers", check_numbers },
+			{ "ftoa", check_ftoa },
+			{ "itoa", check_itoa },
+			{ "base64", check_base64 },
+		};
+		int failed = 0;
+		
+		for(size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++)
+		{
+			bool wanted = optind == argc;
+			for(int arg = optind; arg < argc; arg++)
+				if(checks[i].name.find(argv[arg]) != string::npos) wanted = true;
+			if(!wanted) continue;
+			
+			bool ok = checks[i].run();
+			printf("%-30s %s\n", checks[i].name.c_str(), ok ? "ok" : "FAILED");
+			fflush(stdout);
+			if(!ok) failed++;
+		}
+		
+		for(size_t i = 0; i < corpora.size(); i++)
+			delete corpora[i];
+		return failed == 0 ? 0 : 1;
+	}
+	
+	binary.resize(65536);
+	for(size_t i = 0; i < binary.size(); i++)
+		binary[i] = (unsigned char)(i * 2654435761u >> 24);
+	encoded = JSONBase64::json_encode64(&binary[0], binary.size());
+	for(size_t i = 0; i < number_count; i++)
+	{
+		whole_numbers[i] = (json_int_t)(i * 2654435761u) - (json_int_t)(i * 40503u);
+		real_numbers[i] = (i * 2654435761u % 1000000) / 997.0 - 500.0;
+	}
+	
+	vector<bench_case> cases;
+	for(size_t i = 0; i < corpora.size(); i++)
+	{
+		const corpus *input = corpora[i];
+		size_t string_bytes = 0;
+		for(size_t s = 0; s < input->strings.size(); s++)
+			string_bytes += input->strings[s].length();
+		
+		bench_case each[] =
+		{
+			{ "parse/" + input->name, input->text.length(), run_parse, input },
+#ifdef JSON_VALIDATE
+			{ "validate/" + input->name, input->text.length(), run_validate, input },
+#endif
+			{ "fetch/" + input->name, input->text.length(), run_fetch, input },
+			{ "write/" + input->name, input->tree.write().length(), run_write, input },
+			{ "write_formatted/" + input->name, input->tree.write_formatted().length(), run_write_formatted, input },
+			{ "unfix/" + input->name, string_bytes, run_unfix, input },
+#ifdef JSON_STREAM
+			{ "stream/" + input->name, input->text.length(), run_stream, input },
+#endif
+		};
+		cases.insert(cases.end(), each, each + sizeof(each) / sizeof(each[0]));
+	}
+	
+	bench_case others[] =
+	{
+		{ "base64-encode/64k", binary.size(), run_encode64, NULL },
+		{ "base64-decode/64k", encoded.length(), run_decode64, NULL },
+		{ "itoa", 0, run_itoa, NULL },
+		{ "itoa/snprintf", 0, run_itoa_snprintf, NULL },
+		{ "ftoa", 0, run_ftoa, NULL },
+		{ "children/16", 0, run_children<16>, NULL },
+		{ "children/1024", 0, run_children<1024>, NULL },
+	};
+	cases.insert(cases.end(), others, others + sizeof(others) / sizeof(others[0]));
+	
+	if(!as_json)
+		printf("%-30s %12s %10s %9s %9s %9s %9s %9s\n", "case", "ns/op", "MB/s",
+		       "nodes/op", "intern/op", "child/op", "json/op", "new/op");
+	
+	for(size_t i = 0; i < cases.size(); i++)
+	{
+		const bench_case &which = cases[i];
+		bool wanted = optind == argc;
+		for(int arg = optind; arg < argc; arg++)
+			if(which.name.find(argv[arg]) != string::npos) wanted = true;
+		if(!wanted) continue;
+		
+		measured got = measure(which, seconds, runs);
+		if(as_json)
+			printf("{\"case\":\"%s\",\"ns_per_op\":%.1f,\"bytes_per_op\":%lu,\"bytes_per_second\":%.0f,"
+			       "\"ops\":%lu,\"allocs_per_op\":{\"nodes\":%.2f,\"internals\":%.2f,\"children\":%.2f,"
+			       "\"json_malloc\":%.2f,\"new\":%.2f}}\n",
+			       which.name.c_str(), got.ns_per_op, (unsigned long)which.bytes_per_op,
+			       got.bytes_per_second, (unsigned long)got.ops, got.per_op.nodes,
+			       got.per_op.internals, got.per_op.children, got.per_op.mallocs, got.per_op.news);
+		else
+			printf("%-30s %12.1f %10.1f %9.2f %9.2f %9.2f %9.2f %9.2f\n", which.name.c_str(),
+			       got.ns_per_op, got.bytes_per_second / 1e6, got.per_op.nodes,
+			       got.per_op.internals, got.per_op.children, got.per_op.mallocs, got.per_op.news);
+		fflush(stdout);
+	}
+	
+	for(size_t i = 0; i < corpora.size(); i++)
+		delete corpora[i];
+	return 0;
+}
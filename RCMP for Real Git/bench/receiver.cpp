@@ -0,0 +1,432 @@
+//
+//  receiver.cpp
+//  RCMP for Real Git
+//
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#include "receiver.h"
+#include "../timing.h"
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <deque>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+static const char ok_response[] =
+	"HTTP/1.1 200 OK\r\n"
+	"Content-Type: text/plain\r\n"
+	"Content-Length: 2\r\n"
+	"\r\n"
+	"ok";
+
+static const char invalid_response[] =
+	"HTTP/1.1 400 Bad Request\r\n"
+	"Content-Type: text/plain\r\n"
+	"Content-Length: 7\r\n"
+	"\r\n"
+	"invalid";
+
+static const char error_response[] =
+	"HTTP/1.1 500 Internal Server Error\r\n"
+	"Content-Type: text/plain\r\n"
+	"Content-Length: 5\r\n"
+	"\r\n"
+	"error";
+
+
+/*!
+ \brief an answer waiting for its time to go out
+ */
+struct pending_answer
+{
+	uint64_t due;
+	const char *text;	// NULL to reset the connection instead
+	size_t length;
+	bool close_after;
+	uint64_t started;
+	request_record record;
+};
+
+
+/*!
+ \brief one connection, and whatever it has sent that hasn't been answered
+ */
+struct client
+{
+	int fd;
+	string pending;
+	uint64_t started;	// when the first byte of the request at the front of pending came
+	deque<pending_answer> answers;
+};
+
+
+static volatile sig_atomic_t stopping = 0;
+
+
+static void stop_serving(int)
+{
+	stopping = 1;
+}
+
+
+/*!
+ \brief a number from 0 up to 1, the same ones every time for the same seed
+ */
+static double chance(unsigned &state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state / 4294967296.0;
+}
+
+
+/*!
+ \brief undo a form's encoding
+ */
+static string form_decode(const char *from, size_t length)
+{
+	string res;
+	
+	res.reserve(length);
+	for(size_t i = 0; i < length; i++)
+	{
+		if(from[i] == '+')
+			res += ' ';
+		else if(from[i] == '%' && i + 2 < length && isxdigit(from[i + 1]) && isxdigit(from[i + 2]))
+		{
+			char hex[3] = { from[i + 1], from[i + 2], '\0' };
+			res += (char)strtoul(hex, NULL, 16);
+			i += 2;
+		}
+		else
+			res += from[i];
+	}
+	return res;
+}
+
+
+/*!
+ \brief the JSON a request carries
+ \param body		the request's body
+ \param length	how long it is
+ \param form		whether it's a form post, then the JSON is in the payload field
+ */
+static string payload_of(const char *body, size_t length, bool form)
+{
+	if(!form) return string(body, length);
+	
+	for(size_t start = 0; start < length;)
+	{
+		const char *end = (const char *)memchr(body + start, '&', length - start);
+		size_t field_end = end == NULL ? length : end - body;
+		if(field_end - start >= 8 && memcmp(body + start, "payload=", 8) == 0)
+			return form_decode(body + start + 8, field_end - start - 8);
+		start = field_end + 1;
+	}
+	return string();
+}
+
+
+/*!
+ \brief turn every whole request that has come in on a connection into an answer
+ \param conn		the connection
+ \param options	how to answer
+ \param random	for picking which to fail
+ \param now		when the requests were read
+ */
+static void take_requests(client &conn, const receiver_options &options, unsigned &random, uint64_t now)
+{
+	for(;;)
+	{
+		size_t header_end = conn.pending.find("\r\n\r\n");
+		if(header_end == string::npos) return;
+		
+		size_t length = 0;
+		bool close_after = false, form = false;
+		size_t line = conn.pending.find("\r\n") + 2;
+		while(line < header_end)
+		{
+			size_t next = conn.pending.find("\r\n", line);
+			const char *header = conn.pending.c_str() + line;
+			if(strncasecmp(header, "Content-Length:", 15) == 0)
+				length = strtoul(header + 15, NULL, 10);
+			else if(strncasecmp(header, "Connection:", 11) == 0 &&
+				conn.pending.compare(line + 11, next - line - 11, " close") == 0)
+				close_after = true;
+			else if(strncasecmp(header, "Content-Type:", 13) == 0 &&
+				conn.pending.find("x-www-form-urlencoded", line) < next)
+				form = true;
+			line = next + 2;
+		}
+		
+		size_t request_end = header_end + 4 + length;
+		if(conn.pending.length() < request_end) return;
+		
+		pending_answer answer;
+		const char *body = conn.pending.data() + header_end + 4;
+		answer.record.bytes = request_end;
+		answer.record.payload_bytes = length;
+		answer.record.valid = true;
+		if(options.validate != NULL || options.record != NULL)
+		{
+			// libAmy doesn't always say it's a form, but the hook's always start the same way
+			form = form || (length >= 8 && memcmp(body, "payload=", 8) == 0);
+			string json = payload_of(body, length, form);
+			answer.record.payload_bytes = json.length();
+			if(options.validate != NULL)
+				answer.record.valid = options.validate(json.data(), json.length());
+		}
+		
+		if(options.reset_share > 0 && chance(random) < options.reset_share)
+		{
+			answer.text = NULL;
+			answer.length = 0;
+			answer.record.status = 0;
+		}
+		else if(options.error_share > 0 && chance(random) < options.error_share)
+		{
+			answer.text = error_response;
+			answer.length = sizeof(error_response) - 1;
+			answer.record.status = 500;
+		}
+		else if(!answer.record.valid)
+		{
+			answer.text = invalid_response;
+			answer.length = sizeof(invalid_response) - 1;
+			answer.record.status = 400;
+		}
+		else
+		{
+			answer.text = ok_response;
+			answer.length = sizeof(ok_response) - 1;
+			answer.record.status = 200;
+		}
+		answer.due = now + options.delay_ms * (uint64_t)1000000;
+		answer.close_after = close_after;
+		answer.started = conn.started;
+		conn.answers.push_back(answer);
+		
+		conn.pending.erase(0, request_end);
+		conn.started = now;
+	}
+}
+
+
+/*!
+ \brief send the answers on a connection whose time has come
+ \param conn		the connection
+ \param options	who to tell
+ \param now		what time it is
+ \returns whether it should stay open
+ */
+static bool send_answers(client &conn, const receiver_options &options, uint64_t now)
+{
+	while(!conn.answers.empty() && conn.answers.front().due <= now)
+	{
+		pending_answer &answer = conn.answers.front();
+		
+		if(answer.text == NULL)
+		{
+			// closing with a zero linger sends a reset instead of a FIN
+			struct linger hard;
+			hard.l_onoff = 1;
+			hard.l_linger = 0;
+			setsockopt(conn.fd, SOL_SOCKET, SO_LINGER, &hard, sizeof(hard));
+		}
+		else if(write(conn.fd, answer.text, answer.length) != (ssize_t)answer.length)
+			return false;
+		
+		if(options.record != NULL)
+		{
+			answer.record.latency_ns = timing_now() - answer.started;
+			options.record(answer.record, options.context);
+		}
+		if(answer.text == NULL || answer.close_after) return false;
+		conn.answers.pop_front();
+	}
+	
+	return true;
+}
+
+
+/*!
+ \brief take connections until told to stop
+ \param listener	the listening socket
+ \param options	how to answer
+ */
+static void serve(int listener, const receiver_options &options)
+{
+	vector<client> clients;
+	vector<struct pollfd> polled;
+	char buffer[65536];
+	unsigned random = options.seed != 0 ? options.seed : 1;
+	
+	while(!stopping)
+	{
+		polled.resize(clients.size() + 1);
+		polled[0].fd = listener;
+		polled[0].events = POLLIN;
+		
+		// wake up for the next held back answer
+		int timeout = -1;
+		uint64_t now = timing_now();
+		for(size_t i = 0; i < clients.size(); i++)
+		{
+			polled[i + 1].fd = clients[i].fd;
+			polled[i + 1].events = POLLIN;
+			if(clients[i].answers.empty()) continue;
+			
+			uint64_t due = clients[i].answers.front().due;
+			int wait = due <= now ? 0 : (int)((due - now + 999999) / 1000000);
+			if(timeout == -1 || wait < timeout) timeout = wait;
+		}
+		
+		if(poll(&polled[0], polled.size(), timeout) == -1) continue;
+		now = timing_now();
+		
+		// backwards, so that closing one doesn't move the ones still to look at
+		for(size_t i = clients.size(); i > 0; i--)
+		{
+			client &conn = clients[i - 1];
+			bool open = true;
+			
+			if(polled[i].revents != 0)
+			{
+				ssize_t got = read(conn.fd, buffer, sizeof(buffer));
+				if(got > 0)
+				{
+					if(conn.pending.empty()) conn.started = now;
+					conn.pending.append(buffer, got);
+					take_requests(conn, options, random, now);
+				}
+				else
+					open = false;
+			}
+			
+			if(!open || !send_answers(conn, options, now))
+			{
+				close(conn.fd);
+				clients.erase(clients.begin() + (i - 1));
+			}
+		}
+		
+		if(polled[0].revents & POLLIN)
+		{
+			client conn;
+			conn.fd = accept(listener, NULL, NULL);
+			conn.started = now;
+			if(conn.fd != -1) clients.push_back(conn);
+		}
+	}
+	
+	for(size_t i = 0; i < clients.size(); i++)
+		close(clients[i].fd);
+	close(listener);
+}
+
+
+receiver::receiver() : child(-1)
+{
+	address[0] = '\0';
+}
+
+
+receiver::~receiver()
+{
+	stop();
+}
+
+
+/*!
+ \brief open a socket listening on the loopback interface
+ \param port	the port, 0 for any free one
+ \returns the socket, or -1 if there isn't one
+ */
+int receiver::listen_on(unsigned short port)
+{
+	struct sockaddr_in where;
+	socklen_t where_len = sizeof(where);
+	int reuse = 1;
+	
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	if(listener == -1) return -1;
+	
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	memset(&where, 0, sizeof(where));
+	where.sin_family = AF_INET;
+	where.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	where.sin_port = htons(port);
+	if(bind(listener, (struct sockaddr *)&where, sizeof(where)) != 0 ||
+	   listen(listener, 128) != 0 ||
+	   getsockname(listener, (struct sockaddr *)&where, &where_len) != 0)
+	{
+		perror("can't start receiver");
+		close(listener);
+		return -1;
+	}
+	
+	snprintf(address, sizeof(address), "http://127.0.0.1:%u/", ntohs(where.sin_port));
+	return listener;
+}
+
+
+bool receiver::start(const receiver_options &options)
+{
+	int listener = listen_on(options.port);
+	if(listener == -1) return false;
+	
+	// listening before the fork, so nobody can connect before it's ready
+	child = fork();
+	if(child == 0)
+	{
+		signal(SIGPIPE, SIG_IGN);
+		serve(listener, options);
+		_exit(0);
+	}
+	close(listener);
+	return child != -1;
+}
+
+
+bool receiver::run(const receiver_options &options, void (*ready)(const char *url))
+{
+	struct sigaction stop_on;
+	
+	int listener = listen_on(options.port);
+	if(listener == -1) return false;
+	
+	// no SA_RESTART, so that poll gives up when one comes
+	memset(&stop_on, 0, sizeof(stop_on));
+	stop_on.sa_handler = stop_serving;
+	sigaction(SIGINT, &stop_on, NULL);
+	sigaction(SIGTERM, &stop_on, NULL);
+	signal(SIGPIPE, SIG_IGN);
+	
+	if(ready != NULL) ready(address);
+	serve(listener, options);
+	return true;
+}
+
+
+void receiver::stop()
+{
+	if(child <= 0) return;
+	
+	kill(child, SIGTERM);
+	waitpid(child, NULL, 0);
+	child = -1;
+}
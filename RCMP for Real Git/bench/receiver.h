@@ -0,0 +1,112 @@
+//
+//  receiver.h
+//  RCMP for Real Git
+//
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#ifndef __rcmp_receiver_h_
+#define __rcmp_receiver_h_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+
+/*!
+ \brief what happened to one request
+ */
+struct request_record
+{
+	size_t bytes;		// the whole request, headers and all
+	size_t payload_bytes;	// the JSON, once it's out of the form
+	int status;		// 0 if the connection was reset instead
+	bool valid;		// whether the JSON was, true if nothing checked
+	uint64_t latency_ns;	// from its first byte to the end of the answer
+};
+
+
+/*!
+ \brief how the receiver behaves, the defaults answer everything at once
+ */
+struct receiver_options
+{
+	unsigned short port;	// 0 for any free one
+	unsigned delay_ms;	// how long to hold each answer back
+	double error_share;	// how many to answer with a 500
+	double reset_share;	// how many to reset the connection on instead
+	unsigned seed;		// for picking which
+	
+	/*!
+	 \brief checks the JSON of each request, NULL to take anything
+ 
+	 The JSON is the payload field of a form post, or the whole body of
+	 anything else.  Requests it turns down are answered with a 400.
+	 */
+	bool (*validate)(const char *json, size_t length);
+	
+	/*!
+	 \brief told about each request once it's been answered, can be NULL
+	 */
+	void (*record)(const request_record &request, void *context);
+	void *context;
+	
+	receiver_options() : port(0), delay_ms(0), error_share(0), reset_share(0), seed(1),
+			     validate(NULL), record(NULL), context(NULL) {}
+};
+
+
+/*!
+ \brief a stand-in for the Web hook at the other end
+ 
+ It answers every POST with a 200 and throws the body away, so what's timed
+ is the hook and not somebody's server.  Answers can be held back, turned into
+ errors or replaced by resets, so that the hook can be measured against a
+ server that isn't so kind.  It takes any number of keep-alive connections at
+ once, and a held back answer doesn't hold up the other connections.
+ */
+class receiver
+{
+public:
+	receiver();
+	~receiver();
+	
+	/*!
+	 \brief start listening in a process of its own
+	 \param options	how to behave
+	 \returns whether it's ready for connections
+ 
+	 The process keeps it from counting against the memory of whatever is
+	 being measured.
+	 */
+	bool start(const receiver_options &options = receiver_options());
+	
+	/*!
+	 \brief listen in this process until SIGINT or SIGTERM
+	 \param options	how to behave
+	 \param ready		called with the URL once it's listening, can be NULL
+	 \returns whether it could listen
+	 */
+	bool run(const receiver_options &options, void (*ready)(const char *url) = NULL);
+	
+	/*!
+	 \brief stop the process started by start() and wait for it to go away
+	 */
+	void stop();
+	
+	/*!
+	 \brief the URL to give to the hook
+	 */
+	const char *url() const { return address; }
+
+private:
+	pid_t child;
+	char address[64];
+	
+	int listen_on(unsigned short port);
+	
+	receiver(const receiver &);
+	receiver &operator=(const receiver &);
+};
+
+#endif
@@ -0,0 +1,194 @@
+//
+//  sink.cpp
+//  RCMP for Real Git
+//
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "../json/libjson.h"
+#include "receiver.h"
+using namespace std;
+
+
+/*!
+ \brief everything the sink was sent
+ */
+struct sink_totals
+{
+	map<int, size_t> statuses;	// 0 for the resets
+	size_t invalid;
+	unsigned long long bytes;
+	unsigned long long payload_bytes;
+	vector<double> latencies;	// in milliseconds
+	FILE *log;
+	
+	sink_totals() : invalid(0), bytes(0), payload_bytes(0), log(NULL) {}
+};
+
+
+/*!
+ \brief check a payload the same way libjson would before parsing it
+ */
+static bool validate_json(const char *json, size_t length)
+{
+	return JSONValidator::isValidDocument(json, length);
+}
+
+
+/*!
+ \brief count a request, and log it if there's a log
+ \param request	what happened to it
+ \param context	the sink_totals
+ */
+static void record_request(const request_record &request, void *context)
+{
+	sink_totals &totals = *(sink_totals *)context;
+	
+	totals.statuses[request.status]++;
+	if(!request.valid) totals.invalid++;
+	totals.bytes += request.bytes;
+	totals.payload_bytes += request.payload_bytes;
+	totals.latencies.push_back(request.latency_ns / 1e6);
+	
+	if(totals.log != NULL)
+	{
+		fprintf(totals.log, "%d %lu %lu %d %.3f\n", request.status, (unsigned long)request.bytes,
+			(unsigned long)request.payload_bytes, request.valid ? 1 : 0, request.latency_ns / 1e6);
+		fflush(totals.log);
+	}
+}
+
+
+/*!
+ \brief say where to send things, for whatever is waiting on it
+ */
+static void print_url(const char *url)
+{
+	printf("listening on %s\n", url);
+	fflush(stdout);
+}
+
+
+/*!
+ \brief the latency below which the given share of the requests were answered
+ */
+static double percentile(const vector<double> &sorted, double share)
+{
+	size_t rank = (size_t)(share * sorted.size() + 0.999999);
+	if(rank == 0) rank = 1;
+	return sorted[min(rank, sorted.size()) - 1];
+}
+
+
+/*!
+ \brief print usage
+ \param prog_name	the name of the executable
+ */
+static void usage(const char *prog_name)
+{
+	fprintf(stderr, "Usage: %s [-p port] [-d ms] [-e share] [-r share] [-s seed] [-l file] [-n]\n", prog_name);
+	fprintf(stderr, "\t-p port\t\twhere to listen, on 127.0.0.1 (any free port)\n");
+	fprintf(stderr, "\t-d ms\t\thow long to hold each answer back (0)\n");
+	fprintf(stderr, "\t-e share\thow many requests to answer with a 500, 0.1 is one in ten (0)\n");
+	fprintf(stderr, "\t-r share\thow many connections to reset instead of answering (0)\n");
+	fprintf(stderr, "\t-s seed\t\tfor picking which, the same seed picks the same ones (1)\n");
+	fprintf(stderr, "\t-l file\t\ta line for each request: status, bytes, JSON bytes, valid, ms\n");
+	fprintf(stderr, "\t-n\t\tdon't check the JSON\n");
+}
+
+
+/*!
+ \brief take the hook's deliveries until interrupted, then say what came in
+ \param argc		number of args
+ \param argv		arguments
+ */
+int main(int argc, char * const argv[])
+{
+	receiver_options options;
+	sink_totals totals;
+	const char *log_path = NULL;
+	bool validate = true;
+	int option;
+	
+	while((option = getopt(argc, argv, "p:d:e:r:s:l:nh")) != -1)
+	{
+		switch(option)
+		{
+			case 'p':
+				options.port = (unsigned short)strtoul(optarg, NULL, 10);
+				break;
+			case 'd':
+				options.delay_ms = strtoul(optarg, NULL, 10);
+				break;
+			case 'e':
+				options.error_share = strtod(optarg, NULL);
+				break;
+			case 'r':
+				options.reset_share = strtod(optarg, NULL);
+				break;
+			case 's':
+				options.seed = strtoul(optarg, NULL, 10);
+				break;
+			case 'l':
+				log_path = optarg;
+				break;
+			case 'n':
+				validate = false;
+				break;
+			default:
+				usage(argv[0]);
+				return option == 'h' ? 0 : 1;
+		}
+	}
+	
+	if(optind != argc || options.error_share < 0 || options.error_share > 1 ||
+	   options.reset_share < 0 || options.reset_share > 1)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	
+	if(log_path != NULL && (totals.log = fopen(log_path, "w")) == NULL)
+	{
+		perror("can't open the log");
+		return 1;
+	}
+	
+	options.validate = validate ? validate_json : NULL;
+	options.record = record_request;
+	options.context = &totals;
+	
+	receiver sink;
+	if(!sink.run(options, print_url)) return 1;
+	if(totals.log != NULL) fclose(totals.log);
+	
+	size_t requests = totals.latencies.size();
+	printf("requests    %lu", (unsigned long)requests);
+	for(map<int, size_t>::const_iterator status = totals.statuses.begin(); status != totals.statuses.end(); ++status)
+	{
+		if(status->first == 0)
+			printf(", %lu reset", (unsigned long)status->second);
+		else
+			printf(", %lu %d", (unsigned long)status->second, status->first);
+	}
+	printf("\n");
+	if(validate)
+		printf("invalid     %lu\n", (unsigned long)totals.invalid);
+	printf("received    %llu bytes, %llu of JSON\n", totals.bytes, totals.payload_bytes);
+	
+	if(requests > 0)
+	{
+		sort(totals.latencies.begin(), totals.latencies.end());
+		printf("latency     p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+		       percentile(totals.latencies, 0.50), percentile(totals.latencies, 0.90),
+		       percentile(totals.latencies, 0.99), totals.latencies.back());
+	}
+	
+	return 0;
+}
@@ -0,0 +1,402 @@
+//
+//  git_hook.cpp
+//  RCMP for Real Git
+//
+//  Created by Andrew Wilcox on 2012-Aug-13.
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#include <git2.h>
+#include "git_hook.h"
+#include <libAmy/libAmy.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "timing.h"
+#include "metrics.h"
+using namespace std;
+
+
+/*!
+ http://bytes.com/topic/c/answers/216710-does-ansi-c-have-something-like-pathmax-max_path
+ 
+ windows can be anywhere from 260 to 32000 bytes
+ HP-UX thinks it can only handle 14 chars just because it read UFS1
+ OpenBSD thinks it can only handle 1024, unless it's on NFS
+ so, screw yo' constant
+ */
+#define MAGIC_PATH_SIZE_BECAUSE_EVERY_OS_SUCKS	32768
+
+
+
+#ifndef I_AM_NOT_SANE
+#	define PATH_LEN MAGIC_PATH_SIZE_BECAUSE_EVERY_OS_SUCKS
+#else /* you aren't sane */
+#	include <cstdio>
+#	define PATH_LEN FILENAME_MAX
+#endif
+
+
+
+/*!
+ \brief names used by every commit
+ 
+ These are interned once so that each commit's nodes point at them instead of
+ carrying their own copies, and so looking them up compares pointers.
+ */
+static const json_key key_id = JSONKeys::intern("id");
+static const json_key key_message = JSONKeys::intern("message");
+static const json_key key_timestamp = JSONKeys::intern("timestamp");
+static const json_key key_author = JSONKeys::intern("author");
+static const json_key key_name = JSONKeys::intern("name");
+static const json_key key_email = JSONKeys::intern("email");
+static const json_key key_url = JSONKeys::intern("url");
+static const json_key key_added = JSONKeys::intern("added");
+static const json_key key_modified = JSONKeys::intern("modified");
+static const json_key key_removed = JSONKeys::intern("removed");
+static const json_key key_file = JSONKeys::intern("file");
+
+
+
+/*!
+ \brief determine what changed for this file, and add to json
+ \param json		JSONNode for the commit detail
+ \param delta		this file's change delta
+ \param progress	how slow we're going through the repo
+ 
+ This method is used as a callback to determine the changes of each file and add
+ each file to the correct JSON array.
+ */
+int handle_wtf_changed(const git_diff_delta *delta, float progress, void *json)
+{
+	const char *path;
+	json_key list;
+	JSONNode *root_node = static_cast<JSONNode *>(json);
+	
+	switch(delta->status)
+	{
+		case GIT_DELTA_ADDED:
+			list = key_added;
+			path = delta->new_file.path;
+			break;
+		case GIT_DELTA_MODIFIED:
+			list = key_modified;
+			path = delta->new_file.path;
+			break;
+		case GIT_DELTA_DELETED:
+			list = key_removed;
+			path = delta->old_file.path;
+			break;
+		default:
+			return 0;
+	}
+	
+	// append in place, popping the array off and pushing it back copied it
+	(*root_node)[list].emplace_back(key_file, path);
+	return 0;
+}
+
+
+/*!
+ \brief step the revision walker, counting the time against the walk
+ \param oid		where the next commit's ID goes
+ \param walker	the revision walker
+ */
+static int timed_revwalk_next(git_oid *oid, git_revwalk *walker)
+{
+	phase_timer timer(PHASE_REVWALK);
+	return git_revwalk_next(oid, walker);
+}
+
+
+/*!
+ \brief do stuff with git
+ \param path		the path to the git repo
+ \param old_id		the old commit ID
+ \param new_id		the new commit ID
+ \param ref_name	the name of the ref we're parsing (ref/name/master etc)
+ 
+ This is what main() would look like if we didn't have to sanitise because users
+ are lusers.
+ */
+JSONNode *git_hook_main(const char *path, const char *old_id, const char *new_id,
+			const char *ref_name)
+{
+	JSONNode *webhook_node, commit_array(JSON_ARRAY), repo_node;
+	git_repository *repo;
+	git_oid old_oid, new_oid, last_oid;
+	git_revwalk *walker_tx_rgr;
+	git_commit *curr_commit;
+	uint64_t started = metrics_enabled ? timing_now() : 0;
+	size_t commits = 0, diffs_done = 0;
+	
+	/* Get the git */
+	phase_timer opening(PHASE_REPO_OPEN);
+	if(git_repository_open(&repo, path) != 0)
+	{
+		fprintf(stderr, "Error opening git repository\n");
+		metrics_payload_failed();
+		return NULL;
+	}
+	opening.stop();
+	
+	
+	/* Convert the strings to git oids */
+	git_oid_fromstr(&old_oid, old_id);
+	git_oid_fromstr(&new_oid, new_id);
+	
+	
+	/* Create our revision walker */
+	phase_timer walking(PHASE_REVWALK);
+	git_revwalk_new(&walker_tx_rgr, repo);
+	git_revwalk_sorting(walker_tx_rgr, GIT_SORT_TIME | GIT_SORT_REVERSE);
+	git_revwalk_push(walker_tx_rgr, &new_oid);
+	git_revwalk_hide(walker_tx_rgr, &old_oid);
+	walking.stop();
+	
+	
+	/* Set up the basic JSON stuff that won't change */
+	phase_timer building(PHASE_JSON);
+	webhook_node = new JSONNode;
+	webhook_node->emplace_back("before", old_id);
+	webhook_node->emplace_back("after", new_id);
+	webhook_node->emplace_back("ref", ref_name);
+	
+	commit_array.set_name("commits");
+	
+	repo_node.set_name("repository");
+	repo_node.emplace_back("name", "No Name Set");
+	repo_node.emplace_back("url", git_repository_path(repo));
+	
+	JSONNode owner(JSON_NODE);
+	owner.set_name("owner");
+	owner.emplace_back("name", "Wilcox Technologies");
+	repo_node.push_back(json_move(owner));
+	
+	// XXX
+	// this will never change between refs (at least, it shouldn't)?
+	// cache this somehow
+	char *path_to_desc = NULL;
+	asprintf(&path_to_desc, "%s/description", git_repository_path(repo));
+	if(path_to_desc != NULL)
+	{
+		FILE *desc_file = fopen(path_to_desc, "r");
+		if(desc_file != NULL)
+		{
+			char *repo_desc = static_cast<char *>(malloc(4096));
+			if(repo_desc != NULL)
+			{
+				fread(repo_desc, 4096, 1, desc_file);
+				repo_node.emplace_back("description", repo_desc);
+				free(repo_desc);
+			}
+			
+			fclose(desc_file);
+		}
+		
+		free(path_to_desc);
+	}
+	building.stop();
+	
+	
+	// walk commits, adding to array
+	last_oid = old_oid;
+	
+	while((timed_revwalk_next(&new_oid, walker_tx_rgr)) == 0)
+	{
+		JSONNode commit_details, author_node;
+		git_diff_list *diffs;
+		git_tree *old_tree, *new_tree;
+		git_commit *last_commit;
+		char raw_oid[41] = "";
+		
+		// the ID is filled in below, by the time the span ends
+		trace_span commit_span("commit", raw_oid);
+		commits++;
+		phase_timer looking_up(PHASE_REVWALK);
+		if(git_commit_lookup(&curr_commit, repo, &new_oid) != 0)
+			continue;
+		if(git_commit_lookup(&last_commit, repo, &last_oid) != 0)
+			continue;
+		looking_up.stop();
+		
+		phase_timer building_commit(PHASE_JSON);
+		time_t raw_commit_time = git_commit_time(curr_commit);
+		struct tm *time = gmtime(&raw_commit_time);
+		char pretty_time[27];
+		strftime(pretty_time, 27, "%FT%H:%M:%S-00:00", time);
+		
+		git_oid_fmt(raw_oid, &new_oid);
+		raw_oid[40] = '\0';
+		
+		commit_details.emplace_back(key_id, raw_oid);
+		commit_details.emplace_back(key_message, git_commit_message(curr_commit));
+		commit_details.emplace_back(key_timestamp, pretty_time);
+		
+		const git_signature *author = git_commit_author(curr_commit);
+		author_node.emplace_back(key_name, author->name);
+		author_node.emplace_back(key_email, author->email);
+		author_node.set_name(key_author);
+		commit_details.push_back(json_move(author_node));
+		commit_details.emplace_back(key_url, "http://localhost/");
+		
+		JSONNode added(JSON_ARRAY), modified(JSON_ARRAY), removed(JSON_ARRAY);
+		added.set_name(key_added);
+		modified.set_name(key_modified);
+		removed.set_name(key_removed);
+		
+		commit_details.push_back(json_move(added));
+		commit_details.push_back(json_move(modified));
+		commit_details.push_back(json_move(removed));
+		building_commit.stop();
+		
+		// XXX XXX
+		// does not check return values of any of the following calls
+		phase_timer diffing(PHASE_DIFF);
+		git_commit_tree(&old_tree, last_commit);
+		git_commit_tree(&new_tree, curr_commit);
+		
+		git_diff_tree_to_tree(&diffs, repo, old_tree, new_tree, NULL);
+		git_diff_foreach(diffs, handle_wtf_changed, NULL, NULL, &commit_details);
+		git_diff_list_free(diffs);
+		diffing.stop();
+		diffs_done++;
+		// end XXX XXX
+		
+		commit_array.push_back(json_move(commit_details));
+		
+		git_commit_free(curr_commit);
+		
+		last_oid = new_oid;
+	}
+	
+	
+	webhook_node->push_back(json_move(commit_array));
+	webhook_node->push_back(json_move(repo_node));
+	
+	
+	/* clean up */
+	git_revwalk_free(walker_tx_rgr);
+	git_repository_free(repo);
+	
+	if(metrics_enabled)
+		metrics_payload(timing_now() - started, commits, diffs_done);
+	return webhook_node;
+}
+
+
+/*!
+ \brief whether a byte goes into a form as it is
+ */
+static inline bool form_safe(unsigned char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+	       c == '-' || c == '_' || c == '.' || c == '~';
+}
+
+
+/*!
+ \brief form encode a payload as the payload field
+ \param json		the payload
+ \param payload	where it goes
+ 
+ The size is counted first, so the payload is allocated once at its full
+ size instead of growing as it's encoded.
+ */
+static void form_encode(const json_string &json, string &payload)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	static const char field[] = "payload=";
+	size_t length = sizeof(field) - 1;
+	
+	for(size_t i = 0; i < json.length(); i++)
+		length += form_safe(json[i]) ? 1 : 3;
+	
+	payload.resize(length);
+	char *out = &payload[0];
+	memcpy(out, field, sizeof(field) - 1);
+	out += sizeof(field) - 1;
+	for(size_t i = 0; i < json.length(); i++)
+	{
+		unsigned char c = json[i];
+		if(form_safe(c))
+			*out++ = c;
+		else
+		{
+			*out++ = '%';
+			*out++ = hex[c >> 4];
+			*out++ = hex[c & 15];
+		}
+	}
+}
+
+
+/*!
+ \brief send a payload to one URL
+ \param conn		the connection to the URL
+ \param node		the payload
+ \param endpoint	which URL it is, counting from the first one
+ \param url		the URL
+ \param sent		if not NULL, the bytes sent are added to it
+ 
+ The payload is written out and form encoded again for each URL, since
+ nothing says they all want the same thing.
+ */
+bool git_hook_send(WTConnection *conn, JSONNode *node, int endpoint, const char *url,
+		   size_t *sent)
+{
+	char *result;
+	
+	phase_timer writing(PHASE_WRITE, endpoint);
+	json_string json = node->write();
+	writing.stop();
+	
+	phase_timer encoding(PHASE_URLENCODE, endpoint);
+	string payload;
+	form_encode(json, payload);
+	encoding.stop();
+	
+	uint64_t len = payload.length();
+#ifdef DEBUG
+	fprintf(stderr, "POSTing %s (%llu bytes) to %s\n", payload.c_str(), len, url);
+#endif
+	phase_timer uploading(PHASE_UPLOAD, endpoint);
+	uint64_t upload_start = metrics_enabled ? timing_now() : 0;
+	result = static_cast<char *>(conn->upload(payload.c_str(), &len));
+	uint64_t upload_ns = metrics_enabled ? timing_now() - upload_start : 0;
+	uploading.stop();
+#ifdef DEBUG
+	if(result != NULL)
+		fprintf(stderr, "result: %s\n(%llu bytes)", result, len);
+#endif
+	bool answered = result != NULL;
+	free(result);
+	
+	metrics_upload(endpoint, json.length(), payload.length(), upload_ns, answered);
+	if(sent != NULL) *sent += payload.length();
+	return answered;
+}
+
+
+/*!
+ \brief whereis .git
+ \param path		the path to start from
+ 
+ Traverse directories looking for the git repo.  Since we're starting in the
+ hooks dir (more than likely), it won't be '.'.
+ */
+char *find_git_repo_from_path(const char *path)
+{
+	char *real_git_path = static_cast<char *>(malloc(PATH_LEN));
+	int result = git_repository_discover(real_git_path, PATH_LEN,
+					     path, false, NULL);
+	
+	if(result != 0)
+	{
+		free(real_git_path);
+		real_git_path = NULL;
+	}
+	
+	return real_git_path;
+}
@@ -0,0 +1,49 @@
+//
+//  git_hook.h
+//  RCMP for Real Git
+//
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#ifndef __rcmp_git_hook_h_
+#define __rcmp_git_hook_h_
+
+#include "json/libjson.h"
+
+class WTConnection;
+
+
+/*!
+ \brief build the payload for one ref
+ \param path		the path to the git repo
+ \param old_id		the old commit ID
+ \param new_id		the new commit ID
+ \param ref_name	the name of the ref we're parsing (ref/name/master etc)
+ \returns the payload, which the caller deletes, or NULL if the repo can't be
+          opened
+ */
+JSONNode *git_hook_main(const char *path, const char *old_id, const char *new_id,
+			const char *ref_name);
+
+
+/*!
+ \brief send a payload to one URL
+ \param conn		the connection to the URL
+ \param node		the payload
+ \param endpoint	which URL it is, counting from the first one
+ \param url		the URL
+ \param sent		if not NULL, the bytes sent are added to it
+ \returns whether anything came back
+ */
+bool git_hook_send(WTConnection *conn, JSONNode *node, int endpoint, const char *url,
+		   size_t *sent = NULL);
+
+
+/*!
+ \brief whereis .git
+ \param path		the path to start from
+ \returns the path, which the caller frees, or NULL if there isn't one
+ */
+char *find_git_repo_from_path(const char *path);
+
+#endif
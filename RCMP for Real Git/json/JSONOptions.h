@@ -58,10 +58,11 @@
 
 /*
  *  JSON_PREPARSE causes all parsing to be done immediately.  By default, libjson
- *  parses nodes on the fly as they are needed, this makes parsing much faster if
- *  your program gets a lot of information that it doesn't need.  An example of
- *  this would be a client application communicating with a server if the server
- *  returns things like last modified date and other things that you don't use.
+ *  reads the structure in one pass but leaves strings with escapes in them as they
+ *  were written until they are used, this makes parsing faster if your program
+ *  gets a lot of information that it doesn't need.  An example of this would be a
+ *  client application communicating with a server if the server returns things
+ *  like commit messages and other things that you don't use.
  */
 //#define JSON_PREPARSE
 
@@ -135,7 +136,38 @@
  *  pool.  With this option turned on, the default behavior is still done internally unless
  *  a callback is registered.  So you can have this option on and mot use it.
  */
-//#define JSON_MEMORY_CALLBACKS
+#define JSON_MEMORY_CALLBACKS
+
+
+/*
+ *  JSON_MEMORY_ARENA adds JSONArena, a region that can be made the current arena of a thread.
+ *  While it is current everything libjson allocates through the memory callbacks is carved out
+ *  of it by bumping a pointer, and freeing it does nothing.  The memory all comes back at once
+ *  when the arena is released, so it suits trees that are built, written and thrown away
+ *  together.  This option requires JSON_MEMORY_CALLBACKS
+ */
+#define JSON_MEMORY_ARENA
+
+
+/*
+ *  JSON_MEMORY_POOL keeps free lists of fixed size blocks for the nodes and small children
+ *  arrays, one set per thread, so making and deleting them hardly ever goes to the heap.
+ *  Threads only share what exited threads gave back and what a thread freed past two slabs'
+ *  worth, so it is safe for building trees on many threads at once, and one thread can free
+ *  what another made.  JSONPool::hits and JSONPool::misses count how often this thread's lists
+ *  had a block ready.  This option requires C++11
+ */
+//#define JSON_MEMORY_POOL
+
+
+/*
+ *  JSON_STATS counts the nodes and children that are alive on each thread, the most there have
+ *  been at once, and the bytes asked for through the memory functions.  JSONStats::thread reads
+ *  this thread's counts and JSONStats::total adds up all of them.  Only the owning thread writes
+ *  a count, so keeping them costs about as much as a plain increment.  This option requires
+ *  thread local storage
+ */
+#define JSON_STATS
 
 
 /*
@@ -261,6 +293,41 @@
 //#define JSON_CASE_INSENSITIVE_FUNCTIONS
 
 
+/*
+ *  JSON_CHILDREN_INLINE gives every node and array room for that many children inside of
+ *  itself, so small ones don't need the children array allocated separately.  Bigger ones
+ *  move out to the heap as they would without it.  It must be defined as an integer
+ */
+#define JSON_CHILDREN_INLINE 2
+
+
+/*
+ *  JSON_CHILDREN_INDEX makes looking up a child by name use a hash table once a node has at
+ *  least that many children, instead of comparing every name.  The table is built on the
+ *  first lookup and kept until the children are rearranged.  Renames are noticed when a name
+ *  isn't found, so if two children end up with the same name, either may be found until then.
+ *  It must be defined as an integer
+ */
+//#define JSON_CHILDREN_INDEX 16
+
+
+/*
+ *  JSON_MAX_DEPTH is how many objects and arrays can be inside of each other in something
+ *  that's parsed.  Reading goes down a level of the stack for each one, so anything nested
+ *  deeper fails to parse rather than running out of stack.  It must be defined as an integer
+ */
+#define JSON_MAX_DEPTH 1024
+
+
+/*
+ *  JSON_INTERNED_KEYS adds json_key and JSONKeys::intern, which keep one copy of a name for
+ *  the whole program.  Nodes can be named with a key instead of a string, then they point
+ *  at it rather than owning a copy, and looking a child up by a key compares pointers.
+ *  Keys are never freed, so don't intern names that come from outside
+ */
+#define JSON_INTERNED_KEYS
+
+
 /*
  *  JSON_INDEX_TYPE allows you th change the size type for the children functions. If this
  *  option is not used then unsigned int is used.  This option is useful for cutting down
@@ -24,20 +24,22 @@ void jsonChildren::inc(void) json_nothrow {
     if (json_unlikely(mysize == mycapacity)){  //it's full
 	   if (json_unlikely(mycapacity == 0)){  //the array hasn't been created yet
 		  JSON_ASSERT(!array, JSON_TEXT("Expanding a 0 capacity array, but not null"));
-		  #ifdef JSON_LESS_MEMORY
-			 array = json_malloc<JSONNode*>(1);
+		  #ifdef JSON_CHILDREN_INLINE
+			 array = inlined;
+			 mycapacity = JSON_CHILDREN_INLINE;
+		  #elif defined(JSON_LESS_MEMORY)
+			 array = json_pool_malloc<JSONNode*>(1);
 			 mycapacity = 1;
 		  #else
-			 array = json_malloc<JSONNode*>(8);  //8 seems average for JSON, and it's only 64 bytes
+			 array = json_pool_malloc<JSONNode*>(8);  //8 seems average for JSON, and it's only 64 bytes
 			 mycapacity = 8;
 		  #endif
 	   } else {
 		  #ifdef JSON_LESS_MEMORY
-			 mycapacity += 1;  //increment the size of the array
+			 resize(mycapacity + 1);  //increment the size of the array
 		  #else
-			 mycapacity <<= 1;  //double the size of the array
+			 resize(mycapacity << 1);  //double the size of the array
 		  #endif
-		  array = json_realloc<JSONNode*>(array, mycapacity);
 	   }
     }
 }
@@ -49,26 +51,56 @@ void jsonChildren::inc(json_index_t amount) json_nothrow {
     if (json_likely(mysize + amount >= mycapacity)){  //it's full
 	   if (json_unlikely(mycapacity == 0)){  //the array hasn't been created yet
 		  JSON_ASSERT(!array, JSON_TEXT("Expanding a 0 capacity array, but not null"));
+		  #ifdef JSON_CHILDREN_INLINE
+			 if (amount <= JSON_CHILDREN_INLINE){
+				array = inlined;
+				mycapacity = JSON_CHILDREN_INLINE;
+				return;
+			 }
+		  #endif
 		  #ifdef JSON_LESS_MEMORY
-			 array = json_malloc<JSONNode*>(amount);
+			 array = json_pool_malloc<JSONNode*>(amount);
 			 mycapacity = amount;
 		  #else
-			 array = json_malloc<JSONNode*>(amount > 8 ? amount : 8);  //8 seems average for JSON, and it's only 64 bytes
+			 array = json_pool_malloc<JSONNode*>(amount > 8 ? amount : 8);  //8 seems average for JSON, and it's only 64 bytes
 			 mycapacity = amount > 8 ? amount : 8;
 		  #endif
 	   } else {
 		  #ifdef JSON_LESS_MEMORY
-			 mycapacity = mysize + amount;  //increment the size of the array
+			 resize(mysize + amount);  //increment the size of the array
 		  #else
-			 while(mysize + amount > mycapacity){
-				mycapacity <<= 1;  //double the size of the array
+			 json_index_t newcapacity = mycapacity;
+			 while(mysize + amount > newcapacity){
+				newcapacity <<= 1;  //double the size of the array
 			 }
+			 resize(newcapacity);
 		  #endif
-		  array = json_realloc<JSONNode*>(array, mycapacity);
 	   }
     }
 }
 
+void jsonChildren::resize(json_index_t amount) json_nothrow {
+    #ifdef JSON_CHILDREN_INLINE
+	   if (array == inlined){
+		  if (amount <= JSON_CHILDREN_INLINE) return;  //it still fits
+		  JSONNode ** res = json_pool_malloc<JSONNode*>(amount);
+		  memcpy(res, inlined, mysize * sizeof(JSONNode *));
+		  array = res;
+		  mycapacity = amount;
+		  return;
+	   } else if (amount <= JSON_CHILDREN_INLINE){  //small enough to go back
+		  JSON_ASSERT(mysize <= amount, JSON_TEXT("resizing below the size"));
+		  memcpy(inlined, array, mysize * sizeof(JSONNode *));
+		  json_pool_free<JSONNode*>(array, mycapacity);
+		  array = inlined;
+		  mycapacity = JSON_CHILDREN_INLINE;
+		  return;
+	   }
+    #endif
+    array = json_pool_realloc<JSONNode*>(array, mycapacity, amount);
+    mycapacity = amount;
+}
+
 //actually deletes everything within the vector, this is safe to do on an empty or even a null array
 void jsonChildren::deleteAll(void) json_nothrow {
     JSON_ASSERT(this != 0, JSON_TEXT("Children is null deleteAll"));
@@ -83,6 +115,7 @@ void jsonChildren::doerase(JSONNode ** position, json_index_t number) json_nothr
     JSON_ASSERT(array != 0, JSON_TEXT("erasing something from a null array 2"));
     JSON_ASSERT(position >= array, JSON_TEXT("position is beneath the start of the array 2"));
     JSON_ASSERT(position + number <= array + mysize, JSON_TEXT("erasing out of bounds 2"));
+    dropIndex();
     if (position + number >= array + mysize){
 	   mysize = (json_index_t)(position - array);
 	   #ifndef JSON_ISO_STRICT__
@@ -93,3 +126,93 @@ void jsonChildren::doerase(JSONNode ** position, json_index_t number) json_nothr
 	   mysize -= number;
     }
 }
+
+#ifdef JSON_CHILDREN_INDEX
+    #if defined(__cplusplus) && (__cplusplus >= 201103L)
+	   #include <atomic>
+	   //only ever compared for being different, so relaxed is plenty and it needn't be a locked add
+	   static std::atomic<size_t> name_epoch(0);
+	   #define JSON_EPOCH_LOAD() name_epoch.load(std::memory_order_relaxed)
+	   #define JSON_EPOCH_BUMP() name_epoch.store(name_epoch.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed)
+    #else
+	   static size_t name_epoch = 0;
+	   #define JSON_EPOCH_LOAD() name_epoch
+	   #define JSON_EPOCH_BUMP() ++name_epoch
+    #endif
+
+    //FNV-1a
+    static inline size_t hashName(const json_string & name_t) json_nothrow {
+	   size_t res = 2166136261u;
+	   for(json_string::const_iterator runner = name_t.begin(), end = name_t.end(); runner != end; ++runner){
+		  res = (res ^ (size_t)*runner) * 16777619u;
+	   }
+	   return res;
+    }
+
+    //compared in place, name() would make a copy
+    #define NAME_OF(node) ((node) -> internal -> nameref())
+
+    void jsonChildren::renamed(void) json_nothrow {
+	   JSON_EPOCH_BUMP();
+    }
+
+    void jsonChildren::freeIndex(void) json_nothrow {
+	   libjson_free<nameIndex>(myindex);
+	   myindex = 0;
+    }
+
+    void jsonChildren::buildIndex(void) json_nothrow {
+	   dropIndex();
+	   json_index_t slots = 4;
+	   while(slots < mysize * 2) slots <<= 1;  //never more than half full
+	   myindex = (nameIndex *)json_malloc<char>(sizeof(nameIndex) + (slots - 1) * sizeof(json_index_t));
+	   JSON_ASSERT_SAFE(myindex != 0, JSON_TEXT("out of memory"), return;);
+	   myindex -> epoch = JSON_EPOCH_LOAD();
+	   myindex -> mask = slots - 1;
+	   memset(myindex -> slots, 0, slots * sizeof(json_index_t));
+	   //in order, so that the first of any duplicate names is the first one probed
+	   for(json_index_t i = 0; i < mysize; ++i){
+		  json_index_t slot = (json_index_t)hashName(NAME_OF(array[i])) & myindex -> mask;
+		  while(myindex -> slots[slot] != 0) slot = (slot + 1) & myindex -> mask;
+		  myindex -> slots[slot] = i + 1;
+	   }
+    }
+
+    void jsonChildren::appendIndex(void) json_nothrow {
+	   JSON_ASSERT(myindex != 0, JSON_TEXT("appending to a missing index"));
+	   if (json_unlikely(mysize * 2 > myindex -> mask + 1)){  //too full, make a bigger one when it's next needed
+		  freeIndex();
+		  return;
+	   }
+	   json_index_t slot = (json_index_t)hashName(NAME_OF(array[mysize - 1])) & myindex -> mask;
+	   while(myindex -> slots[slot] != 0) slot = (slot + 1) & myindex -> mask;
+	   myindex -> slots[slot] = mysize;
+    }
+
+    JSONNode ** jsonChildren::find(const json_string & name_t) json_nothrow {
+	   if (mysize < JSON_CHILDREN_INDEX){  //not worth hashing
+		  json_foreach(this, runner){
+			 JSON_ASSERT(*runner != NULL, JSON_TEXT("a null pointer within the children"));
+			 if (json_unlikely(NAME_OF(*runner) == name_t)) return runner;
+		  }
+		  return 0;
+	   }
+	   if (json_unlikely(myindex == 0)){
+		  buildIndex();
+		  if (json_unlikely(myindex == 0)) return 0;
+	   }
+	   //a rename anywhere bumps the epoch, so rather than rebuilding for it a hit is trusted as
+	   //long as the child still has that name, and only a miss after a rename rebuilds.  With
+	   //duplicate names, one renamed to name_t since is only seen after such a miss
+	   for(;;){
+		  json_index_t slot = (json_index_t)hashName(name_t) & myindex -> mask;
+		  while(json_index_t pos = myindex -> slots[slot]){
+			 if (NAME_OF(array[pos - 1]) == name_t) return array + pos - 1;
+			 slot = (slot + 1) & myindex -> mask;
+		  }
+		  if (json_likely(myindex -> epoch == JSON_EPOCH_LOAD())) return 0;
+		  buildIndex();
+		  if (json_unlikely(myindex == 0)) return 0;
+	   }
+    }
+#endif
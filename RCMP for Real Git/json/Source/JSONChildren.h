@@ -34,20 +34,31 @@ class JSONNode;  //forward declaration
     #define childrenVirtual
 #endif
 
+#ifdef JSON_CHILDREN_INDEX
+    #define JSON_CHILDREN_INDEX_INIT , myindex(0)
+#else
+    #define JSON_CHILDREN_INDEX_INIT
+#endif
+
 #ifndef JSON_UNIT_TEST
-    #define addAllocCount() (void)0
-    #define subAllocCount() (void)0
+    #ifdef JSON_STATS
+	   #define addAllocCount() JSONStats::made(JSONStats::STAT_CHILDREN)
+	   #define subAllocCount() JSONStats::gone(JSONStats::STAT_CHILDREN)
+    #else
+	   #define addAllocCount() (void)0
+	   #define subAllocCount() (void)0
+    #endif
 #endif
 
 class jsonChildren {
 public:
     //starts completely empty and the array is not allocated
-    jsonChildren(void) json_nothrow : array(0), mysize(0), mycapacity(0) {
+    jsonChildren(void) json_nothrow : array(0), mysize(0), mycapacity(0) JSON_CHILDREN_INDEX_INIT {
 	   addAllocCount();
     }
 
     #ifdef JSON_LESS_MEMORY
-	   jsonChildren(JSONNode** ar, json_index_t si, json_index_t ca) json_nothrow : array(ar), mysize(si), mycapacity(ca) {
+	   jsonChildren(JSONNode** ar, json_index_t si, json_index_t ca) json_nothrow : array(ar), mysize(si), mycapacity(ca) JSON_CHILDREN_INDEX_INIT {
 		  addAllocCount();
 	   }
     #endif
@@ -56,8 +67,9 @@ public:
     childrenVirtual ~jsonChildren(void) json_nothrow {
 	   if (json_unlikely(array != 0)){  //the following function calls are safe, but take more time than a check here
 		  deleteAll();
-		  libjson_free<JSONNode*>(array);
+		  freeArray();
 	   }
+	   dropIndex();
 	   subAllocCount();
     }
 
@@ -75,14 +87,29 @@ public:
 	   JSON_ASSERT(this != 0, JSON_TEXT("Children is null push_back"));
 	   inc();
 	   array[mysize++] = item;
+	   #ifdef JSON_CHILDREN_INDEX
+		  if (json_unlikely(myindex != 0)) appendIndex();
+	   #endif
     }
 
+    #ifndef JSON_LIBRARY
+	   //Takes over item's contents, implemented in JSONNode.h because it needs the whole JSONNode
+	   #ifdef JSON_RVALUE_REFS
+		  void push_back(JSONNode && item) json_nothrow;
+	   #endif
+
+	   //Constructs a new child directly from its name (or key) and value, also in JSONNode.h
+	   template <typename N, typename T>
+	   void emplace_back(const N & name_t, const T & value_t) json_nothrow;
+    #endif
+
     //Adds something to the front of the vector, doubling the array if necessary
     void push_front(JSONNode * item) json_nothrow {
 	   JSON_ASSERT(this != 0, JSON_TEXT("Children is null push_front"));
 	   inc();
 	   memmove(array + 1, array, mysize++ * sizeof(JSONNode *));
 	   array[0] = item;
+	   dropIndex();
     }
 
     //gets an item out of the vector by it's position
@@ -120,6 +147,7 @@ public:
 		  deleteAll();
 		  mysize = 0;
 	   }
+	   dropIndex();
 	   JSON_ASSERT(mysize == 0, JSON_TEXT("mysize is not zero after clear"));
     }
 
@@ -179,6 +207,7 @@ public:
 	   JSON_ASSERT(position >= array, JSON_TEXT("position is beneath the start of the array 1"));
 	   JSON_ASSERT(position <= array + mysize, JSON_TEXT("erasing out of bounds 1"));
 	   memmove(position, position + 1, (mysize-- - (position - array) - 1) * sizeof(JSONNode *));
+	   dropIndex();
 	   iteratorKeeper ik(this, position);
 	   shrink();
     }
@@ -219,6 +248,7 @@ public:
 	   }
 	   memmove(position + 1, position, (mysize++ - (position - array)) * sizeof(JSONNode *));
 	   *position = item;
+	   dropIndex();
     }
 
     void insert(JSONNode ** & position, JSONNode ** items, json_index_t num) json_nothrow {
@@ -233,6 +263,7 @@ public:
 	   memmove(position + num, position, ptrs * sizeof(JSONNode *));
 	   memcpy(position, items, num * sizeof(JSONNode *));
 	   mysize += num;
+	   dropIndex();
     }
 
     inline void reserve(json_index_t amount) json_nothrow {
@@ -240,7 +271,14 @@ public:
 	   JSON_ASSERT(array == 0, JSON_TEXT("reserve is not meant to expand a preexisting array"));
 	   JSON_ASSERT(mycapacity == 0, JSON_TEXT("reservec is not meant to expand a preexisting array"));
 	   JSON_ASSERT(mysize == 0, JSON_TEXT("reserves is not meant to expand a preexisting array"));
-	   array = json_malloc<JSONNode*>(mycapacity = amount);
+	   #ifdef JSON_CHILDREN_INLINE
+		  if (amount <= JSON_CHILDREN_INLINE){
+			 array = inlined;
+			 mycapacity = JSON_CHILDREN_INLINE;
+			 return;
+		  }
+	   #endif
+	   array = json_pool_malloc<JSONNode*>(mycapacity = amount);
     }
 
     static void reserve2(jsonChildren *& mine, json_index_t amount) json_nothrow;
@@ -249,15 +287,15 @@ public:
     inline childrenVirtual void shrink() json_nothrow {
 	   JSON_ASSERT(this != 0, JSON_TEXT("Children is null shrink"));
 	   if (json_unlikely(mysize == 0)){  //size is zero, we should completely free the array
-		  libjson_free<JSONNode*>(array);  //free does checks for a null pointer, so don't bother checking
+		  freeArray();  //free does checks for a null pointer, so don't bother checking
 		  array = 0;
+		  mycapacity = 0;
 	   #ifdef JSON_LESS_MEMORY
 		  } else {  //need to shrink it, using realloc
 			 JSON_ASSERT(array != 0, JSON_TEXT("shrinking a null array that is not size 0"));
-			 array = json_realloc<JSONNode*>(array, mysize);
+			 resize(mysize);
 	   #endif
 	   }
-	   mycapacity = mysize;
     }
 
 
@@ -282,6 +320,24 @@ public:
 
     json_index_t mysize;	     //the number of valid items
     json_index_t mycapacity;   //the number of possible items
+    #ifdef JSON_CHILDREN_INLINE
+	   JSONNode * inlined[JSON_CHILDREN_INLINE];  //array points here until it needs more room
+    #endif
+
+    #ifdef JSON_CHILDREN_INDEX
+	   //finds the first child named name_t, through the index once there are enough of them
+	   JSONNode ** find(const json_string & name_t) json_nothrow json_hot;
+
+	   //call whenever a node that might be someone's child changes its name
+	   static void renamed(void) json_nothrow;
+    #endif
+
+    //the index has to be forgotten whenever children move around
+    inline void dropIndex(void) json_nothrow {
+	   #ifdef JSON_CHILDREN_INDEX
+		  if (json_unlikely(myindex != 0)) freeIndex();
+	   #endif
+    }
 JSON_PROTECTED
     //to make sure it's not copyable
     jsonChildren(const jsonChildren &);
@@ -289,17 +345,58 @@ JSON_PROTECTED
 
     void deleteAll(void) json_nothrow json_hot;  //implemented in JSONNode.cpp
     void doerase(JSONNode ** position, json_index_t number) json_nothrow;
+
+    //moves the array to one that holds amount, going from or to the inline one as needed
+    void resize(json_index_t amount) json_nothrow;
+
+    //frees the array unless it's the inline one
+    inline void freeArray(void) json_nothrow {
+	   #ifdef JSON_CHILDREN_INLINE
+		  if (array == inlined) return;
+	   #endif
+	   json_pool_free<JSONNode*>(array, mycapacity);
+    }
+
+    #ifdef JSON_CHILDREN_INDEX
+	   //open addressing table of positions + 1, 0 is an empty slot
+	   struct nameIndex {
+		  size_t epoch;  //what renamed's counter was when this was built
+		  json_index_t mask;  //number of slots - 1
+		  json_index_t slots[1];
+	   };
+	   void buildIndex(void) json_nothrow;
+	   void appendIndex(void) json_nothrow;
+	   void freeIndex(void) json_nothrow;
+
+	   nameIndex * myindex;
+    #endif
+
+    #ifdef JSON_CHILDREN_INLINE
+	   //takes orig's array, copying it if it lives inside of orig
+	   inline void adopt(const jsonChildren & orig) json_nothrow {
+		  if (orig.array == orig.inlined){
+			 memcpy(inlined, orig.inlined, sizeof(inlined));
+			 array = inlined;
+		  }
+	   }
+    #endif
 };
 
 #ifdef JSON_LESS_MEMORY
     class jsonChildren_Reserved : public jsonChildren {
     public:
 	   jsonChildren_Reserved(jsonChildren * orig, json_index_t siz) json_nothrow : jsonChildren(orig -> array, orig -> mysize, orig -> mycapacity), myreserved(siz) {
+		  #ifdef JSON_CHILDREN_INLINE
+			 adopt(*orig);
+		  #endif
 		  orig -> array = 0;
 		  deleteChildren(orig);
 		  addAllocCount();
 	   }
 	   jsonChildren_Reserved(const jsonChildren_Reserved & orig) json_nothrow  : jsonChildren(orig.array, orig.mysize, orig.mycapacity), myreserved(orig.myreserved){
+		  #ifdef JSON_CHILDREN_INLINE
+			 adopt(orig);
+		  #endif
 		  addAllocCount();
 	   }
 	   inline virtual ~jsonChildren_Reserved() json_nothrow {
@@ -308,11 +405,12 @@ JSON_PROTECTED
 	   inline virtual void shrink() json_nothrow {
 		  JSON_ASSERT(this != 0, JSON_TEXT("Children is null shrink reserved"));
 		  if (json_unlikely(mysize == 0)){  //size is zero, we should completely free the array
-			 libjson_free<JSONNode*>(array);  //free does checks for a null pointer, so don't bother checking
+			 freeArray();  //free does checks for a null pointer, so don't bother checking
 			 array = 0;
+			 mycapacity = 0;
 		  } else if (mysize > myreserved){
 			 JSON_ASSERT(array != 0, JSON_TEXT("shrinking a null array that is not size 0"));
-			 array = json_realloc<JSONNode*>(array, mysize);
+			 resize(mysize);
 		  }
 	   }
 
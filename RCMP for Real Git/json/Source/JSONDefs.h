@@ -41,6 +41,24 @@
     #define json_catch(exception, code) catch(exception){ code }
 #endif
 
+#ifndef json_thread_local
+    #if defined(__cplusplus) && (__cplusplus >= 201103L)
+	   #define json_thread_local thread_local
+    #endif
+#endif
+
+#ifdef __cplusplus
+    #if (__cplusplus >= 201103L) || defined(__GXX_EXPERIMENTAL_CXX0X__) || (defined(_MSC_VER) && (_MSC_VER >= 1600))
+	   #define JSON_RVALUE_REFS
+    #endif
+    #ifdef JSON_RVALUE_REFS
+	   #include <utility>
+	   #define json_move(x) std::move(x)
+    #else
+	   #define json_move(x) x
+    #endif
+#endif
+
 #ifdef JSON_STRICT
     #ifndef JSON_UNICODE
 	   #error, JSON_UNICODE is required for JSON_STRICT
@@ -163,5 +181,33 @@ typedef void (*json_free_t)(void *);
 	   #error, JSON_VALIDATE also requires JSON_READ_PRIORITY
     #endif
 #endif
+#ifdef JSON_MEMORY_ARENA
+    #ifndef JSON_MEMORY_CALLBACKS
+	   #error, JSON_MEMORY_ARENA also requires JSON_MEMORY_CALLBACKS
+    #endif
+    #ifndef json_thread_local
+	   #error, JSON_MEMORY_ARENA needs thread local storage
+    #endif
+#endif
+#ifdef JSON_STATS
+    #ifndef json_thread_local
+	   #error, JSON_STATS needs thread local storage
+    #endif
+#endif
+#ifdef JSON_CHILDREN_INLINE
+    #if JSON_CHILDREN_INLINE < 1
+	   #error, JSON_CHILDREN_INLINE must be at least 1
+    #endif
+#endif
+#ifdef JSON_CHILDREN_INDEX
+    #if JSON_CHILDREN_INDEX < 1
+	   #error, JSON_CHILDREN_INDEX must be at least 1
+    #endif
+#endif
+#ifndef JSON_MAX_DEPTH
+    #define JSON_MAX_DEPTH 1024  //parsing can't go without a limit
+#elif JSON_MAX_DEPTH < 1
+    #error, JSON_MAX_DEPTH must be at least 1
+#endif
 
 #endif
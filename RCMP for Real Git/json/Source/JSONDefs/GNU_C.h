@@ -56,6 +56,7 @@
 
     #define json_nothrow throw()
     #define json_throws(x) throw(x)
+    #define json_thread_local __thread
 
     #ifdef JSON_LESS_MEMORY
 	   #define PACKED(x) :x __attribute__ ((packed))
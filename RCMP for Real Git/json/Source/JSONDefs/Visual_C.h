@@ -15,6 +15,7 @@
     #define json_cold
     #define json_likely(x) x
     #define json_unlikely(x) x
+    #define json_thread_local __declspec(thread)
 
     #ifdef JSON_LESS_MEMORY
 	   #define PACKED(x) :x
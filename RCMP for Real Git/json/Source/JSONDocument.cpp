@@ -0,0 +1,260 @@
+#include "JSONDocument.h"
+
+#ifdef JSON_READ_PRIORITY
+#include "JSONWorker.h"
+#include "NumberToString.h"
+#include <cstring>
+
+JSONDocument::JSONDocument(const json_string & json) json_throws(std::invalid_argument) : text(json), tape(0), count(0), capacity(0) {
+    if (json_likely(JSONWorker::ReadTape(*this))){
+	   tape = json_realloc<uint64_t>(tape, capacity = count);  //it's never added to again
+	   return;
+    }
+    count = 0;
+    JSON_FAIL(JSON_TEXT("Not JSON!"));
+    json_throw(std::invalid_argument(EMPTY_STD_STRING));
+}
+
+JSONDocument::~JSONDocument(void) json_nothrow {
+    libjson_free<uint64_t>(tape);
+}
+
+void JSONDocument::push(uint64_t word) json_nothrow {
+    if (json_unlikely(count == capacity)){
+	   capacity = capacity ? capacity * 2 : (text.length() / 8 + 16);  //about one value in every sixteen characters
+	   tape = json_realloc<uint64_t>(tape, capacity);
+    }
+    tape[count++] = word;
+}
+
+json_string JSONDocument::unescape(size_t at) const json_nothrow {
+    const json_char * start = text.data() + JSON_TAPE_AT(tape[at]);
+    const size_t length = (size_t)tape[at + 1];
+    if (json_likely(!(tape[at] & JSON_TAPE_ESCAPED))) return json_string(start, length);
+    json_string res;
+    res.reserve(length);
+    for(const json_char * p = start, * end = start + length; p < end; ++p){
+	   if (*p == JSON_TEXT('\\')){
+		  JSONWorker::SpecialChar(++p, res);
+	   } else {
+		  res += *p;
+	   }
+    }
+    return res;
+}
+
+bool JSONDocument::sameString(size_t at, const json_string & value) const json_nothrow {
+    if (json_unlikely(tape[at] & JSON_TAPE_ESCAPED)) return unescape(at) == value;
+    const size_t length = (size_t)tape[at + 1];
+    return (length == value.length()) && (std::memcmp(text.data() + JSON_TAPE_AT(tape[at]), value.data(), length * sizeof(json_char)) == 0);
+}
+
+unsigned char JSONDocument::node::type(void) const json_nothrow {
+    if (json_unlikely(doc == 0)) return JSON_NULL;
+    switch(JSON_TAPE_TAG(word())){
+	   case JSON_TEXT('{'):
+		  return JSON_NODE;
+	   case JSON_TEXT('['):
+		  return JSON_ARRAY;
+	   case JSON_TEXT('\"'):
+		  return JSON_STRING;
+	   case JSON_TEXT('0'):
+		  return JSON_NUMBER;
+	   case JSON_TEXT('t'):
+	   case JSON_TEXT('f'):
+		  return JSON_BOOL;
+    }
+    return JSON_NULL;
+}
+
+json_index_t JSONDocument::node::size(void) const json_nothrow {
+    const unsigned char mytype = type();
+    if ((mytype != JSON_NODE) && (mytype != JSON_ARRAY)) return 0;
+    const size_t children = (size_t)JSON_TAPE_CHILDREN(word());
+    if (json_likely(children != JSON_TAPE_MANY)) return (json_index_t)children;
+    json_index_t res = 0;
+    for(node runner = child(0); runner.index != JSON_TAPE_AT(word()) - 1; runner = runner.next()){
+	   ++res;
+    }
+    return res;
+}
+
+json_string JSONDocument::node::name(void) const json_nothrow {
+    if (key == 0) return json_string();
+    return doc -> unescape(key);
+}
+
+json_string JSONDocument::node::as_string(void) const json_nothrow {
+    switch(type()){
+	   case JSON_STRING:
+		  return doc -> unescape(index);
+	   case JSON_NUMBER: {  //written back the way it was read
+		  const json_char * start = doc -> text.data() + JSON_TAPE_AT(word());
+		  const json_char * end = start;
+		  json_number ignored;
+		  NumberToString::_parse(end, ignored);
+		  return json_string(start, (size_t)(end - start));
+	   }
+	   case JSON_BOOL:
+		  return (JSON_TAPE_TAG(word()) == JSON_TEXT('t')) ? json_string(JSON_TEXT("true")) : json_string(JSON_TEXT("false"));
+	   case JSON_NULL:
+		  return json_string(JSON_TEXT("null"));
+    }
+    return json_string();
+}
+
+json_number JSONDocument::node::as_float(void) const json_nothrow {
+    switch(type()){
+	   case JSON_NUMBER: {
+		  json_number res;
+		  const uint64_t bits = word(1);
+		  std::memcpy(&res, &bits, sizeof(res));
+		  return res;
+	   }
+	   case JSON_BOOL:
+		  return (JSON_TAPE_TAG(word()) == JSON_TEXT('t')) ? (json_number)1.0 : (json_number)0.0;
+	   case JSON_STRING: {
+		  const json_string value(as_string());
+		  const json_char * runner = value.c_str();
+		  json_number res;
+		  if (json_unlikely(!NumberToString::_parse(runner, res))) res = (json_number)0.0;
+		  return res;
+	   }
+    }
+    JSON_ASSERT(type() == JSON_NULL, JSON_TEXT("as_float returning undefined results"));
+    return (json_number)0.0;
+}
+
+json_int_t JSONDocument::node::as_int(void) const json_nothrow {
+    return (json_int_t)as_float();
+}
+
+bool JSONDocument::node::as_bool(void) const json_nothrow {
+    switch(type()){
+	   case JSON_BOOL:
+		  return JSON_TAPE_TAG(word()) == JSON_TEXT('t');
+	   case JSON_NUMBER:
+		  return as_float() != (json_number)0.0;
+    }
+    JSON_ASSERT(type() == JSON_NULL, JSON_TEXT("(bool) returning undefined results"));
+    return false;
+}
+
+JSONNode JSONDocument::node::duplicate(void) const json_nothrow {
+    JSONNode res(JSON_NULL);
+    switch(type()){
+	   case JSON_NODE:
+	   case JSON_ARRAY: {
+		  res.cast(type());
+		  res.reserve(size());
+		  for(node runner = child(0); runner.index != JSON_TAPE_AT(word()) - 1; runner = runner.next()){
+			 res.push_back(runner.duplicate());
+		  }
+		  break;
+	   }
+	   case JSON_STRING:
+		  res = as_string();
+		  break;
+	   case JSON_NUMBER:
+		  res = as_float();
+		  break;
+	   case JSON_BOOL:
+		  res = as_bool();
+		  break;
+	   default:
+		  res.nullify();  //so that it reads back as null, the same as a parsed one
+		  break;
+    }
+    if (key) res.set_name(name());
+    return res;
+}
+
+//the child'th one, or where the container ends if there aren't that many
+JSONDocument::node JSONDocument::node::child(size_t at) const json_nothrow {
+    node runner;
+    if (JSON_TAPE_TAG(word()) == JSON_TEXT('{')){
+	   runner = (JSON_TAPE_TAG(word(1)) == JSON_TEXT('}')) ? node(doc, index + 1, 0) : node(doc, index + 3, index + 1);
+    } else {
+	   runner = node(doc, index + 1, 0);
+    }
+    const uint32_t last = (uint32_t)JSON_TAPE_AT(word()) - 1;
+    for(; at && (runner.index != last); --at){
+	   runner = runner.next();
+    }
+    return runner;
+}
+
+//the sibling after this one, which is the closing bracket after the last of them
+JSONDocument::node JSONDocument::node::next(void) const json_nothrow {
+    size_t after;
+    switch(JSON_TAPE_TAG(word())){
+	   case JSON_TEXT('{'):
+	   case JSON_TEXT('['):
+		  after = (size_t)JSON_TAPE_AT(word());
+		  break;
+	   case JSON_TEXT('\"'):
+	   case JSON_TEXT('0'):
+		  after = index + 2;
+		  break;
+	   default:
+		  after = index + 1;
+		  break;
+    }
+    if (key && (JSON_TAPE_TAG(doc -> tape[after]) != JSON_TEXT('}'))) return node(doc, after + 2, after);  //in an object, step over the name too
+    return node(doc, after, 0);
+}
+
+JSONDocument::node JSONDocument::node::find(const json_string & name_t) const json_nothrow {
+    if (type() != JSON_NODE) return node();
+    const uint32_t last = (uint32_t)JSON_TAPE_AT(word()) - 1;
+    for(node runner = child(0); runner.index != last; runner = runner.next()){
+	   if (doc -> sameString(runner.key, name_t)) return runner;
+    }
+    return node();
+}
+
+JSONDocument::node JSONDocument::node::operator[](json_index_t pos) const json_nothrow {
+    const unsigned char mytype = type();
+    if ((mytype != JSON_NODE) && (mytype != JSON_ARRAY)) return node();
+    const node res = child(pos);
+    if (res.index == JSON_TAPE_AT(word()) - 1) return node();
+    return res;
+}
+
+JSONDocument::node JSONDocument::node::at(json_index_t pos) const json_throws(std::out_of_range) {
+    const node res = operator[](pos);
+    if (json_unlikely(res.doc == 0)){
+	   JSON_FAIL(JSON_TEXT("at() out of bounds"));
+	   json_throw(std::out_of_range(EMPTY_STD_STRING));
+    }
+    return res;
+}
+
+JSONDocument::node JSONDocument::node::operator[](const json_string & name_t) const json_nothrow {
+    return find(name_t);
+}
+
+JSONDocument::node JSONDocument::node::at(const json_string & name_t) const json_throws(std::out_of_range) {
+    const node res = find(name_t);
+    if (json_unlikely(res.doc == 0)){
+	   JSON_FAIL(json_string(JSON_TEXT("at could not find child by name: ")) + name_t);
+	   json_throw(std::out_of_range(EMPTY_STD_STRING));
+    }
+    return res;
+}
+
+#ifdef JSON_ITERATORS
+    JSONDocument::node::const_iterator JSONDocument::node::begin(void) const json_nothrow {
+	   const unsigned char mytype = type();
+	   if ((mytype != JSON_NODE) && (mytype != JSON_ARRAY)) return const_iterator(*this);
+	   return const_iterator(child(0));
+    }
+
+    JSONDocument::node::const_iterator JSONDocument::node::end(void) const json_nothrow {
+	   const unsigned char mytype = type();
+	   if ((mytype != JSON_NODE) && (mytype != JSON_ARRAY)) return const_iterator(*this);
+	   return const_iterator(node(doc, JSON_TAPE_AT(word()) - 1, 0));
+    }
+#endif
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef JSON_DOCUMENT_H
+#define JSON_DOCUMENT_H
+
+#include "JSONNode.h"
+
+#ifdef JSON_READ_PRIORITY
+
+#include <stdint.h>
+
+#if defined(JSON_INTERNED_KEYS) && !defined(JSON_LIBRARY)
+    #include "JSONKeys.h"
+#endif
+
+/*
+    A read only way to look at a document without building JSONNodes for it.  The
+    whole parse is one flat array of 64 bit words, the tape, with what each value is
+    in the top byte and where it sits in the text in the rest.  Objects and arrays
+    hold where they end, so stepping to the next sibling never has to look inside
+    them.  Strings are left in the text and only unescaped when they're asked for,
+    so nothing is allocated per value and it takes a fraction of the memory of a
+    tree of nodes.  Comments are skipped, there's nowhere on the tape to keep them.
+
+    The text is copied in, and the tape words are:
+	   {  [	 one word with the number of children and where the tape is after the } or ]
+	   }  ]	 one word with where the { or [ is
+	   "	 two words, where the characters are and if they're escaped, then how many
+	   0	 two words, where the number is written, then its value
+	   t f n  one word with where it's written
+*/
+class JSONDocument {
+public:
+    //the document parses json, it's empty and its root is null if that wasn't JSON
+    explicit JSONDocument(const json_string & json) json_throws(std::invalid_argument);
+    ~JSONDocument(void) json_nothrow;
+
+    class node;
+    node root(void) const json_nothrow;
+    inline bool empty(void) const json_nothrow { return count == 0; }
+    //how big the tape is, in words
+    inline size_t size(void) const json_nothrow { return count; }
+
+    /*
+	   One value in the document, a position on its tape.  They are cheap to copy and
+	   are only good as long as the document is.  Looking for something that isn't
+	   there gives a null one, so lookups can be chained without checking each step
+    */
+    class node {
+    public:
+	   node(void) json_nothrow : doc(0), index(0), key(0) {}
+
+	   unsigned char type(void) const json_nothrow json_read_priority;
+	   json_index_t size(void) const json_nothrow json_read_priority;
+	   inline bool empty(void) const json_nothrow { return size() == 0; }
+	   json_string name(void) const json_nothrow json_read_priority;
+
+	   json_string as_string(void) const json_nothrow json_read_priority;
+	   json_int_t as_int(void) const json_nothrow json_read_priority;
+	   json_number as_float(void) const json_nothrow json_read_priority;
+	   bool as_bool(void) const json_nothrow json_read_priority;
+	   //a JSONNode tree of it, for code that needs to change it or keep it past the document
+	   JSONNode duplicate(void) const json_nothrow;
+
+	   node at(json_index_t pos) const json_throws(std::out_of_range);
+	   node operator[](json_index_t pos) const json_nothrow;
+	   node at(const json_string & name_t) const json_throws(std::out_of_range);
+	   node operator[](const json_string & name_t) const json_nothrow;
+	   #if defined(JSON_INTERNED_KEYS) && !defined(JSON_LIBRARY)
+		  inline node at(const json_key & key_t) const json_throws(std::out_of_range) { return at(key_t.str()); }
+		  inline node operator[](const json_key & key_t) const json_nothrow { return operator[](key_t.str()); }
+	   #endif
+
+	   #ifdef JSON_ITERATORS
+		  struct const_iterator;
+		  const_iterator begin(void) const json_nothrow;
+		  const_iterator end(void) const json_nothrow;
+	   #endif
+    JSON_PRIVATE
+	   node(const JSONDocument * doc_t, size_t index_t, size_t key_t) json_nothrow : doc(doc_t), index((uint32_t)index_t), key((uint32_t)key_t) {}
+	   inline uint64_t word(size_t offset = 0) const json_nothrow { return doc -> tape[index + offset]; }
+	   node child(size_t at) const json_nothrow;
+	   node next(void) const json_nothrow;
+	   node find(const json_string & name_t) const json_nothrow;
+	   const JSONDocument * doc;
+	   uint32_t index;
+	   uint32_t key;  //where its name is, 0 if it's not in an object since the root is always there
+	   friend class JSONDocument;
+    };
+JSON_PRIVATE
+    void push(uint64_t word) json_nothrow;
+    json_string unescape(size_t at) const json_nothrow;
+    bool sameString(size_t at, const json_string & value) const json_nothrow;
+    json_string text;
+    uint64_t * tape;
+    size_t count;
+    size_t capacity;
+    JSONDocument(const JSONDocument &);
+    JSONDocument & operator = (const JSONDocument &);
+    friend class JSONWorker;
+};
+
+#ifdef JSON_ITERATORS
+    //steps through the children of an object or an array, going to the next one is always one step
+    struct JSONDocument::node::const_iterator {
+	   inline const_iterator & operator ++(void) json_nothrow { current = current.next(); return *this; }
+	   inline node operator *(void) const json_nothrow { return current; }
+	   inline const node * operator ->(void) const json_nothrow { return &current; }
+	   inline bool operator ==(const const_iterator & other) const json_nothrow { return current.index == other.current.index; }
+	   inline bool operator !=(const const_iterator & other) const json_nothrow { return current.index != other.current.index; }
+    JSON_PRIVATE
+	   const_iterator(const node & start) json_nothrow : current(start) {}
+	   node current;
+	   friend class JSONDocument::node;
+    };
+#endif
+
+//the top byte of a word is what it is, the rest is where it points
+#define JSON_TAPE_TAG(word) (json_char)((word) >> 56)
+#define JSON_TAPE_WORD(tag, at) (((uint64_t)(tag) << 56) | (uint64_t)(at))
+#define JSON_TAPE_AT(word) ((word) & 0xFFFFFFFFULL)
+#define JSON_TAPE_ESCAPED ((uint64_t)1 << 55)
+#define JSON_TAPE_CHILD ((uint64_t)1 << 32)  //containers count their children above where they end
+#define JSON_TAPE_CHILDREN(word) (((word) >> 32) & 0xFFFFFF)
+#define JSON_TAPE_MANY 0xFFFFFF  //that many or more, they have to be counted
+
+inline JSONDocument::node JSONDocument::root(void) const json_nothrow {
+    return count ? node(this, 0, 0) : node();
+}
+
+#endif
+#endif
@@ -0,0 +1,307 @@
+#include "JSONIndexer.h"
+
+#if defined(JSON_READ_PRIORITY) || defined(JSON_STREAM)
+
+#include "JSONMemory.h"
+#include <cstring>
+#include <algorithm>
+
+//x86 vector versions are picked at run time, so the library still runs on anything it was built for
+#if !defined(JSON_UNICODE) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || JSON_GCC_VERSION >= 40900)
+    #define JSON_INDEXER_SIMD
+    #include <immintrin.h>
+#endif
+
+//what one block of 64 characters holds, a bit for each character
+struct json_block {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t structural;  //brackets, colons and commas
+    uint64_t control;
+    uint64_t comment;  //anything that starts one
+    uint64_t high;  //not ASCII, only these have to be checked as UTF-8
+};
+
+#ifdef JSON_INDEXER_SIMD
+    enum { SIMD_NONE, SIMD_SSE2, SIMD_AVX2 };
+
+    static int detectSimd(void) json_nothrow {
+	   __builtin_cpu_init();
+	   if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+	   if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+	   return SIMD_NONE;
+    }
+
+    static inline int simdLevel(void) json_nothrow {
+	   static const int level = detectSimd();
+	   return level;
+    }
+
+    //[ and { are the same with 0x20 set, and so are ] and }
+    #define CLASSIFY(width, set1, cmpeq, or_, max_epu8, movemask, in, shift)\
+	   {\
+		  const __m##width##i lower = or_(in, set1(0x20));\
+		  result.quote |= (uint64_t)(uint32_t)movemask(cmpeq(in, set1('\"'))) << shift;\
+		  result.backslash |= (uint64_t)(uint32_t)movemask(cmpeq(in, set1('\\'))) << shift;\
+		  result.structural |= (uint64_t)(uint32_t)movemask(or_(or_(cmpeq(lower, set1('{')), cmpeq(lower, set1('}'))), or_(cmpeq(in, set1(':')), cmpeq(in, set1(','))))) << shift;\
+		  result.control |= (uint64_t)(uint32_t)movemask(cmpeq(max_epu8(in, set1(0x1F)), set1(0x1F))) << shift;\
+		  COMMENT_MASK(set1, cmpeq, or_, movemask, in, shift)\
+		  result.high |= (uint64_t)(uint32_t)movemask(in) << shift;\
+	   }
+
+    #ifndef JSON_STRICT
+	   #define COMMENT_MASK(set1, cmpeq, or_, movemask, in, shift)\
+		  result.comment |= (uint64_t)(uint32_t)movemask(or_(cmpeq(in, set1('/')), cmpeq(in, set1('#')))) << shift;
+    #else
+	   #define COMMENT_MASK(set1, cmpeq, or_, movemask, in, shift)
+    #endif
+
+    __attribute__((target("sse2")))
+    static void classifySSE2(const json_char * text, json_block & result) json_nothrow {
+	   for(unsigned int i = 0; i < 64; i += 16){
+		  const __m128i in = _mm_loadu_si128((const __m128i *)(text + i));
+		  CLASSIFY(128, _mm_set1_epi8, _mm_cmpeq_epi8, _mm_or_si128, _mm_max_epu8, _mm_movemask_epi8, in, i)
+	   }
+    }
+
+    __attribute__((target("avx2")))
+    static void classifyAVX2(const json_char * text, json_block & result) json_nothrow {
+	   for(unsigned int i = 0; i < 64; i += 32){
+		  const __m256i in = _mm256_loadu_si256((const __m256i *)(text + i));
+		  CLASSIFY(256, _mm256_set1_epi8, _mm256_cmpeq_epi8, _mm256_or_si256, _mm256_max_epu8, _mm256_movemask_epi8, in, i)
+	   }
+    }
+#endif
+
+static void classify(const json_char * text, json_block & result) json_nothrow {
+    result.quote = result.backslash = result.structural = result.control = result.comment = result.high = 0;
+    #ifdef JSON_INDEXER_SIMD
+	   switch(simdLevel()){
+		  case SIMD_AVX2:
+			 classifyAVX2(text, result);
+			 return;
+		  case SIMD_SSE2:
+			 classifySSE2(text, result);
+			 return;
+	   }
+    #endif
+    for(unsigned int i = 0; i < 64; ++i){
+	   const uint64_t bit = (uint64_t)1 << i;
+	   switch(text[i]){
+		  case JSON_TEXT('\"'):
+			 result.quote |= bit;
+			 break;
+		  case JSON_TEXT('\\'):
+			 result.backslash |= bit;
+			 break;
+		  case JSON_TEXT('{'):
+		  case JSON_TEXT('}'):
+		  case JSON_TEXT('['):
+		  case JSON_TEXT(']'):
+		  case JSON_TEXT(':'):
+		  case JSON_TEXT(','):
+			 result.structural |= bit;
+			 break;
+		  #ifndef JSON_STRICT
+			 case JSON_TEXT('/'):
+			 case JSON_TEXT('#'):
+				result.comment |= bit;
+				break;
+		  #endif
+		  default:
+			 if ((json_uchar)text[i] < 32) result.control |= bit;
+			 #ifndef JSON_UNICODE
+				else if ((json_uchar)text[i] >= 0x80) result.high |= bit;
+			 #endif
+			 break;
+	   }
+    }
+}
+
+//each bit becomes the xor of itself and all of the bits below it, which turns quotes into the strings between them
+static inline uint64_t prefixXor(uint64_t bits) json_nothrow {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+static inline unsigned int lowestBit(uint64_t bits) json_nothrow {
+    #ifdef __GNUC__
+	   return (unsigned int)__builtin_ctzll(bits);
+    #else
+	   unsigned int result = 0;
+	   while (!(bits & 1)){
+		  bits >>= 1;
+		  ++result;
+	   }
+	   return result;
+    #endif
+}
+
+JSONIndexer::JSONIndexer(bool utf8) json_nothrow : positions(0), count(0), capacity(0), done(0), instring(0), escaped(0), heldlength(0), control(false), comment(false), checkutf8(utf8), utf8need(0), utf8low(0x80), utf8high(0xBF), badutf8(false) {}
+
+JSONIndexer::~JSONIndexer(void) json_nothrow {
+    libjson_free<uint32_t>(positions);
+}
+
+void JSONIndexer::clear(void) json_nothrow {
+    count = 0;
+    done = 0;
+    instring = 0;
+    escaped = 0;
+    heldlength = 0;
+    control = false;
+    comment = false;
+    utf8need = 0;
+    utf8low = 0x80;
+    utf8high = 0xBF;
+    badutf8 = false;
+}
+
+void JSONIndexer::reserve(size_t more) json_nothrow {
+    if (json_likely(count + more <= capacity)) return;
+    capacity = (capacity < 64) ? 256 : capacity * 2;
+    while (capacity < count + more) capacity *= 2;
+    positions = json_realloc<uint32_t>(positions, capacity);
+}
+
+//length is less than 64 only for what's flushed, the rest of the block is white space
+void JSONIndexer::block(const json_char * text, unsigned int length) json_nothrow {
+    json_block bits;
+    classify(text, bits);
+
+    /*
+	   A character is escaped if the run of backslashes before it is odd.  Adding each run's
+	   first backslash to the run carries out of its far end, and whether that happens on an
+	   odd or even bit tells the length of the run
+    */
+    const uint64_t even = 0x5555555555555555ULL;
+    const uint64_t starts = bits.backslash & ~(bits.backslash << 1);
+    const uint64_t evenStartMask = even ^ escaped;  //a run carried in from the last block has its parity flipped
+    const uint64_t evenCarries = bits.backslash + (starts & evenStartMask);
+    const uint64_t oddStarts = starts & ~evenStartMask;
+    uint64_t oddCarries = bits.backslash + oddStarts;
+    const uint64_t endsOdd = (oddCarries < oddStarts) ? 1 : 0;
+    oddCarries |= escaped;
+    const uint64_t escapedChars = ((evenCarries & ~bits.backslash) & ~even) | ((oddCarries & ~bits.backslash) & even);
+    escaped = (length == 64) ? endsOdd : ((escapedChars >> length) & 1);  //a short block's carry lands on the white space after it
+
+    const uint64_t quotes = bits.quote & ~escapedChars;
+    const uint64_t strings = prefixXor(quotes) ^ instring;  //the opening quotes are in, the closing ones aren't
+    instring = (uint64_t)((int64_t)strings >> 63);
+
+    if (json_unlikely(bits.control & strings)) control = true;
+    if (json_unlikely(bits.comment & ~strings)) comment = true;
+    if (checkutf8 && json_unlikely(bits.high || utf8need)) checkUtf8(text, length);
+
+    uint64_t found = (bits.structural & ~strings) | quotes;
+    reserve(64);
+    while (found){
+	   positions[count++] = (uint32_t)(done + lowestBit(found));
+	   found &= found - 1;
+    }
+    done += length;
+}
+
+/*
+    Only blocks with something other than ASCII in them come here, which for most
+    documents is none of them.  Leading bytes say how many continuation bytes follow,
+    and the ones that could start an overlong form or a surrogate narrow the next one
+*/
+void JSONIndexer::checkUtf8(const json_char * text, unsigned int length) json_nothrow {
+    #ifndef JSON_UNICODE
+	   for(unsigned int i = 0; i < length; ++i){
+		  const unsigned char c = (unsigned char)text[i];
+		  if (utf8need){
+			 if (json_unlikely((c < utf8low) || (c > utf8high))){
+				badutf8 = true;
+				utf8need = 0;
+				continue;
+			 }
+			 --utf8need;
+			 utf8low = 0x80;
+			 utf8high = 0xBF;
+		  } else if (c >= 0x80){
+			 if ((c >= 0xC2) && (c <= 0xDF)){
+				utf8need = 1;
+			 } else if ((c >= 0xE0) && (c <= 0xEF)){
+				utf8need = 2;
+				if (c == 0xE0) utf8low = 0xA0;
+				else if (c == 0xED) utf8high = 0x9F;
+			 } else if ((c >= 0xF0) && (c <= 0xF4)){
+				utf8need = 3;
+				if (c == 0xF0) utf8low = 0x90;
+				else if (c == 0xF4) utf8high = 0x8F;
+			 } else {
+				badutf8 = true;
+			 }
+		  }
+	   }
+    #else
+	   (void)text;
+	   (void)length;
+    #endif
+}
+
+void JSONIndexer::index(const json_char * text, size_t length) json_nothrow {
+    JSON_ASSERT(done + heldlength + length <= 0xFFFFFFFFu, JSON_TEXT("Too much text to index"));
+    if (heldlength){  //top up what's held first
+	   const size_t take = (length < 64 - heldlength) ? length : 64 - heldlength;
+	   std::memcpy(held + heldlength, text, take * sizeof(json_char));
+	   heldlength += take;
+	   text += take;
+	   length -= take;
+	   if (heldlength < 64) return;
+	   block(held, 64);
+	   heldlength = 0;
+    }
+    for(; length >= 64; length -= 64, text += 64){
+	   block(text, 64);
+    }
+    std::memcpy(held, text, length * sizeof(json_char));
+    heldlength = length;
+}
+
+void JSONIndexer::flush(void) json_nothrow {
+    if (!heldlength) return;
+    for(size_t i = heldlength; i < 64; ++i){  //white space doesn't change anything
+	   held[i] = JSON_TEXT(' ');
+    }
+    block(held, (unsigned int)heldlength);
+    heldlength = 0;
+}
+
+size_t JSONIndexer::discard(size_t characters) json_nothrow {
+    JSON_ASSERT(characters <= done, JSON_TEXT("Discarding text that hasn't been indexed"));
+    const uint32_t * keep = std::lower_bound((const uint32_t *)positions, end(), (uint32_t)characters);
+    const size_t dropped = keep - positions;
+    count -= dropped;
+    for(size_t i = 0; i < count; ++i){
+	   positions[i] = keep[i] - (uint32_t)characters;
+    }
+    done -= characters;
+    return dropped;
+}
+
+const uint32_t * JSONIndexer::matching(const uint32_t * open, const json_char * text) const json_nothrow {
+    size_t depth = 0;
+    for(const uint32_t * runner = open; runner != end(); ++runner){
+	   switch(text[*runner]){
+		  case JSON_TEXT('{'):
+		  case JSON_TEXT('['):
+			 ++depth;
+			 break;
+		  case JSON_TEXT('}'):
+		  case JSON_TEXT(']'):
+			 if (--depth == 0) return runner;
+			 break;
+	   }
+    }
+    return end();
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef JSON_INDEXER_H
+#define JSON_INDEXER_H
+
+#include "JSONDebug.h"
+
+#if defined(JSON_READ_PRIORITY) || defined(JSON_STREAM)
+
+#include <stdint.h>
+
+/*
+    Finds the characters that give JSON its structure, 64 at a time and with vector
+    compares where it can.  Those are the brackets, colons and commas that aren't in
+    strings, and every quote that isn't escaped.  Their offsets are listed in order, so
+    that readers can step from one to the next instead of looking at every character.
+
+    Text can be given in pieces, whatever is in the middle of a string or an escape
+    carries on into the next piece.  Offsets count from the start of the first piece,
+    or from wherever the last discard left off.
+*/
+class JSONIndexer {
+public:
+    //only the validator asks for UTF-8 to be checked, the readers take whatever bytes they're given
+    explicit JSONIndexer(bool utf8 = false) json_nothrow;
+    ~JSONIndexer(void) json_nothrow;
+
+    //indexes whole blocks of it, the rest is held until more comes or flush is called
+    void index(const json_char * text, size_t length) json_nothrow json_hot;
+    //indexes what's held as well, more text can still be given after it
+    void flush(void) json_nothrow;
+    //forgets the first characters and what was found in them, offsets then count from what's left
+    size_t discard(size_t characters) json_nothrow;
+    //forgets everything, ready for new text
+    void clear(void) json_nothrow;
+
+    inline const uint32_t * begin(void) const json_nothrow { return positions; }
+    inline const uint32_t * end(void) const json_nothrow { return positions + count; }
+    inline size_t size(void) const json_nothrow { return count; }
+    //how much text has been indexed, not counting what's held
+    inline size_t indexed(void) const json_nothrow { return done; }
+
+    //whether what has been indexed so far ends inside a string
+    inline bool inString(void) const json_nothrow { return instring != 0; }
+    //control characters are never allowed in strings
+    inline bool sawControl(void) const json_nothrow { return control; }
+    //a comment can have an odd number of quotes in it, which throws off the strings after it
+    inline bool sawComment(void) const json_nothrow { return comment; }
+    //whether everything so far is well formed UTF-8 and doesn't stop in the middle of a character,
+    //always true unless it was asked for
+    inline bool validUtf8(void) const json_nothrow { return !badutf8 && !utf8need; }
+
+    //the bracket that closes the one listed at open, or end() if it hasn't been indexed yet
+    const uint32_t * matching(const uint32_t * open, const json_char * text) const json_nothrow;
+JSON_PRIVATE
+    void block(const json_char * text, unsigned int length) json_nothrow json_hot;
+    void reserve(size_t more) json_nothrow;
+    void checkUtf8(const json_char * text, unsigned int length) json_nothrow;
+
+    uint32_t * positions;
+    size_t count;
+    size_t capacity;
+    size_t done;
+    uint64_t instring;  //all ones while in a string, so that it can be xored straight in
+    uint64_t escaped;  //1 if the first character of the next block is escaped
+    json_char held[64];
+    size_t heldlength;
+    bool control;
+    bool comment;
+    bool checkutf8;
+    unsigned char utf8need;  //continuation bytes still to come
+    unsigned char utf8low;  //what the next one can be, some leading bytes narrow it
+    unsigned char utf8high;
+    bool badutf8;
+    JSONIndexer(const JSONIndexer &);
+    JSONIndexer & operator = (const JSONIndexer &);
+};
+
+#endif
+#endif
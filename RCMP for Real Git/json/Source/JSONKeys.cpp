@@ -0,0 +1,32 @@
+#include "JSONKeys.h"
+
+#ifdef JSON_INTERNED_KEYS
+#include <set>
+
+#if defined(__cplusplus) && (__cplusplus >= 201103L)
+    #include <mutex>
+    #define JSON_KEYS_LOCK() std::lock_guard<std::mutex> guard(keys_lock())
+    static inline std::mutex & keys_lock(void) json_nothrow {
+	   static std::mutex mylock;
+	   return mylock;
+    }
+#else
+    #define JSON_KEYS_LOCK() (void)0  //without C++11, intern everything before starting threads
+#endif
+
+//a set never moves its elements, so pointers into it stay good
+static inline std::set<json_string> & keys(void) json_nothrow {
+    static std::set<json_string> mykeys;
+    return mykeys;
+}
+
+json_key JSONKeys::intern(const json_string & name_t) json_nothrow {
+    JSON_KEYS_LOCK();
+    return json_key(&*keys().insert(name_t).first);
+}
+
+size_t JSONKeys::size(void) json_nothrow {
+    JSON_KEYS_LOCK();
+    return keys().size();
+}
+#endif
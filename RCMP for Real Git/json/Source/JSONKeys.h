@@ -0,0 +1,37 @@
+#ifndef JSON_KEYS_H
+#define JSON_KEYS_H
+
+#include "JSONDebug.h"
+
+#ifdef JSON_INTERNED_KEYS
+
+/*
+    A name that is kept once for the whole program.  Nodes named with one point at it
+    instead of holding their own copy, and looking a child up by one compares the pointers
+    before bothering with the strings.  Get them from JSONKeys::intern, they're never freed.
+*/
+class json_key {
+public:
+    json_key(void) json_nothrow : mystr(0){}
+    inline const json_string & str(void) const json_nothrow {
+	   JSON_ASSERT(mystr != 0, JSON_TEXT("using an empty key"));
+	   return *mystr;
+    }
+    inline bool operator == (const json_key & other) const json_nothrow { return mystr == other.mystr; }
+    inline bool operator != (const json_key & other) const json_nothrow { return mystr != other.mystr; }
+JSON_PRIVATE
+    explicit json_key(const json_string * str) json_nothrow : mystr(str){}
+    const json_string * mystr;
+    friend class JSONKeys;
+    friend class internalJSONNode;
+};
+
+class JSONKeys {
+public:
+    //the same name always gives the same key
+    static json_key intern(const json_string & name_t) json_nothrow json_cold;
+    static size_t size(void) json_nothrow json_cold;
+};
+
+#endif
+#endif
@@ -35,7 +35,30 @@ json_malloc_t mymalloc = 0;
 json_realloc_t myrealloc = 0;
 json_free_t myfree = 0;
 
-void * JSONMemory::json_malloc(size_t siz) json_nothrow {
+#ifdef JSON_MEMORY_ARENA
+    //sits in front of everything JSONMemory hands out so that it can be given back to wherever it came from
+    struct json_alloc_header {
+	   JSONArena * owner;  //0 for the heap
+	   size_t size;  //what was asked for from the heap, everything after the header from an arena
+    };
+
+    //everything in an arena is kept aligned to the size of the header, which is two words
+    #define JSON_ARENA_ROUND(siz) (((siz) + (sizeof(json_alloc_header) - 1)) & ~(sizeof(json_alloc_header) - 1))
+
+    static json_thread_local JSONArena * current_arena = 0;
+
+    #define JSON_RAW(name) raw_##name
+    static inline void * raw_malloc(size_t siz) json_nothrow;
+    static inline void * raw_realloc(void * ptr, size_t siz) json_nothrow;
+    static inline void raw_free(void * ptr) json_nothrow;
+#else
+    #define JSON_RAW(name) JSONMemory::json_##name
+#endif
+
+void * JSON_RAW(malloc)(size_t siz) json_nothrow {
+    #if defined(JSON_STATS) && !defined(JSON_MEMORY_ARENA)  //with an arena it's counted before the header is added
+	   JSONStats::allocated(siz);
+    #endif
     if (mymalloc != 0){
 	   #ifdef JSON_DEBUG  //in debug mode, see if the malloc was successful
 		  void * result = mymalloc(siz);
@@ -54,7 +77,10 @@ void * JSONMemory::json_malloc(size_t siz) json_nothrow {
     #endif
 }
 
-void * JSONMemory::json_realloc(void * ptr, size_t siz) json_nothrow {
+void * JSON_RAW(realloc)(void * ptr, size_t siz) json_nothrow {
+    #if defined(JSON_STATS) && !defined(JSON_MEMORY_ARENA)  //with an arena it's counted before the header is added
+	   JSONStats::allocated(siz);
+    #endif
     if (myrealloc != 0){
 	   #ifdef JSON_DEBUG  //in debug mode, see if the malloc was successful
 		  void * result = myrealloc(ptr, siz);
@@ -73,7 +99,7 @@ void * JSONMemory::json_realloc(void * ptr, size_t siz) json_nothrow {
     #endif
 }
 
-void JSONMemory::json_free(void * ptr) json_nothrow {
+void JSON_RAW(free)(void * ptr) json_nothrow {
     if (myfree != 0){
 	   myfree(ptr);
     } else {
@@ -81,6 +107,158 @@ void JSONMemory::json_free(void * ptr) json_nothrow {
     }
 }
 
+#ifdef JSON_MEMORY_ARENA
+    void * JSONMemory::json_malloc(size_t siz) json_nothrow {
+	   #ifdef JSON_STATS
+		  JSONStats::allocated(siz);
+	   #endif
+	   JSONArena * arena = current_arena;
+	   json_alloc_header * head;
+	   if (arena != 0){
+		  head = (json_alloc_header *)arena -> allocate(siz + sizeof(json_alloc_header));
+	   } else {
+		  head = (json_alloc_header *)raw_malloc(siz + sizeof(json_alloc_header));
+	   }
+	   if (json_unlikely(head == 0)) return 0;
+	   head -> owner = arena;
+	   head -> size = (arena != 0) ? JSON_ARENA_ROUND(siz + sizeof(json_alloc_header)) - sizeof(json_alloc_header) : siz;
+	   return head + 1;
+    }
+
+    void * JSONMemory::json_realloc(void * ptr, size_t siz) json_nothrow {
+	   if (json_unlikely(ptr == 0)) return json_malloc(siz);
+	   #ifdef JSON_STATS
+		  JSONStats::allocated(siz);
+	   #endif
+	   json_alloc_header * head = (json_alloc_header *)ptr - 1;
+	   if (JSONArena * arena = head -> owner){
+		  size_t room = head -> size + sizeof(json_alloc_header);
+		  head = (json_alloc_header *)arena -> reallocate(head, room, siz + sizeof(json_alloc_header));
+		  if (json_unlikely(head == 0)) return 0;
+		  head -> size = room - sizeof(json_alloc_header);
+		  return head + 1;
+	   }
+	   head = (json_alloc_header *)raw_realloc(head, siz + sizeof(json_alloc_header));
+	   if (json_unlikely(head == 0)) return 0;
+	   head -> size = siz;
+	   return head + 1;
+    }
+
+    void JSONMemory::json_free(void * ptr) json_nothrow {
+	   if (json_unlikely(ptr == 0)) return;
+	   json_alloc_header * head = (json_alloc_header *)ptr - 1;
+	   if (JSONArena * arena = head -> owner){
+		  arena -> deallocate(head, head -> size + sizeof(json_alloc_header));
+	   } else {
+		  raw_free(head);
+	   }
+    }
+
+    JSONArena::JSONArena(size_t blocksize) json_nothrow : blocks(0), mytop(0), myend(0), myblocksize(JSON_ARENA_ROUND(blocksize)), myused(0), myreserved(0){}
+
+    JSONArena::~JSONArena(void) json_nothrow {
+	   JSON_ASSERT(current_arena != this, JSON_TEXT("destroying the current arena"));
+	   while(blocks != 0){
+		  block * next = blocks -> next;
+		  raw_free(blocks);
+		  blocks = next;
+	   }
+    }
+
+    JSONArena::block * JSONArena::newBlock(size_t siz) json_nothrow {
+	   block * result = (block *)raw_malloc(sizeof(block) + siz);
+	   if (json_unlikely(result == 0)) return 0;
+	   result -> size = siz;
+	   myreserved += siz;
+	   return result;
+    }
+
+    void * JSONArena::allocate(size_t siz) json_nothrow {
+	   siz = JSON_ARENA_ROUND(siz);
+	   if (json_unlikely(mytop + siz > myend)){
+		  if (siz > (myblocksize >> 1)){  //big ones get a block of their own so the current one isn't wasted
+			 block * big = newBlock(siz);
+			 if (json_unlikely(big == 0)) return 0;
+			 if (blocks != 0){
+				big -> next = blocks -> next;
+				blocks -> next = big;
+			 } else {  //nothing to bump from yet, so the big one is also the current block, though it's full
+				big -> next = 0;
+				blocks = big;
+				myend = mytop = (char *)(big + 1) + siz;
+			 }
+			 myused += siz;
+			 return big + 1;
+		  }
+		  block * fresh = newBlock(myblocksize);
+		  if (json_unlikely(fresh == 0)) return 0;
+		  fresh -> next = blocks;
+		  blocks = fresh;
+		  mytop = (char *)(fresh + 1);
+		  myend = mytop + myblocksize;
+	   }
+	   void * result = mytop;
+	   mytop += siz;
+	   myused += siz;
+	   return result;
+    }
+
+    void * JSONArena::reallocate(void * ptr, size_t & siz, size_t wanted) json_nothrow {
+	   wanted = JSON_ARENA_ROUND(wanted);
+	   if (wanted <= siz) return ptr;  //still fits, shrinking keeps the room
+	   if (((char *)ptr + siz == mytop) && ((char *)ptr + wanted <= myend)){  //the last thing handed out can grow where it is
+		  mytop = (char *)ptr + wanted;
+		  myused += wanted - siz;
+		  siz = wanted;
+		  return ptr;
+	   }
+	   //has to move, leave it room to grow so that growing a bit at a time doesn't copy every time
+	   size_t grown = siz << 1;
+	   if (grown < wanted) grown = wanted;
+	   void * result = allocate(grown);
+	   if (json_likely(result != 0)){
+		  memcpy(result, ptr, siz);
+		  deallocate(ptr, siz);
+		  siz = grown;
+	   }
+	   return result;
+    }
+
+    void JSONArena::deallocate(void * ptr, size_t siz) json_nothrow {
+	   siz = JSON_ARENA_ROUND(siz);
+	   if ((char *)ptr + siz == mytop){  //only the top can be given back, the rest waits for release
+		  mytop = (char *)ptr;
+		  myused -= siz;
+	   }
+    }
+
+    void JSONArena::release(void) json_nothrow {
+	   if (blocks == 0) return;
+	   block * keep = blocks;
+	   while(keep -> next != 0){
+		  block * next = keep -> next -> next;
+		  raw_free(keep -> next);
+		  keep -> next = next;
+	   }
+	   myreserved = keep -> size;
+	   myused = 0;
+	   mytop = (char *)(keep + 1);
+	   myend = mytop + keep -> size;
+    }
+
+    JSONArena * JSONArena::current(void) json_nothrow {
+	   return current_arena;
+    }
+
+    JSONArena::scope::scope(JSONArena & arena) json_nothrow : previous(current_arena){
+	   current_arena = &arena;
+    }
+
+    JSONArena::scope::~scope(void) json_nothrow {
+	   current_arena = previous;
+    }
+#endif
+
 void JSONMemory::registerMemoryCallbacks(json_malloc_t mal, json_realloc_t real, json_free_t fre) json_nothrow {
     mymalloc = mal;
     myrealloc = real;
@@ -88,3 +266,337 @@ void JSONMemory::registerMemoryCallbacks(json_malloc_t mal, json_realloc_t real,
 }
 
 #endif
+
+#ifdef JSON_MEMORY_POOL
+    #if !defined(__cplusplus) || (__cplusplus < 201103L)
+	   #error, JSON_MEMORY_POOL requires C++11
+    #endif
+
+    #include <mutex>
+
+    //every block is a multiple of a pointer, which is all nodes and arrays need to be aligned to
+    #define JSON_POOL_GRAIN sizeof(void *)
+    #define JSON_POOL_CLASSES (JSON_POOL_MAX_SIZE / JSON_POOL_GRAIN)
+    #define JSON_POOL_SLAB 16384
+    #define JSON_POOL_CLASS(siz) (((siz) - 1) / JSON_POOL_GRAIN)
+    #define JSON_POOL_BATCH(cls) (JSON_POOL_SLAB / (((cls) + 1) * JSON_POOL_GRAIN))  //blocks in a slab
+
+    struct json_pool_block {
+	   json_pool_block * next;
+    };
+
+    //lists given back by threads that have exited or freed more than they keep, the only thing
+    //shared between threads
+    static std::mutex pool_depot_lock;
+    static json_pool_block * pool_depot[JSON_POOL_CLASSES];
+
+    //static destructors can still make and free nodes after this thread's cache is gone, those
+    //blocks go straight to and from the depot
+    static thread_local bool pool_gone = false;
+
+    struct json_pool_cache {
+	   json_pool_cache(void) json_nothrow : hits(0), misses(0) {
+		  memset(lists, 0, sizeof(lists));
+		  memset(counts, 0, sizeof(counts));
+	   }
+
+	   //hand everything to the depot so another thread can use it
+	   ~json_pool_cache(void) json_nothrow {
+		  std::lock_guard<std::mutex> guard(pool_depot_lock);
+		  for(size_t i = 0; i < JSON_POOL_CLASSES; ++i){
+			 if (json_likely(lists[i] == 0)) continue;
+			 json_pool_block * tail = lists[i];
+			 while(tail -> next != 0) tail = tail -> next;
+			 tail -> next = pool_depot[i];
+			 pool_depot[i] = lists[i];
+		  }
+		  pool_gone = true;
+	   }
+
+	   json_pool_block * refill(size_t cls) json_nothrow;
+	   void spill(size_t cls) json_nothrow;
+
+	   json_pool_block * lists[JSON_POOL_CLASSES];
+	   size_t counts[JSON_POOL_CLASSES];  //how many blocks are in each list
+	   size_t hits;
+	   size_t misses;
+    };
+
+    static thread_local json_pool_cache pool_cache;
+
+    json_pool_block * json_pool_cache::refill(size_t cls) json_nothrow {
+	   ++misses;
+	   const size_t batch = JSON_POOL_BATCH(cls);
+	   {
+		  std::lock_guard<std::mutex> guard(pool_depot_lock);
+		  if (pool_depot[cls] != 0){
+			 //a slab's worth at most, whatever else is there is left for the other threads
+			 json_pool_block * res = pool_depot[cls];
+			 json_pool_block * tail = res;
+			 size_t count = 1;
+			 for(; (count < batch) && (tail -> next != 0); ++count) tail = tail -> next;
+			 pool_depot[cls] = tail -> next;
+			 tail -> next = 0;
+			 counts[cls] = count;
+			 return res;
+		  }
+	   }
+
+	   //slabs are never given back, the blocks in them just keep going around the lists, so they
+	   //can't come from an arena
+	   const size_t siz = (cls + 1) * JSON_POOL_GRAIN;
+	   #ifdef JSON_MEMORY_CALLBACKS
+		  char * slab = (char *)JSON_RAW(malloc)(JSON_POOL_SLAB);
+	   #else
+		  char * slab = json_malloc<char>(JSON_POOL_SLAB);
+	   #endif
+	   JSON_ASSERT_SAFE(slab != 0, JSON_TEXT("out of memory"), return 0;);
+	   json_pool_block * res = 0;
+	   for(size_t i = batch; i != 0; --i){
+		  json_pool_block * block = (json_pool_block *)(slab + (i - 1) * siz);
+		  block -> next = res;
+		  res = block;
+	   }
+	   counts[cls] = batch;
+	   return res;
+    }
+
+    //a thread that frees what another one made would otherwise keep every block, so once it has
+    //two slabs' worth, the most recently freed slab's worth stays and the rest goes to the depot
+    void json_pool_cache::spill(size_t cls) json_nothrow {
+	   const size_t batch = JSON_POOL_BATCH(cls);
+	   json_pool_block * kept = lists[cls];
+	   for(size_t i = 1; i < batch; ++i) kept = kept -> next;
+	   json_pool_block * first = kept -> next;
+	   kept -> next = 0;
+	   json_pool_block * last = first;
+	   while(last -> next != 0) last = last -> next;
+	   counts[cls] = batch;
+
+	   std::lock_guard<std::mutex> guard(pool_depot_lock);
+	   last -> next = pool_depot[cls];
+	   pool_depot[cls] = first;
+    }
+
+    //a whole block of the class, so that it can go in the depot when it's freed
+    static void * depot_allocate(size_t cls) json_nothrow {
+	   {
+		  std::lock_guard<std::mutex> guard(pool_depot_lock);
+		  json_pool_block * res = pool_depot[cls];
+		  if (res != 0){
+			 pool_depot[cls] = res -> next;
+			 return res;
+		  }
+	   }
+	   #ifdef JSON_MEMORY_CALLBACKS
+		  return JSON_RAW(malloc)((cls + 1) * JSON_POOL_GRAIN);
+	   #else
+		  return json_malloc<char>((cls + 1) * JSON_POOL_GRAIN);
+	   #endif
+    }
+
+    static void depot_deallocate(json_pool_block * block, size_t cls) json_nothrow {
+	   std::lock_guard<std::mutex> guard(pool_depot_lock);
+	   block -> next = pool_depot[cls];
+	   pool_depot[cls] = block;
+    }
+
+    void * JSONPool::allocate(size_t siz) json_nothrow {
+	   if (json_unlikely(siz > JSON_POOL_MAX_SIZE)) return json_malloc<char>(siz);
+	   if (json_unlikely(siz == 0)) siz = 1;
+	   if (json_unlikely(pool_gone)) return depot_allocate(JSON_POOL_CLASS(siz));
+	   json_pool_cache & cache = pool_cache;
+	   const size_t cls = JSON_POOL_CLASS(siz);
+	   json_pool_block * res = cache.lists[cls];
+	   if (json_likely(res != 0)){
+		  ++cache.hits;
+	   } else {
+		  res = cache.refill(cls);
+		  if (json_unlikely(res == 0)) return 0;
+	   }
+	   cache.lists[cls] = res -> next;
+	   --cache.counts[cls];
+	   return res;
+    }
+
+    void * JSONPool::reallocate(void * ptr, size_t oldsiz, size_t siz) json_nothrow {
+	   if (json_unlikely(ptr == 0)) return allocate(siz);
+	   if (oldsiz > JSON_POOL_MAX_SIZE){
+		  if (json_likely(siz > JSON_POOL_MAX_SIZE)) return json_realloc<char>((char *)ptr, siz);
+	   } else if (siz <= JSON_POOL_MAX_SIZE && siz != 0 && JSON_POOL_CLASS(siz) == JSON_POOL_CLASS(oldsiz)){
+		  return ptr;  //still fits in the block it has
+	   }
+	   void * res = allocate(siz);
+	   if (json_likely(res != 0)){
+		  memcpy(res, ptr, oldsiz < siz ? oldsiz : siz);
+		  deallocate(ptr, oldsiz);
+	   }
+	   return res;
+    }
+
+    void JSONPool::deallocate(void * ptr, size_t siz) json_nothrow {
+	   if (json_unlikely(ptr == 0)) return;
+	   if (json_unlikely(siz > JSON_POOL_MAX_SIZE)){
+		  libjson_free<void>(ptr);
+		  return;
+	   }
+	   if (json_unlikely(siz == 0)) siz = 1;
+	   const size_t cls = JSON_POOL_CLASS(siz);
+	   json_pool_block * block = (json_pool_block *)ptr;
+	   if (json_unlikely(pool_gone)){
+		  depot_deallocate(block, cls);
+		  return;
+	   }
+	   json_pool_cache & cache = pool_cache;
+	   block -> next = cache.lists[cls];
+	   cache.lists[cls] = block;
+	   if (json_unlikely(++cache.counts[cls] > 2 * JSON_POOL_BATCH(cls))) cache.spill(cls);
+    }
+
+    size_t JSONPool::hits(void) json_nothrow {
+	   return pool_cache.hits;
+    }
+
+    size_t JSONPool::misses(void) json_nothrow {
+	   return pool_cache.misses;
+    }
+#endif
+
+#ifdef JSON_STATS
+    #if defined(__cplusplus) && (__cplusplus >= 201103L)
+	   #include <atomic>
+	   #include <mutex>
+	   //only the thread they belong to writes them, others just need to read something sane
+	   typedef std::atomic<ptrdiff_t> json_stat;
+	   #define JSON_STAT_LOAD(stat) (stat).load(std::memory_order_relaxed)
+	   #define JSON_STAT_STORE(stat, val) (stat).store((val), std::memory_order_relaxed)
+	   #define JSON_STATS_SHARED
+    #else
+	   //without C++11 there is no way to find another thread's, so they only have to be plain
+	   typedef ptrdiff_t json_stat;
+	   #define JSON_STAT_LOAD(stat) (stat)
+	   #define JSON_STAT_STORE(stat, val) (stat) = (val)
+    #endif
+
+    struct json_stats_counters {
+	   json_stat live[JSONStats::STAT_KINDS];
+	   json_stat peak[JSONStats::STAT_KINDS];
+	   json_stat allocations;
+	   json_stat bytes;
+    };
+
+    static void addStats(json_stats & res, const json_stats_counters & counters) json_nothrow {
+	   res.nodes += JSON_STAT_LOAD(counters.live[JSONStats::STAT_NODES]);
+	   res.internals += JSON_STAT_LOAD(counters.live[JSONStats::STAT_INTERNALS]);
+	   res.children += JSON_STAT_LOAD(counters.live[JSONStats::STAT_CHILDREN]);
+	   ptrdiff_t peak;
+	   if ((peak = JSON_STAT_LOAD(counters.peak[JSONStats::STAT_NODES])) > res.peak_nodes) res.peak_nodes = peak;
+	   if ((peak = JSON_STAT_LOAD(counters.peak[JSONStats::STAT_INTERNALS])) > res.peak_internals) res.peak_internals = peak;
+	   if ((peak = JSON_STAT_LOAD(counters.peak[JSONStats::STAT_CHILDREN])) > res.peak_children) res.peak_children = peak;
+	   res.allocations += (size_t)JSON_STAT_LOAD(counters.allocations);
+	   res.bytes += (size_t)JSON_STAT_LOAD(counters.bytes);
+    }
+
+    #ifdef JSON_STATS_SHARED
+	   //every thread's counters are on a list so that total can find them, exited threads leave theirs in stats_retired
+	   struct json_stats_thread : json_stats_counters {
+		  json_stats_thread(void) json_nothrow;
+		  ~json_stats_thread(void) json_nothrow;
+		  json_stats_thread * next;
+		  json_stats_thread * prev;
+	   };
+
+	   static std::mutex stats_lock;
+	   static json_stats_thread * stats_threads = 0;
+	   static json_stats stats_retired = json_stats();
+
+	   //nodes can still be deleted after this thread's counters are, those go here and aren't counted anywhere
+	   static json_stats_counters stats_lost;
+
+	   //getting to stats_here checks that it was constructed every time, this doesn't need to
+	   static json_thread_local json_stats_counters * stats_mine = 0;
+
+	   json_stats_thread::json_stats_thread(void) json_nothrow : next(0), prev(0) {
+		  for(int i = 0; i < JSONStats::STAT_KINDS; ++i){
+			 JSON_STAT_STORE(live[i], 0);
+			 JSON_STAT_STORE(peak[i], 0);
+		  }
+		  JSON_STAT_STORE(allocations, 0);
+		  JSON_STAT_STORE(bytes, 0);
+		  std::lock_guard<std::mutex> guard(stats_lock);
+		  next = stats_threads;
+		  if (next != 0) next -> prev = this;
+		  stats_threads = this;
+	   }
+
+	   json_stats_thread::~json_stats_thread(void) json_nothrow {
+		  std::lock_guard<std::mutex> guard(stats_lock);
+		  if (next != 0) next -> prev = prev;
+		  if (prev != 0){
+			 prev -> next = next;
+		  } else {
+			 stats_threads = next;
+		  }
+		  addStats(stats_retired, *this);
+		  stats_mine = &stats_lost;
+	   }
+
+	   static thread_local json_stats_thread stats_here;
+
+	   static inline json_stats_counters & myStats(void) json_nothrow {
+		  json_stats_counters * res = stats_mine;
+		  if (json_unlikely(res == 0)) res = stats_mine = &stats_here;
+		  return *res;
+	   }
+    #else
+	   static json_thread_local json_stats_counters stats_here;
+
+	   static inline json_stats_counters & myStats(void) json_nothrow {
+		  return stats_here;
+	   }
+    #endif
+
+    json_stats JSONStats::thread(void) json_nothrow {
+	   json_stats res = json_stats();
+	   addStats(res, myStats());
+	   return res;
+    }
+
+    json_stats JSONStats::total(void) json_nothrow {
+	   #ifdef JSON_STATS_SHARED
+		  std::lock_guard<std::mutex> guard(stats_lock);
+		  json_stats res = stats_retired;
+		  for(json_stats_thread * counters = stats_threads; counters != 0; counters = counters -> next){
+			 addStats(res, *counters);
+		  }
+		  return res;
+	   #else
+		  return thread();
+	   #endif
+    }
+
+    void JSONStats::resetPeaks(void) json_nothrow {
+	   json_stats_counters & counters = myStats();
+	   for(int i = 0; i < STAT_KINDS; ++i){
+		  JSON_STAT_STORE(counters.peak[i], JSON_STAT_LOAD(counters.live[i]));
+	   }
+    }
+
+    void JSONStats::made(int kind) json_nothrow {
+	   json_stats_counters & counters = myStats();
+	   ptrdiff_t now = JSON_STAT_LOAD(counters.live[kind]) + 1;
+	   JSON_STAT_STORE(counters.live[kind], now);
+	   if (now > JSON_STAT_LOAD(counters.peak[kind])) JSON_STAT_STORE(counters.peak[kind], now);
+    }
+
+    void JSONStats::gone(int kind) json_nothrow {
+	   json_stats_counters & counters = myStats();
+	   JSON_STAT_STORE(counters.live[kind], JSON_STAT_LOAD(counters.live[kind]) - 1);
+    }
+
+    void JSONStats::allocated(size_t siz) json_nothrow {
+	   json_stats_counters & counters = myStats();
+	   JSON_STAT_STORE(counters.allocations, JSON_STAT_LOAD(counters.allocations) + 1);
+	   JSON_STAT_STORE(counters.bytes, JSON_STAT_LOAD(counters.bytes) + (ptrdiff_t)siz);
+    }
+#endif
@@ -3,6 +3,7 @@
 
 #include <cstdlib> //for malloc, realloc, and free
 #include <cstring> //for memmove
+#include <cstddef> //for ptrdiff_t
 #include "../JSONOptions.h"
 #include "JSONDebug.h"
 
@@ -12,6 +13,41 @@
     #define JSON_FREE_PASSTYPE
 #endif
 
+#ifdef JSON_STATS
+    //what JSONStats read, live counts can be off for a thread that deletes what another made
+    struct json_stats {
+	   ptrdiff_t nodes;  //JSONNodes alive
+	   ptrdiff_t internals;  //internalJSONNodes alive, copies of a node can share one
+	   ptrdiff_t children;  //jsonChildren alive, every node and array has one
+	   ptrdiff_t peak_nodes;  //the most of each there has been since resetPeaks
+	   ptrdiff_t peak_internals;
+	   ptrdiff_t peak_children;
+	   size_t allocations;  //calls to json_malloc and json_realloc
+	   size_t bytes;  //what they asked for
+    };
+
+    /*
+	   Counts of what libjson makes, kept for each thread.  Only the thread a counter belongs
+	   to ever writes it, with relaxed atomics, so counting costs a load and a store and never
+	   a locked instruction.  Peaks are the most that were alive at once since resetPeaks,
+	   which can be called before each tree to find what that one tree took.
+    */
+    class JSONStats {
+    public:
+	   enum { STAT_NODES, STAT_INTERNALS, STAT_CHILDREN, STAT_KINDS };
+
+	   static json_stats thread(void) json_nothrow;
+	   //every thread's added up, including ones that have exited, the peaks are the highest any one thread had
+	   static json_stats total(void) json_nothrow;
+	   //for this thread, starts the peaks again from what is alive now
+	   static void resetPeaks(void) json_nothrow;
+
+	   static void made(int kind) json_nothrow json_hot;
+	   static void gone(int kind) json_nothrow json_hot;
+	   static void allocated(size_t siz) json_nothrow json_hot;
+    };
+#endif
+
 #ifdef JSON_MEMORY_CALLBACKS
     class JSONMemory {
     public:
@@ -26,6 +62,67 @@
 	   static void registerMemoryCallbacks(json_malloc_t mal, json_realloc_t real, json_free_t fre) json_nothrow json_cold;
     };
 
+    #ifdef JSON_MEMORY_ARENA
+	   #ifndef JSON_ARENA_BLOCK_SIZE
+		  #define JSON_ARENA_BLOCK_SIZE 65536
+	   #endif
+
+	   /*
+		  A region for building a tree in.  While an arena is the current one for a thread,
+		  JSONMemory hands out pieces of it by bumping a pointer, and freeing them does nothing
+		  (unless it was the last thing handed out, then it's given back.)  The memory comes back
+		  all at once in release() or the destructor, so everything built in it has to be
+		  destroyed before then.  Blocks are remembered by their owner, so it doesn't matter
+		  which arena is current when something is freed, but an arena is not thread safe, so
+		  trees built in it should stay on the thread that built them.
+	   */
+	   class JSONArena {
+	   public:
+		  JSONArena(size_t blocksize = JSON_ARENA_BLOCK_SIZE) json_nothrow;
+		  ~JSONArena(void) json_nothrow;
+
+		  //sizes are rounded up to two words, reallocate takes and updates how much ptr really has
+		  void * allocate(size_t siz) json_nothrow json_hot;
+		  void * reallocate(void * ptr, size_t & siz, size_t wanted) json_nothrow;
+		  void deallocate(void * ptr, size_t siz) json_nothrow json_hot;
+
+		  //gives back everything, the first block is kept for the next tree
+		  void release(void) json_nothrow;
+
+		  inline size_t used(void) const json_nothrow { return myused; }
+		  inline size_t reserved(void) const json_nothrow { return myreserved; }
+
+		  static JSONArena * current(void) json_nothrow;
+
+		  //makes arena the current one for this thread until it goes out of scope
+		  struct scope {
+		  public:
+			 scope(JSONArena & arena) json_nothrow;
+			 ~scope(void) json_nothrow;
+		  private:
+			 scope(const scope &);
+			 scope & operator = (const scope &);
+			 JSONArena * previous;
+		  };
+	   JSON_PRIVATE
+		  struct block {
+			 block * next;
+			 size_t size;
+		  };
+		  block * newBlock(size_t siz) json_nothrow;
+
+		  block * blocks;  //newest first, the first one is where mytop is
+		  char * mytop;
+		  char * myend;
+		  size_t myblocksize;
+		  size_t myused;
+		  size_t myreserved;
+	   private:
+		  JSONArena(const JSONArena &);
+		  JSONArena & operator = (const JSONArena &);
+	   };
+    #endif
+
     template <typename T> static inline T * json_malloc(size_t count) json_malloc_attr;
     template <typename T> static inline T * json_malloc(size_t count) json_nothrow {
 	   return (T *)JSONMemory::json_malloc(sizeof(T) * count);
@@ -46,6 +143,9 @@
 
     template <typename T> static inline T * json_malloc(size_t count) json_malloc_attr;
     template <typename T> static inline T * json_malloc(size_t count) json_nothrow {
+	   #ifdef JSON_STATS
+		  JSONStats::allocated(count * sizeof(T));
+	   #endif
 	   #ifdef JSON_DEBUG  //in debug mode, see if the malloc was successful
 		  void * result = malloc(count * sizeof(T));
 		  JSON_ASSERT(result != 0, JSON_TEXT("out of memory"));
@@ -67,6 +167,9 @@
 
     template <typename T> static inline T * json_realloc(T * ptr, size_t count) json_malloc_attr;
     template <typename T> static inline T * json_realloc(T * ptr, size_t count) json_nothrow {
+	   #ifdef JSON_STATS
+		  JSONStats::allocated(count * sizeof(T));
+	   #endif
 	   #ifdef JSON_DEBUG  //in debug mode, check the results of realloc to be sure it was successful
 		  void * result = realloc(ptr, count * sizeof(T));
 		  JSON_ASSERT(result != 0, JSON_TEXT("out of memory"));
@@ -80,6 +183,55 @@
     }
 #endif
 
+#ifdef JSON_MEMORY_POOL
+    #ifndef JSON_POOL_MAX_SIZE
+	   #define JSON_POOL_MAX_SIZE 256
+    #endif
+
+    /*
+	   Free lists for the small things libjson makes and throws away the most of, nodes and
+	   short children arrays.  Every thread has its own lists, so nothing is locked unless a
+	   list runs dry, then it's refilled from what exited threads gave back or from a new slab.
+	   A block freed on another thread than it was made on just joins that thread's lists.
+	   Anything bigger than JSON_POOL_MAX_SIZE goes to json_malloc as usual.
+    */
+    class JSONPool {
+    public:
+	   static void * allocate(size_t siz) json_nothrow json_hot;
+	   static void * reallocate(void * ptr, size_t oldsiz, size_t siz) json_nothrow;
+	   static void deallocate(void * ptr, size_t siz) json_nothrow json_hot;
+
+	   //how many allocations this thread got straight off a list, and how many needed a refill
+	   static size_t hits(void) json_nothrow;
+	   static size_t misses(void) json_nothrow;
+    };
+
+    template <typename T> static inline T * json_pool_malloc(size_t count) json_nothrow {
+	   return (T *)JSONPool::allocate(sizeof(T) * count);
+    }
+
+    template <typename T> static inline T * json_pool_realloc(T * ptr, size_t oldcount, size_t count) json_nothrow {
+	   return (T *)JSONPool::reallocate(ptr, sizeof(T) * oldcount, sizeof(T) * count);
+    }
+
+    template <typename T> static inline void json_pool_free(T * ptr, size_t count) json_nothrow {
+	   JSONPool::deallocate(ptr, sizeof(T) * count);
+    }
+#else
+    //without the pool these are just the usual ones, the counts are only needed to find a list
+    template <typename T> static inline T * json_pool_malloc(size_t count) json_nothrow {
+	   return json_malloc<T>(count);
+    }
+
+    template <typename T> static inline T * json_pool_realloc(T * ptr, size_t, size_t count) json_nothrow {
+	   return json_realloc<T>(ptr, count);
+    }
+
+    template <typename T> static inline void json_pool_free(T * ptr, size_t) json_nothrow {
+	   libjson_free<T>(ptr);
+    }
+#endif
+
 #ifdef JSON_MEMORY_MANAGE
     #include <map>
     class JSONNode;
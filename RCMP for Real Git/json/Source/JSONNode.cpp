@@ -13,12 +13,19 @@
     int JSONNode::getInternalDeallocationCount(void){ return internalDeallocCount; }
     int JSONNode::getChildrenAllocationCount(void){ return childrenAllocCount; }
     int JSONNode::getChildrenDeallocationCount(void){ return childrenDeallocCount; }
-    void JSONNode::incAllocCount(void){ ++allocCount; }
-    void JSONNode::decAllocCount(void){ ++deallocCount; }
-    void JSONNode::incinternalAllocCount(void){ ++internalAllocCount; }
-    void JSONNode::decinternalAllocCount(void){ ++internalDeallocCount; }
-    void JSONNode::incChildrenAllocCount(void){ ++childrenAllocCount; }
-    void JSONNode::decChildrenAllocCount(void){ ++childrenDeallocCount; }
+    #ifdef JSON_STATS  //the tests take the place of the stats' hooks, so they pass the counts on
+	   #define JSON_STATS_MADE(kind) JSONStats::made(JSONStats::kind)
+	   #define JSON_STATS_GONE(kind) JSONStats::gone(JSONStats::kind)
+    #else
+	   #define JSON_STATS_MADE(kind) (void)0
+	   #define JSON_STATS_GONE(kind) (void)0
+    #endif
+    void JSONNode::incAllocCount(void){ ++allocCount; JSON_STATS_MADE(STAT_NODES); }
+    void JSONNode::decAllocCount(void){ ++deallocCount; JSON_STATS_GONE(STAT_NODES); }
+    void JSONNode::incinternalAllocCount(void){ ++internalAllocCount; JSON_STATS_MADE(STAT_INTERNALS); }
+    void JSONNode::decinternalAllocCount(void){ ++internalDeallocCount; JSON_STATS_GONE(STAT_INTERNALS); }
+    void JSONNode::incChildrenAllocCount(void){ ++childrenAllocCount; JSON_STATS_MADE(STAT_CHILDREN); }
+    void JSONNode::decChildrenAllocCount(void){ ++childrenDeallocCount; JSON_STATS_GONE(STAT_CHILDREN); }
 #endif
 
 #define IMPLEMENT_CTOR(type)\
@@ -209,6 +216,29 @@ const JSONNode & JSONNode::at(const json_string & name_t) const json_throws(std:
     json_throw(std::out_of_range(EMPTY_STD_STRING));
 }
 
+#if defined(JSON_INTERNED_KEYS) && !defined(JSON_LIBRARY)
+    JSONNode & JSONNode::at(const json_key & key) json_throws(std::out_of_range) {
+	   JSON_CHECK_INTERNAL();
+	   JSON_ASSERT(type() == JSON_NODE, JSON_TEXT("at a non-iteratable node"));
+	   makeUniqueInternal();
+	   if (JSONNode ** res = internal -> at(key)){
+		  return *(*res);
+	   }
+	   JSON_FAIL(json_string(JSON_TEXT("at could not find child by key: ")) + key.str());
+	   json_throw(std::out_of_range(EMPTY_STD_STRING));
+    }
+
+    const JSONNode & JSONNode::at(const json_key & key) const json_throws(std::out_of_range) {
+	   JSON_CHECK_INTERNAL();
+	   JSON_ASSERT(type() == JSON_NODE, JSON_TEXT("at a non-iteratable node"));
+	   if (JSONNode ** res = internal -> at(key)){
+		  return *(*res);
+	   }
+	   JSON_FAIL(json_string(JSON_TEXT("at const could not find child by key: ")) + key.str());
+	   json_throw(std::out_of_range(EMPTY_STD_STRING));
+    }
+#endif
+
 #ifdef JSON_CASE_INSENSITIVE_FUNCTIONS
     JSONNode & JSONNode::at_nocase(const json_string & name_t) json_throws(std::out_of_range) {
 	   JSON_CHECK_INTERNAL();
@@ -136,6 +136,9 @@ public:
     DECLARE_FOR_ALL_TYPES(DECLARE_CTOR)
 
     JSONNode(const JSONNode & orig) json_nothrow json_hot;
+    #ifdef JSON_RVALUE_REFS
+	   JSONNode(JSONNode && orig) json_nothrow json_hot;
+    #endif
     ~JSONNode(void) json_nothrow json_hot;
 
     json_index_t size(void) const json_nothrow json_read_priority;
@@ -145,6 +148,9 @@ public:
 
     json_string name(void) const json_nothrow json_read_priority;
     void set_name(const json_string & newname) json_nothrow json_write_priority;
+    #if defined(JSON_INTERNED_KEYS) && !defined(JSON_LIBRARY)
+	   void set_name(const json_key & key) json_nothrow json_write_priority;
+    #endif
     #ifdef JSON_COMMENTS
 	   void set_comment(const json_string & comment) json_nothrow;
 	   json_string get_comment(void) const json_nothrow;
@@ -181,11 +187,26 @@ public:
     #endif
     JSONNode & operator[](const json_string & name_t) json_nothrow;
     const JSONNode & operator[](const json_string & name_t) const json_nothrow;
+    #if defined(JSON_INTERNED_KEYS) && !defined(JSON_LIBRARY)
+	   JSONNode & at(const json_key & key) json_throws(std::out_of_range);
+	   const JSONNode & at(const json_key & key) const json_throws(std::out_of_range);
+	   JSONNode & operator[](const json_key & key) json_nothrow;
+	   const JSONNode & operator[](const json_key & key) const json_nothrow;
+    #endif
 
     #ifdef JSON_LIBRARY
 	   void push_back(JSONNode * node) json_nothrow;
     #else
 	   void push_back(const JSONNode & node) json_nothrow;
+	   #ifdef JSON_RVALUE_REFS
+		  void push_back(JSONNode && node) json_nothrow;
+	   #endif
+	   template <typename T>
+	   void emplace_back(const json_string & name_t, const T & value_t) json_nothrow;
+	   #ifdef JSON_INTERNED_KEYS
+		  template <typename T>
+		  void emplace_back(const json_key & key, const T & value_t) json_nothrow;
+	   #endif
     #endif
     void reserve(json_index_t siz) json_nothrow;
     JSONNode JSON_PTR_LIB pop_back(json_index_t pos) json_throws(std::out_of_range);
@@ -196,6 +217,9 @@ public:
 
     DECLARE_FOR_ALL_TYPES(JSONNode & operator =)
     JSONNode & operator = (const JSONNode &) json_nothrow;
+    #ifdef JSON_RVALUE_REFS
+	   JSONNode & operator = (JSONNode &&) json_nothrow;
+    #endif
 
     DECLARE_FOR_ALL_TYPES_CONST(bool operator ==)
     DECLARE_FOR_ALL_TYPES_CONST(bool operator !=)
@@ -516,6 +540,7 @@ public:
     #ifdef JSON_WRITE_PRIORITY
 	   json_string write(void) const json_nothrow json_write_priority;
 	   json_string write_formatted(void) const json_nothrow json_write_priority;
+	   size_t estimated_write_size(void) const json_nothrow json_write_priority;  //at least as long as write() is, for allocating output once
     #endif
 
     #ifdef JSON_DEBUG
@@ -531,11 +556,13 @@ public:
 JSON_PRIVATE
     static JSONNode * newJSONNode(const JSONNode & orig     JSON_MUTEX_COPY_DECL2) json_hot;
     static JSONNode * newJSONNode(internalJSONNode * internal_t) json_hot;
-    #ifdef JSON_READ_PRIORITY
-	   //used by JSONWorker
-	   JSONNode(const json_string & unparsed) json_nothrow : internal(internalJSONNode::newInternal(unparsed)){ //root, specialized because it can only be array or node
-		  incAllocCount();
-	   }
+    #ifndef JSON_LIBRARY
+	   template <typename T>
+	   static JSONNode * newJSONNode_Emplace(const json_string & name_t, const T & value_t) json_hot;
+	   #ifdef JSON_INTERNED_KEYS
+		  template <typename T>
+		  static JSONNode * newJSONNode_Emplace(const json_key & key, const T & value_t) json_hot;
+	   #endif
     #endif
     JSONNode(internalJSONNode * internal_t) json_nothrow : internal(internal_t){ //do not increment anything, this is only used in one case and it's already taken care of
 	   incAllocCount();
@@ -567,11 +594,15 @@ JSON_PRIVATE
 	    JSON_CHECK_INTERNAL();
 	    makeUniqueInternal();
 	    internal -> clearname();
+	    #ifdef JSON_CHILDREN_INDEX
+		   jsonChildren::renamed();
+	    #endif
 	}
 
     mutable internalJSONNode * internal;
     friend class JSONWorker;
     friend class internalJSONNode;
+    friend class jsonChildren;
 };
 
 
@@ -608,6 +639,14 @@ inline JSONNode::JSONNode(bool, JSONNode & orig) json_nothrow : internal(orig.in
     incAllocCount();
 }
 
+#ifdef JSON_RVALUE_REFS
+    //steals orig's internal, orig is left empty and may only be destroyed or assigned to
+    inline JSONNode::JSONNode(JSONNode && orig) json_nothrow : internal(orig.internal){
+	   orig.internal = 0;
+	   incAllocCount();
+    }
+#endif
+
 inline JSONNode::~JSONNode(void) json_nothrow{
     if (internal != 0) decRef();
     decAllocCount();
@@ -645,8 +684,22 @@ inline void JSONNode::set_name(const json_string & newname) json_nothrow{
     JSON_CHECK_INTERNAL();
     makeUniqueInternal();
     internal -> setname(newname);
+    #ifdef JSON_CHILDREN_INDEX
+	   jsonChildren::renamed();
+    #endif
 }
 
+#if defined(JSON_INTERNED_KEYS) && !defined(JSON_LIBRARY)
+    inline void JSONNode::set_name(const json_key & key) json_nothrow{
+	   JSON_CHECK_INTERNAL();
+	   makeUniqueInternal();
+	   internal -> setkey(key);
+	   #ifdef JSON_CHILDREN_INDEX
+		  jsonChildren::renamed();
+	   #endif
+    }
+#endif
+
 #ifdef JSON_COMMENTS
     inline void JSONNode::set_comment(const json_string & newname) json_nothrow{
 	   JSON_CHECK_INTERNAL();
@@ -707,6 +760,19 @@ inline const JSONNode & JSONNode::operator[](const json_string & name_t) const j
     return *(*(internal -> at(name_t)));
 }
 
+#if defined(JSON_INTERNED_KEYS) && !defined(JSON_LIBRARY)
+    inline JSONNode & JSONNode::operator[](const json_key & key) json_nothrow {
+	   JSON_CHECK_INTERNAL();
+	   makeUniqueInternal();
+	   return *(*(internal -> at(key)));
+    }
+
+    inline const JSONNode & JSONNode::operator[](const json_key & key) const json_nothrow {
+	   JSON_CHECK_INTERNAL();
+	   return *(*(internal -> at(key)));
+    }
+#endif
+
 #ifdef JSON_LIBRARY
 inline void JSONNode::push_back(JSONNode * child) json_nothrow{
 #else
@@ -717,21 +783,64 @@ inline void JSONNode::push_back(const JSONNode & child) json_nothrow{
     internal -> push_back(child);
 }
 
+#ifndef JSON_LIBRARY
+    #ifdef JSON_RVALUE_REFS
+	   //hands child's internal straight to the new child, no copy and no reference bump
+	   inline void JSONNode::push_back(JSONNode && child) json_nothrow{
+		  JSON_CHECK_INTERNAL();
+		  makeUniqueInternal();
+		  internal -> push_back(json_move(child));
+	   }
+    #endif
+
+    //builds the child in place, same as push_back(JSONNode(name_t, value_t)) without the temporary
+    template <typename T>
+    inline void JSONNode::emplace_back(const json_string & name_t, const T & value_t) json_nothrow{
+	   JSON_CHECK_INTERNAL();
+	   makeUniqueInternal();
+	   internal -> emplace_back(name_t, value_t);
+    }
+
+    #ifdef JSON_INTERNED_KEYS
+	   template <typename T>
+	   inline void JSONNode::emplace_back(const json_key & key, const T & value_t) json_nothrow{
+		  JSON_CHECK_INTERNAL();
+		  makeUniqueInternal();
+		  internal -> emplace_back(key, value_t);
+	   }
+    #endif
+#endif
+
 inline void JSONNode::reserve(json_index_t siz) json_nothrow{
     makeUniqueInternal();
     internal -> reserve(siz);
 }
 
 inline JSONNode & JSONNode::operator = (const JSONNode & orig) json_nothrow {
-    JSON_CHECK_INTERNAL();
     #ifdef JSON_REF_COUNT
 	   if (internal == orig.internal) return *this;  //don't want it accidentally deleting itself
     #endif
-    decRef();  //dereference my current one
+    if (json_likely(internal != 0)) decRef();  //dereference my current one, a moved from node doesn't have one
     internal = orig.internal -> incRef();  //increase reference of original
+    #ifdef JSON_CHILDREN_INDEX
+	   jsonChildren::renamed();  //orig's name came with it
+    #endif
     return *this;
 }
 
+#ifdef JSON_RVALUE_REFS
+    inline JSONNode & JSONNode::operator = (JSONNode && orig) json_nothrow {
+	   //swap, orig releases whatever I was holding when it goes away
+	   internalJSONNode * temp = orig.internal;
+	   orig.internal = internal;
+	   internal = temp;
+	   #ifdef JSON_CHILDREN_INDEX
+		  jsonChildren::renamed();
+	   #endif
+	   return *this;
+    }
+#endif
+
 #ifndef JSON_LIBRARY
     inline JSONNode & JSONNode::operator = (const json_char * val) json_nothrow {
 	   JSON_CHECK_INTERNAL();
@@ -812,6 +921,9 @@ inline void JSONNode::swap(JSONNode & other) json_nothrow {
     internalJSONNode * temp = other.internal;
     other.internal = internal;
     internal = temp;
+    #ifdef JSON_CHILDREN_INDEX
+	   jsonChildren::renamed();
+    #endif
     JSON_CHECK_INTERNAL();
 }
 
@@ -926,13 +1038,24 @@ inline void JSONNode::decRef(void) json_nothrow { //decrements internal's counte
     inline json_string JSONNode::write(void) const json_nothrow {
 	   JSON_CHECK_INTERNAL();
 	   JSON_ASSERT_SAFE(type() == JSON_NODE || type() == JSON_ARRAY, JSON_TEXT("Writing a non-writable node"), return EMPTY_JSON_STRING;);
-	   return internal -> Write(0xFFFFFFFF, true);
+	   json_string result;
+	   result.reserve(internal -> EstimatedWriteSize(0xFFFFFFFF, true));
+	   internal -> Write(0xFFFFFFFF, true, result);
+	   return result;
     }
 
     inline json_string JSONNode::write_formatted(void) const json_nothrow {
 	   JSON_CHECK_INTERNAL();
 	   JSON_ASSERT_SAFE(type() == JSON_NODE || type() == JSON_ARRAY, JSON_TEXT("Writing a non-writable node"), return EMPTY_JSON_STRING;);
-	   return internal -> Write(0, true);
+	   json_string result;
+	   result.reserve(internal -> EstimatedWriteSize(0, true));
+	   internal -> Write(0, true, result);
+	   return result;
+    }
+
+    inline size_t JSONNode::estimated_write_size(void) const json_nothrow {
+	   JSON_CHECK_INTERNAL();
+	   return internal -> EstimatedWriteSize(0xFFFFFFFF, true);
     }
 
 #endif
@@ -971,17 +1094,17 @@ inline void JSONNode::decRef(void) json_nothrow { //decrements internal's counte
 
 
 inline void JSONNode::deleteJSONNode(JSONNode * ptr) json_nothrow {
-    #ifdef JSON_MEMORY_CALLBACKS
+    #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
 	   ptr -> ~JSONNode();
-	   libjson_free<JSONNode>(ptr);
+	   json_pool_free<JSONNode>(ptr, 1);
     #else
 	   delete ptr;
     #endif
 }
 
 inline JSONNode * _newJSONNode(const JSONNode & orig) {
-    #ifdef JSON_MEMORY_CALLBACKS
-	   return new(json_malloc<JSONNode>(1)) JSONNode(orig);
+    #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
+	   return new(json_pool_malloc<JSONNode>(1)) JSONNode(orig);
     #else
 	   return new JSONNode(orig);
     #endif
@@ -999,21 +1122,64 @@ inline JSONNode * JSONNode::newJSONNode(const JSONNode & orig    JSON_MUTEX_COPY
 }
 
 inline JSONNode * JSONNode::newJSONNode(internalJSONNode * internal_t) {
-    #ifdef JSON_MEMORY_CALLBACKS
-	   return new(json_malloc<JSONNode>(1)) JSONNode(internal_t);
+    #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
+	   return new(json_pool_malloc<JSONNode>(1)) JSONNode(internal_t);
     #else
 	   return new JSONNode(internal_t);
     #endif
 }
 
 inline JSONNode * JSONNode::newJSONNode_Shallow(const JSONNode & orig) {
-    #ifdef JSON_MEMORY_CALLBACKS
-	   return new(json_malloc<JSONNode>(1)) JSONNode(true, const_cast<JSONNode &>(orig));
+    #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
+	   return new(json_pool_malloc<JSONNode>(1)) JSONNode(true, const_cast<JSONNode &>(orig));
     #else
 	   return new JSONNode(true, const_cast<JSONNode &>(orig));
     #endif
 }
 
+#ifndef JSON_LIBRARY
+    template <typename T>
+    inline JSONNode * JSONNode::newJSONNode_Emplace(const json_string & name_t, const T & value_t) {
+	   #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
+		  return new(json_pool_malloc<JSONNode>(1)) JSONNode(name_t, value_t);
+	   #else
+		  return new JSONNode(name_t, value_t);
+	   #endif
+    }
+
+    #ifdef JSON_INTERNED_KEYS
+	   template <typename T>
+	   inline JSONNode * JSONNode::newJSONNode_Emplace(const json_key & key, const T & value_t) {
+		  JSONNode * res = newJSONNode_Emplace(EMPTY_JSON_STRING, value_t);
+		  res -> internal -> setkey(key);
+		  return res;
+	   }
+    #endif
+
+    /*
+	   These belong to jsonChildren and internalJSONNode, but they need a complete JSONNode
+    */
+    #ifdef JSON_RVALUE_REFS
+	   inline void jsonChildren::push_back(JSONNode && item) json_nothrow {
+		  push_back(JSONNode::newJSONNode_Shallow(item));
+	   }
+    #endif
+
+    template <typename N, typename T>
+    inline void jsonChildren::emplace_back(const N & name_t, const T & value_t) json_nothrow {
+	   push_back(JSONNode::newJSONNode_Emplace(name_t, value_t));
+    }
+
+    template <typename N, typename T>
+    inline void internalJSONNode::emplace_back(const N & name_t, const T & value_t) json_nothrow {
+	   JSON_ASSERT_SAFE(isContainer(), JSON_TEXT("calling emplace_back on non-container type"), return;);
+	   CHILDREN -> emplace_back(name_t, value_t);
+	   #ifdef JSON_MUTEX_CALLBACKS
+		  if (mylock != 0) (*CHILDREN)[CHILDREN -> size() - 1] -> set_mutex(mylock);
+	   #endif
+    }
+#endif
+
 
 #ifdef JSON_LESS_MEMORY
     #ifdef __GNUC__
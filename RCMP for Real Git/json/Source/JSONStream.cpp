@@ -4,90 +4,98 @@
 #include "JSONWorker.h"
 
 
-JSONStream::JSONStream(json_stream_callback_t call_p) json_nothrow : call(call_p), buffer() {}
+JSONStream::JSONStream(json_stream_callback_t call_p) json_nothrow : buffer(), indexer(), consumed(0), scanned(0), depth(0), opened(0), call(call_p) {}
 
-JSONStream::JSONStream(const JSONStream & orig) json_nothrow : call(orig.call), buffer(orig.buffer){}
+JSONStream::JSONStream(const JSONStream & orig) json_nothrow : buffer(orig.buffer, orig.consumed, json_string::npos), indexer(), consumed(0), scanned(0), depth(0), opened(0), call(orig.call) {
+    rescan();
+}
 
 JSONStream & JSONStream::operator =(const JSONStream & orig) json_nothrow {
-    call = orig.call;
-    buffer = orig.buffer;
+    if (this != &orig){
+	   call = orig.call;
+	   buffer.assign(orig.buffer, orig.consumed, json_string::npos);
+	   rescan();
+    }
     return *this;
 }
 
+//the indexer can't be copied, so a copy indexes what hasn't been read yet over again
+void JSONStream::rescan(void) json_nothrow {
+    indexer.clear();
+    indexer.index(buffer.data(), buffer.length());
+    indexer.flush();
+    consumed = scanned = depth = opened = 0;
+}
+
 #ifdef JSON_LIBRARY
     JSONStream & JSONStream::operator << (const json_char * str) json_nothrow {
 #else
     JSONStream & JSONStream::operator << (const json_string & str) json_nothrow {
 #endif
+    const size_t before = buffer.length();
     buffer += str;
+    //only the new text is indexed, the strings and escapes it's in the middle of are carried over
+    indexer.index(buffer.data() + before, buffer.length() - before);
+    indexer.flush();
     parse();
     return *this;
 }
 
-
-#define QUOTECASE_STREAM()\
-    case JSON_TEXT('\"'):\
-	   while (*(++p) != JSON_TEXT('\"')){\
-		  if (json_unlikely(*p == JSON_TEXT('\0'))) return json_string::npos;\
-	   }\
-	   break;
-
-
-#define NULLCASE_STREAM()\
-    case JSON_TEXT('\0'):\
-	   return json_string::npos;\
-
-
-#define BRACKET_STREAM(left, right)\
-    case left: {\
-	   size_t brac = 1;\
-	   while (brac){\
-		  switch (*(++p)){\
-			 case right:\
-				--brac;\
-				break;\
-			 case left:\
-				++brac;\
-				break;\
-			 QUOTECASE_STREAM()\
-			 NULLCASE_STREAM()\
-		  }\
-	   }\
-	   break;}\
-    case right:\
-	   return json_string::npos;
-
-size_t JSONStream::FindNextRelevant(json_char ch, const json_string & value_t, const size_t pos) json_nothrow {
-    const json_char * start = value_t.c_str();
-    for (const json_char * p = start + pos; *p; ++p){
-	   if (json_unlikely(*p == ch)) return p - start;
-	   switch (*p){
-			 BRACKET_STREAM(JSON_TEXT('['), JSON_TEXT(']'))
-			 BRACKET_STREAM(JSON_TEXT('{'), JSON_TEXT('}'))
-			 QUOTECASE_STREAM()
-	   }
-    };
-    return json_string::npos;
-}
-
+/*
+    Picks up where the last call left off, only the entries for the new text are looked
+    at.  Between documents, anything that isn't an opening bracket is skipped.  Each
+    document is read where it sits in the buffer, with a null written over the character
+    after it for the length of the read.  Read text is erased in one go once it is more
+    than half of the buffer, so the cost of moving what's left is spread over it.
+*/
 void JSONStream::parse(void) json_nothrow {
-    size_t pos = buffer.find_first_of(JSON_TEXT("{["));
-    if (json_likely(pos != json_string::npos)){
-	   size_t end = (buffer[pos] == JSON_TEXT('[')) ? FindNextRelevant(JSON_TEXT(']'), buffer, pos + 1) : FindNextRelevant(JSON_TEXT('}'), buffer, pos + 1);
-	   if (end != json_string::npos){
-		  START_MEM_SCOPE
-			 JSONNode temp(JSONWorker::parse(buffer.substr(pos, end - pos + 1)));
-			 #ifndef JSON_LIBRARY
-				call(temp);
-			 #else
-				call(&temp);
-			 #endif
-		  END_MEM_SCOPE
-		  json_string::iterator beginning = buffer.begin();
-		  buffer.erase(beginning, beginning + end);
-		  parse();
+    if (buffer.empty()) return;
+    json_char * text = &buffer[0];
+    const uint32_t * entries = indexer.begin();
+    const size_t count = indexer.size();
+    for(; scanned < count; ++scanned){
+	   switch(text[entries[scanned]]){
+		  case JSON_TEXT('{'):
+		  case JSON_TEXT('['):
+			 if (depth++ == 0) opened = scanned;
+			 break;
+		  case JSON_TEXT('}'):
+		  case JSON_TEXT(']'):
+			 if ((depth == 0) || (--depth != 0)) break;
+			 {
+				const size_t closed = entries[scanned] + 1;
+				json_reader in = { text + entries[opened], text, 0, 0, 0 };
+				//a comment could throw off which quotes start strings, and a control character means the strings need a closer look
+				if (json_likely(!indexer.sawComment() && !indexer.sawControl())){
+				    in.next = entries + opened;
+				    in.last = entries + scanned + 1;
+				}
+				const json_char after = text[closed];
+				text[closed] = JSON_TEXT('\0');
+				START_MEM_SCOPE
+				    JSONNode temp(JSONWorker::_parse(in));
+				    text[closed] = after;
+				    #ifndef JSON_LIBRARY
+					   call(temp);
+				    #else
+					   call(&temp);
+				    #endif
+				END_MEM_SCOPE
+				consumed = closed;
+			 }
+			 break;
 	   }
     }
+
+    if (depth == 0) consumed = buffer.length();  //there's nothing left but what's between documents
+    const size_t keep = (depth == 0) ? consumed : entries[opened];
+    if (keep > buffer.length() - keep){
+	   const size_t dropped = indexer.discard(keep);
+	   scanned -= dropped;
+	   if (depth) opened -= dropped;
+	   buffer.erase(0, keep);
+	   consumed = 0;
+    }
 }
 
 #endif
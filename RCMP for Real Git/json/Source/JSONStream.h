@@ -5,6 +5,8 @@
 
 #ifdef JSON_STREAM
 
+#include "JSONIndexer.h"
+
 #ifdef JSON_MEMORY_CALLBACKS
     #include "JSONMemory.h"
 #endif
@@ -42,9 +44,14 @@ public:
 	   #endif
     }
 JSON_PRIVATE
-    size_t FindNextRelevant(json_char ch, const json_string & value_t, const size_t pos) json_nothrow;
     void parse(void) json_nothrow;
+    void rescan(void) json_nothrow;
     json_string buffer;
+    JSONIndexer indexer;  //has seen all of buffer
+    size_t consumed;  //the front of buffer that's been read, it's only erased once it's most of it
+    size_t scanned;  //how many of the indexer's entries have been looked at
+    size_t depth;  //how many brackets are open after them
+    size_t opened;  //the entry of the outermost one
     json_stream_callback_t call;
 };
 
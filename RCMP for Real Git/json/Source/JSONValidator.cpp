@@ -1,6 +1,12 @@
 #include "JSONValidator.h"
+#include "NumberToString.h"
 
 #ifdef JSON_VALIDATE
+#include "JSONIndexer.h"
+#include "JSONWorker.h"
+#include "JSONMemory.h"
+#include <cstring>
+#include <algorithm>
 
 inline bool isHex(json_char c) json_pure;
 inline bool isHex(json_char c) json_nothrow {
@@ -12,179 +18,8 @@ inline bool isHex(json_char c) json_nothrow {
 bool JSONValidator::isValidNumber(const json_char * & ptr) json_nothrow {
     //ptr points at the first character in the number
     //ptr will end up past the last character
-    bool decimal = false;
-    bool scientific = false;
-
-    //first letter is weird
-    switch(*ptr){
-	   #ifndef JSON_STRICT
-		  case JSON_TEXT('.'):
-			 decimal = true;
-			 break;
-		  case JSON_TEXT('+'):
-	   #endif
-	   case JSON_TEXT('-'):
-	   case JSON_TEXT('1'):
-	   case JSON_TEXT('2'):
-	   case JSON_TEXT('3'):
-	   case JSON_TEXT('4'):
-	   case JSON_TEXT('5'):
-	   case JSON_TEXT('6'):
-	   case JSON_TEXT('7'):
-	   case JSON_TEXT('8'):
-	   case JSON_TEXT('9'):
-		  break;
-	   case JSON_TEXT('0'):
-		  ++ptr;
-		  switch(*ptr){
-			 case JSON_TEXT('.'):
-				decimal = true;
-				break;
-			 case JSON_TEXT('e'):
-			 case JSON_TEXT('E'):
-				scientific = true;
-				++ptr;
-				switch(*ptr){
-				    case JSON_TEXT('\0'):
-					   return false;
-				    case JSON_TEXT('-'):
-				    case JSON_TEXT('+'):
-				    case JSON_TEXT('0'):
-				    case JSON_TEXT('1'):
-				    case JSON_TEXT('2'):
-				    case JSON_TEXT('3'):
-				    case JSON_TEXT('4'):
-				    case JSON_TEXT('5'):
-				    case JSON_TEXT('6'):
-				    case JSON_TEXT('7'):
-				    case JSON_TEXT('8'):
-				    case JSON_TEXT('9'):
-					   break;
-				    default:
-					   return false;
-				}
-				break;
-			 #ifndef JSON_STRICT
-				case JSON_TEXT('x'):
-				    while(isHex(*++ptr)){};
-				    return true;
-				#ifdef JSON_OCTAL
-				    #ifdef __GNUC__
-				    case JSON_TEXT('0') ... JSON_TEXT('7'):  //octal
-				    #else
-				    case JSON_TEXT('0'):
-				    case JSON_TEXT('1'):
-				    case JSON_TEXT('2'):
-				    case JSON_TEXT('3'):
-				    case JSON_TEXT('4'):
-				    case JSON_TEXT('5'):
-				    case JSON_TEXT('6'):
-				    case JSON_TEXT('7'):
-				    #endif
-					   while((*++ptr >= JSON_TEXT('0')) && (*ptr <= JSON_TEXT('7'))){};
-					   return ((*ptr != JSON_TEXT('8')) && (*ptr != JSON_TEXT('9')));
-				    case JSON_TEXT('8'):
-				    case JSON_TEXT('9'):
-					   break;
-				#else
-				    #ifdef __GNUC__
-					   case JSON_TEXT('0') ... JSON_TEXT('9'):
-				    #else
-					   case JSON_TEXT('0'):
-					   case JSON_TEXT('1'):
-					   case JSON_TEXT('2'):
-					   case JSON_TEXT('3'):
-					   case JSON_TEXT('4'):
-					   case JSON_TEXT('5'):
-					   case JSON_TEXT('6'):
-					   case JSON_TEXT('7'):
-					   case JSON_TEXT('8'):
-					   case JSON_TEXT('9'):
-				    #endif
-				    break;
-				#endif
-			 #else
-				#ifdef __GNUC__
-				    case JSON_TEXT('0') ... JSON_TEXT('9'):
-				#else
-				    case JSON_TEXT('0'):
-				    case JSON_TEXT('1'):
-				    case JSON_TEXT('2'):
-				    case JSON_TEXT('3'):
-				    case JSON_TEXT('4'):
-				    case JSON_TEXT('5'):
-				    case JSON_TEXT('6'):
-				    case JSON_TEXT('7'):
-				    case JSON_TEXT('8'):
-				    case JSON_TEXT('9'):
-				#endif
-				    break;
-			 #endif
-			 default:  //just a 0
-				return true;
-		  }
-		  break;
-	   default:
-		  return false;
-    }
-    ++ptr;
-
-    //next digits
-    while (true){
-	   switch(*ptr){
-		  case JSON_TEXT('.'):
-			 if (json_unlikely(decimal)) return false; //multiple decimals
-			 if (json_unlikely(scientific)) return false;
-			 decimal = true;
-			 break;
-		  case JSON_TEXT('e'):
-		  case JSON_TEXT('E'):
-			 if (json_likely(scientific)) return false;
-			 scientific = true;
-			 ++ptr;
-			 switch(*ptr){
-				case JSON_TEXT('-'):
-				case JSON_TEXT('+'):
-				#ifdef __GNUC__
-				    case JSON_TEXT('0') ... JSON_TEXT('9'):
-				#else
-				    case JSON_TEXT('0'):
-				    case JSON_TEXT('1'):
-				    case JSON_TEXT('2'):
-				    case JSON_TEXT('3'):
-				    case JSON_TEXT('4'):
-				    case JSON_TEXT('5'):
-				    case JSON_TEXT('6'):
-				    case JSON_TEXT('7'):
-				    case JSON_TEXT('8'):
-				    case JSON_TEXT('9'):
-				#endif
-				    break;
-				default:
-				    return false;
-			 }
-			 break;
-		  #ifdef __GNUC__
-			 case JSON_TEXT('0') ... JSON_TEXT('9'):
-		  #else
-			 case JSON_TEXT('0'):
-			 case JSON_TEXT('1'):
-			 case JSON_TEXT('2'):
-			 case JSON_TEXT('3'):
-			 case JSON_TEXT('4'):
-			 case JSON_TEXT('5'):
-			 case JSON_TEXT('6'):
-			 case JSON_TEXT('7'):
-			 case JSON_TEXT('8'):
-			 case JSON_TEXT('9'):
-		  #endif
-			 break;
-		  default:
-			 return true;
-	   }
-	   ++ptr;
-    }
-    return false;
+    json_number value;
+    return NumberToString::_parse(ptr, value);
 }
 
 #ifndef JSON_STRICT
@@ -300,6 +135,8 @@ bool JSONValidator::isValidString(const json_char * & ptr) json_nothrow {
 }
 
 bool JSONValidator::isValidNamedObject(const json_char * &ptr) json_nothrow {
+    //ptr is on the quote that starts the name
+    if (json_unlikely(*ptr != JSON_TEXT('\"'))) return false;
     if (json_unlikely(!isValidString(++ptr))) return false;
     if (json_unlikely(*ptr++ != ':')) return false;
     if (json_unlikely(!isValidMember(ptr))) return false;
@@ -373,4 +210,120 @@ bool JSONValidator::isValidRoot(const json_char * json) json_nothrow {
     return false;
 }
 
+static inline const json_char * skipWhiteSpace(const json_char * ptr, const json_char * end) json_nothrow {
+    for(; ptr != end; ++ptr){
+	   switch(*ptr){
+		  case JSON_TEXT(' '):   //defined as white space
+		  case JSON_TEXT('\t'):  //defined as white space
+		  case JSON_TEXT('\n'):  //defined as white space
+		  case JSON_TEXT('\r'):  //defined as white space
+			 break;
+		  default:
+			 return ptr;
+	   }
+    }
+    return ptr;
+}
+
+//the characters between two quotes that the indexer found, start is on the first one
+static bool isValidQuoted(const json_char * start, const json_char * close, bool control) json_nothrow {
+    const json_char * ptr = start + 1;
+    if (json_unlikely(control)){
+	   for(const json_char * runner = ptr; runner != close; ++runner){
+		  if (json_unlikely((json_uchar)*runner < 32)) return false;
+	   }
+    }
+    #ifndef JSON_UNICODE
+	   if (json_likely(std::memchr(ptr, '\\', close - ptr) == 0)) return true;  //most have no escapes to check
+    #else
+	   if (json_likely(std::find(ptr, close, JSON_TEXT('\\')) == close)) return true;
+    #endif
+    return JSONValidator::isValidString(ptr) && (ptr == close + 1);
+}
+
+/*
+    The whole document is indexed first, which does the work that has to look at every
+    character a block at a time: finding where the strings are, and checking that it's
+    UTF-8 and has no control characters in its strings.  What's left only visits what
+    the indexer found, that the brackets, colons and commas come in an order that makes
+    sense, and that what's between two of them is nothing but one number or literal.
+    Comments throw the index off, so anything with one is checked the old way
+*/
+bool JSONValidator::isValidDocument(const json_char * json, size_t length) json_nothrow {
+    if (json_unlikely(length > 0xFFFFFFFFu)) return isValidRoot(JSONWorker::RemoveWhiteSpaceAndComments(json_string(json, length)).c_str());
+    JSONIndexer indexer(true);
+    indexer.index(json, length);
+    indexer.flush();
+    if (json_unlikely(!indexer.validUtf8())) return false;
+    #ifndef JSON_STRICT
+	   if (json_unlikely(indexer.sawComment())) return isValidRoot(JSONWorker::RemoveWhiteSpaceAndComments(json_string(json, length)).c_str());
+    #endif
+    if (json_unlikely(indexer.inString())) return false;
+
+    enum { VALUE, FIRST_VALUE, NAME, FIRST_NAME, COLON, NEXT } state = VALUE;
+    json_char * open = json_malloc<json_char>(indexer.size() + 1);  //the brackets that haven't been closed yet
+    size_t depth = 0;
+    const json_char * ptr = json;  //the first character not yet checked
+    bool valid = false;
+    for(const uint32_t * runner = indexer.begin(); runner != indexer.end(); ++runner){
+	   const json_char * at = json + *runner;
+	   ptr = skipWhiteSpace(ptr, at);
+	   if (depth == 0){  //the root, nothing can come after it
+		  if (json_unlikely(valid || (ptr != at) || ((*at != JSON_TEXT('{')) && (*at != JSON_TEXT('['))))){
+			 valid = false;
+			 goto done;
+		  }
+	   } else if (ptr != at){  //a number or a literal
+		  if (json_unlikely((state != VALUE) && (state != FIRST_VALUE))) goto done;
+		  if (json_unlikely(!isValidMember(ptr))) goto done;
+		  if (json_unlikely(skipWhiteSpace(ptr, at) != at)) goto done;
+		  state = NEXT;
+	   }
+
+	   switch(*at){
+		  case JSON_TEXT('{'):
+		  case JSON_TEXT('['):
+			 if (json_unlikely((state != VALUE) && (state != FIRST_VALUE))) goto done;
+			 open[depth++] = *at;
+			 state = (*at == JSON_TEXT('{')) ? FIRST_NAME : FIRST_VALUE;
+			 break;
+		  case JSON_TEXT('\"'): {
+			 if (json_unlikely((state == COLON) || (state == NEXT))) goto done;
+			 const json_char * close = json + *++runner;  //the index ends outside of a string, so quotes come in pairs
+			 if (json_unlikely(!isValidQuoted(at, close, indexer.sawControl()))) goto done;
+			 state = ((state == NAME) || (state == FIRST_NAME)) ? COLON : NEXT;
+			 at = close;
+			 break;
+		  }
+		  case JSON_TEXT(':'):
+			 if (json_unlikely(state != COLON)) goto done;
+			 state = VALUE;
+			 break;
+		  case JSON_TEXT(','):
+			 #ifndef JSON_STRICT
+				if (json_unlikely((state != NEXT) && (state != VALUE) && (state != FIRST_VALUE))) goto done;  //null in libjson
+			 #else
+				if (json_unlikely(state != NEXT)) goto done;
+			 #endif
+			 state = (open[depth - 1] == JSON_TEXT('{')) ? NAME : VALUE;
+			 break;
+		  default:  //} or ]
+			 if (json_unlikely(open[depth - 1] != ((*at == JSON_TEXT('}')) ? JSON_TEXT('{') : JSON_TEXT('[')))) goto done;
+			 #ifndef JSON_STRICT
+				if (json_unlikely((state == NAME) || (state == COLON))) goto done;  //an empty value is null in libjson
+			 #else
+				if (json_unlikely((state != NEXT) && (state != FIRST_NAME) && (state != FIRST_VALUE))) goto done;
+			 #endif
+			 state = NEXT;
+			 if (--depth == 0) valid = true;
+			 break;
+	   }
+	   ptr = at + 1;
+    }
+    valid = valid && (skipWhiteSpace(ptr, json + length) == json + length);
+done:
+    libjson_free<json_char>(open);
+    return valid;
+}
+
 #endif
@@ -14,6 +14,8 @@ class JSONValidator {
 	   static bool isValidObject(const json_char * & ptr) json_nothrow json_read_priority;
 	   static bool isValidArray(const json_char * & ptr) json_nothrow json_read_priority;
 	   static bool isValidRoot(const json_char * json) json_nothrow json_read_priority;
+	   //a whole document as it was written, white space and all
+	   static bool isValidDocument(const json_char * json, size_t length) json_nothrow json_read_priority;
 };
 
 #endif
@@ -1,231 +1,328 @@
 #include "JSONWorker.h"
+#include "JSONIndexer.h"
+#include "JSONDocument.h"
+#include "NumberToString.h"  //numbers are read where they sit
+#include <cstring>
+#ifdef JSON_UNICODE
+    #include <cwchar>
+#endif
 
 #ifdef JSON_READ_PRIORITY
 
+#define JSON_INDEX_MINIMUM 512  //below this many characters, indexing costs more than it saves
+
 JSONNode JSONWorker::parse(const json_string & json) json_throws(std::invalid_argument) {
-    json_auto<json_char> s;
-    #if defined JSON_DEBUG || defined JSON_SAFE
-	   json_char lastchar;
-	   s.set(RemoveWhiteSpace(json, lastchar));
-	   return _parse_unformatted(s.ptr, lastchar);
-    #else
-	   s.set(RemoveWhiteSpace(json));
-	   return _parse_unformatted(s.ptr);
-    #endif
+    return _parse(json.c_str(), json.length());
 }
 
+//white space doesn't cost anything extra any more, so this is the same as parse
 JSONNode JSONWorker::parse_unformatted(const json_string & json) json_throws(std::invalid_argument) {
-    #if defined JSON_DEBUG || defined JSON_SAFE
-	   #ifndef JSON_NO_EXCEPTIONS
-		  JSON_ASSERT_SAFE((json[0] == '{') || (json[0] == '['), JSON_TEXT("Not JSON!"), throw std::invalid_argument(EMPTY_STD_STRING););
-	   #else
-		  JSON_ASSERT_SAFE((json[0] == '{') || (json[0] == '['), JSON_TEXT("Not JSON!"), return JSONNode(JSON_NULL););
-	   #endif
-	   json_char temp = (json[0] == '{') ? '}' : ']';
-	   return _parse_unformatted(json.c_str(), temp);
-    #else
-	   return _parse_unformatted(json.c_str());
-    #endif
+    return _parse(json.c_str(), json.length());
 }
 
-#if defined JSON_DEBUG || defined JSON_SAFE
-JSONNode JSONWorker::_parse_unformatted(const json_char * json, json_char & lastchar) json_throws(std::invalid_argument) {
+/*
+    Reading is done in one pass over the caller's text, nothing is copied to strip
+    white space and nothing is scanned twice.  Each value is read where it sits,
+    and only what a node has to keep is copied out of it.  Strings with escapes in
+    them are kept as they were written and unescaped the first time they are used.
+    Big documents are run through the JSONIndexer first, so that the end of each
+    string is already known instead of being looked for one character at a time
+*/
+#ifdef JSON_COMMENTS
+    #define SKIP_WHITE_SPACE(p) SkipWhiteSpace(p, comment)
+    #define KEEP_COMMENT(from, to)\
+	   if (!comment.empty()) comment += JSON_TEXT('\n');  /*multiple comments will be consolidated into one*/\
+	   comment.append(from, to - from)
+    static inline void SkipWhiteSpace(const json_char * & p, json_string & comment) json_nothrow {
 #else
-JSONNode JSONWorker::_parse_unformatted(const json_char * json) json_throws(std::invalid_argument) {
+    #define SKIP_WHITE_SPACE(p) SkipWhiteSpace(p)
+    #define KEEP_COMMENT(from, to) ((void)(from), (void)(to))  //nowhere to keep them, but start is still set
+    static inline void SkipWhiteSpace(const json_char * & p) json_nothrow {
 #endif
-    #ifdef JSON_COMMENTS
-	   json_char firstchar = *json;
-	   json_string _comment;
-	   json_char * runner = (json_char*)json;
-	   if (json_unlikely(firstchar == '\5')){  //multiple comments will be consolidated into one
-		  newcomment:
-		  while(*(++runner) != '\5'){
-			 JSON_ASSERT(*runner, JSON_TEXT("Removing white space failed"));
-			 _comment += *runner;
-		  }
-		  firstchar = *(++runner); //step past the trailing tag
-		  if (json_unlikely(firstchar == '\5')){
-			 _comment += '\n';
-			 goto newcomment;
-		  }
-	   }
-    #else
-	   const json_char firstchar = *json;
-    #endif
-
-    switch (firstchar){
-        case '{':
-        case '[':
-		  #if defined JSON_DEBUG || defined JSON_SAFE
-			 if (firstchar == '['){
-				if (json_unlikely(lastchar != ']')){
-				    JSON_FAIL(JSON_TEXT("Missing final ]"));
-				    break;
-				}
-			 } else {
-				if (json_unlikely(lastchar != '}')){
-				    JSON_FAIL(JSON_TEXT("Missing final }"));
+    for(;; ++p){
+	   switch(*p){
+		  case JSON_TEXT(' '):   //defined as white space
+		  case JSON_TEXT('\t'):  //defined as white space
+		  case JSON_TEXT('\n'):  //defined as white space
+		  case JSON_TEXT('\r'):  //defined as white space
+			 break;
+		  #ifndef JSON_STRICT
+			 case JSON_TEXT('/'):  //a C comment
+				if (*(p + 1) == JSON_TEXT('*')){  //a multiline comment
+				    const json_char * start = (p += 2);
+				    while ((*p != JSON_TEXT('*')) || (*(p + 1) != JSON_TEXT('/'))){
+					   if (json_unlikely(*p == JSON_TEXT('\0'))) return;  //unterminated, whoever is reading will see the end
+					   ++p;
+				    }
+				    KEEP_COMMENT(start, p);
+				    ++p;
 				    break;
 				}
+				if (json_unlikely(*(p + 1) != JSON_TEXT('/'))) return;  //stray / character, not quoted, or a comment
+				++p;
+				//Should be a single line C comment, so let it fall through to use the bash comment stripper
+			 case JSON_TEXT('#'): {  //a bash comment
+				const json_char * start = p + 1;
+				while((*(p + 1)) && (*(p + 1) != JSON_TEXT('\n'))) ++p;
+				KEEP_COMMENT(start, p + 1);
+				break;
 			 }
 		  #endif
-		  #ifdef JSON_COMMENTS
-			 JSONNode foo(runner);
-			 foo.set_comment(_comment);
-			 return JSONNode(true, foo);  //forces it to simply return the original interal, even with ref counting off
-		  #else
-			 return JSONNode(json);
-		  #endif
+		  default:
+			 return;
+	   }
     }
+}
 
-    JSON_FAIL(JSON_TEXT("Not JSON!"));
-    #ifndef JSON_NO_EXCEPTIONS
-	   throw std::invalid_argument(EMPTY_STD_STRING);
-    #else
-	   return JSONNode(JSON_NULL);
-    #endif
+static inline bool isHex(json_char c) json_pure;
+static inline bool isHex(json_char c) json_nothrow {
+    return (((c >= JSON_TEXT('0')) && (c <= JSON_TEXT('9'))) ||
+		  ((c >= JSON_TEXT('A')) && (c <= JSON_TEXT('F'))) ||
+		  ((c >= JSON_TEXT('a')) && (c <= JSON_TEXT('f'))));
 }
+
+#ifndef JSON_STRICT
+    static inline bool isOctal(json_char c) json_pure;
+    static inline bool isOctal(json_char c) json_nothrow {
+	   return (c >= JSON_TEXT('0')) && (c <= JSON_TEXT('7'));
+    }
 #endif
 
-#define QUOTECASE()\
-    case JSON_TEXT('\"'):\
-	   while (*(++p) != JSON_TEXT('\"')){\
-		  JSON_ASSERT_SAFE(*p, JSON_TEXT("Null terminator inside of a quotation"), return json_string::npos;);\
-	   }\
-	   break;
-
-#if defined(JSON_DEBUG) || defined(JSON_SAFE)
-    #define NULLCASE(error)\
-	   case JSON_TEXT('\0'):\
-		  JSON_FAIL_SAFE(error, return json_string::npos;);\
+//the unescaping reads the digits of \u, \x and octal escapes without looking, so make sure they're there
+static inline bool ReadEscape(const json_char * & p) json_nothrow {
+    switch(*(++p)){
+	   case JSON_TEXT('u'):
+		  for(int i = 0; i < 4; ++i){
+			 if (json_unlikely(!isHex(*(++p)))){
+				JSON_FAIL(JSON_TEXT("Invalid \\u escape"));
+				return false;
+			 }
+		  }
 		  break;
-#else
-    #define NULLCASE(error)
-#endif
+	   #ifndef JSON_STRICT
+		  case JSON_TEXT('x'):
+			 for(int i = 0; i < 2; ++i){
+				if (json_unlikely(!isHex(*(++p)))){
+				    JSON_FAIL(JSON_TEXT("Invalid \\x escape"));
+				    return false;
+				}
+			 }
+			 break;
+		  #ifdef __GNUC__
+			 case JSON_TEXT('0') ... JSON_TEXT('7'):
+		  #else
+			 case JSON_TEXT('0'):
+			 case JSON_TEXT('1'):
+			 case JSON_TEXT('2'):
+			 case JSON_TEXT('3'):
+			 case JSON_TEXT('4'):
+			 case JSON_TEXT('5'):
+			 case JSON_TEXT('6'):
+			 case JSON_TEXT('7'):
+		  #endif
+			 for(int i = 0; i < 2; ++i){
+				if (json_unlikely(!isOctal(*(++p)))){
+				    JSON_FAIL(JSON_TEXT("Invalid octal escape"));
+				    return false;
+				}
+			 }
+			 break;
+	   #endif
+	   case JSON_TEXT('\0'):
+		  JSON_FAIL(JSON_TEXT("Null terminator inside of a quotation"));
+		  return false;
+    }
+    return true;
+}
 
-#define BRACKET(left, right)\
-    case left: {\
-	   size_t brac = 1;\
-	   while (brac){\
-		  switch (*(++p)){\
-			 case right:\
-				--brac;\
-				break;\
-			 case left:\
-				++brac;\
-				break;\
-			 QUOTECASE()\
-			 NULLCASE(JSON_TEXT("Null terminator inside of a bracket"))\
-		  }\
-	   }\
-	   break;}\
-    case right:\
-	   return json_string::npos;
+static inline bool hasBackslash(const json_char * text, size_t length) json_nothrow {
+    #ifdef JSON_UNICODE
+	   return std::wmemchr(text, JSON_TEXT('\\'), length) != 0;
+    #else
+	   return std::memchr(text, JSON_TEXT('\\'), length) != 0;
+    #endif
+}
 
+//finds the end of the quoted string at p, noting if it has to be unescaped, but doesn't copy anything
+static inline bool ReadString(json_reader & in, json_span & span) json_nothrow {
+    const json_char * & p = in.p;
+    if (json_unlikely(*p != JSON_TEXT('\"'))) return false;
+    span.start = p;
+    if (in.next != in.last){  //the indexer has already found where it ends
+	   const uint32_t offset = (uint32_t)(p - in.text);
+	   while ((in.next != in.last) && (*in.next < offset)) ++in.next;
+	   if (json_likely((in.last - in.next >= 2) && (*in.next == offset) && (in.text[in.next[1]] == JSON_TEXT('\"')))){
+		  const json_char * close = in.text + in.next[1];
+		  if (json_likely(!hasBackslash(p + 1, (size_t)(close - p - 1)))){  //escapes are checked as they're read below
+			 span.length = (size_t)(close + 1 - p);
+			 span.escaped = false;
+			 p = close + 1;
+			 in.next += 2;
+			 return true;
+		  }
+	   }
+    }
+    span.escaped = false;
+    while(true){
+	   switch(*(++p)){
+		  case JSON_TEXT('\"'):
+			 span.length = (size_t)(++p - span.start);
+			 return true;
+		  case JSON_TEXT('\\'):
+			 span.escaped = true;
+			 if (json_unlikely(!ReadEscape(p))) return false;
+			 break;
+		  case JSON_TEXT('\0'):
+			 JSON_FAIL(JSON_TEXT("Null terminator inside of a quotation"));
+			 return false;
+		  default:
+			 JSON_ASSERT_SAFE((json_uchar)*p >= 32, JSON_TEXT("Invalid JSON character detected (lo)"), return false;);
+			 break;
+	   }
+    }
+}
 
+//true, false and null, which may be in any case unless strict
+static inline bool ReadLiteral(const json_char * & p, const json_char * literal) json_nothrow {
+    const json_char * runner = p;
+    for(; *literal; ++runner, ++literal){
+	   #ifdef JSON_STRICT
+		  if (*runner != *literal) return false;
+	   #else
+		  if ((*runner | 0x20) != *literal) return false;
+	   #endif
+    }
+    p = runner;
+    return true;
+}
 
-#ifdef JSON_READ_PRIORITY
-    size_t JSONWorker::FindNextRelevant(json_char ch, const json_string & value_t, const size_t pos) json_nothrow {
-	   const json_char * start = value_t.c_str();
-	   for (const json_char * p = start + pos; *p; ++p){
-		  if (json_unlikely(*p == ch)) return p - start;
-		  switch (*p){
-				BRACKET(JSON_TEXT('['), JSON_TEXT(']'))
-				BRACKET(JSON_TEXT('{'), JSON_TEXT('}'))
-				QUOTECASE()
-		  }
-	   };
-	   return json_string::npos;
+static void StartReading(json_reader & in, JSONIndexer & indexer, const json_char * json, size_t length) json_nothrow {
+    in.p = in.text = json;
+    in.next = in.last = 0;
+    in.depth = 0;
+    if ((length >= JSON_INDEX_MINIMUM) && (length <= 0xFFFFFFFFu)){  //small ones are read faster than they're indexed
+	   indexer.index(json, length);
+	   indexer.flush();
+	   //a comment could throw off which quotes start strings, and a control character means the strings need a closer look
+	   if (json_likely(!indexer.sawComment() && !indexer.sawControl())){
+		  in.next = indexer.begin();
+		  in.last = indexer.end();
+	   }
     }
-#endif
+}
 
-#ifdef JSON_COMMENTS
-    #define COMMENT_DELIMITER() *runner++ = '\5'
-    #define AND_RUNNER ,runner
-    inline void SingleLineComment(const json_char * & p, json_char * & runner) json_nothrow {
-	   //It is okay to add two '\5' characters here because at minimun the # and '\n' are replaced, so it's at most the same size
-	   COMMENT_DELIMITER();
-	   while((*(++p)) && (*p != JSON_TEXT('\n'))){
-		  *runner++ = *p;
+JSONNode JSONWorker::_parse(const json_char * json, size_t length) json_throws(std::invalid_argument) {
+    json_reader in;
+    JSONIndexer indexer;
+    StartReading(in, indexer, json, length);
+    return _parse(in);
+}
+
+JSONNode JSONWorker::_parse(json_reader & in) json_throws(std::invalid_argument) {
+    #ifdef JSON_COMMENTS
+	   json_string comment;
+    #endif
+    const json_char * & p = in.p;
+    SKIP_WHITE_SPACE(p);
+    if (json_likely((*p == JSON_TEXT('{')) || (*p == JSON_TEXT('[')))){
+	   JSONNode root((*p == JSON_TEXT('{')) ? JSON_NODE : JSON_ARRAY);
+	   #ifdef JSON_COMMENTS
+		  root.internal -> _comment.swap(comment);
+	   #endif
+	   if (json_likely(ReadValue(root.internal, in))){
+		  SKIP_WHITE_SPACE(p);
+		  if (json_likely(*p == JSON_TEXT('\0'))) return root;
+		  JSON_FAIL(JSON_TEXT("Text after the end of the JSON"));
 	   }
-	   COMMENT_DELIMITER();
     }
-#else
-    #define COMMENT_DELIMITER() (void)0
-    #define AND_RUNNER
-#endif
 
-#ifndef JSON_STRICT
-inline void SingleLineComment(const json_char * & p) json_nothrow {
-    while((*(++p)) && (*p != JSON_TEXT('\n')));
+    JSON_FAIL(JSON_TEXT("Not JSON!"));
+    #ifndef JSON_NO_EXCEPTIONS
+	   throw std::invalid_argument(EMPTY_STD_STRING);
+    #else
+	   return JSONNode(JSON_NULL);
+    #endif
 }
-#endif
 
-#ifdef JSON_READ_PRIORITY
-#if defined JSON_DEBUG || defined JSON_SAFE
-    json_char * JSONWorker::RemoveWhiteSpace(const json_string & value_t, json_char & last) json_nothrow  {
-#else
-    json_char * JSONWorker::RemoveWhiteSpace(const json_string & value_t) json_nothrow {
-#endif
-	   json_char * result;
-	   json_char * runner = result = json_malloc<json_char>(value_t.length() + 1);  //dealing with raw memory is faster than adding to a json_string
-	   JSON_ASSERT(result != 0, JSON_TEXT("Out of memory"));
-	   for(const json_char * p = value_t.c_str(); *p; ++p){
-		  switch(*p){
-			 case JSON_TEXT(' '):   //defined as white space
-			 case JSON_TEXT('\t'):  //defined as white space
-			 case JSON_TEXT('\n'):  //defined as white space
-			 case JSON_TEXT('\r'):  //defined as white space
-				break;
-			 #ifndef JSON_STRICT
-				case JSON_TEXT('/'):  //a C comment
-				    if (*(++p) == JSON_TEXT('*')){  //a multiline comment
-					   COMMENT_DELIMITER();
-					   while ((*(++p) != JSON_TEXT('*')) || (*(p + 1) != JSON_TEXT('/'))){
-						  JSON_ASSERT_SAFE(*p, JSON_TEXT("Null terminator inside of a multiline quote"), COMMENT_DELIMITER(); goto endofloop;);
-						  *runner++ = *p;
-					   }
-					   ++p;
-					   COMMENT_DELIMITER();
-					   break;
-				    }
-				    //Should be a single line C comment, so let it fall through to use the bash comment stripper
-				    JSON_ASSERT_SAFE(*p == JSON_TEXT('/'), JSON_TEXT("stray / character, not quoted, or a comment"), goto endofloop;);
-				case JSON_TEXT('#'):  //a bash comment
-				    SingleLineComment(p AND_RUNNER);
-				    break;
-			 #endif
-			 case JSON_TEXT('\"'):  //a quote
-				*runner++ = JSON_TEXT('\"');
-				while(*(++p) != JSON_TEXT('\"')){  //find the end of the quotation, as white space is preserved within it
-				    JSON_ASSERT_SAFE(*p, JSON_TEXT("Null terminator inside of a quotation"), goto endofloop;);
-				    switch(*p){
-					   case JSON_TEXT('\\'):
-						  *runner++ = JSON_TEXT('\\');
-						  *runner++ = (*++p == JSON_TEXT('\"')) ? JSON_TEXT('\1') : *p;  //an escaped quote will reak havoc will all of my searching functions, so change it into an illegal character in JSON for convertion later on
-						  break;
-					   default:
-						  *runner++ = *p;
-						  break;
-				    }
-				}
-				//no break, let it fall through so that the trailing quote gets added
-			 default:
-				JSON_ASSERT_SAFE((json_uchar)*p >= 32, JSON_TEXT("Invalid JSON character detected (lo)"), goto endofloop;);
-				JSON_ASSERT_SAFE((json_uchar)*p <= 126, JSON_TEXT("Invalid JSON character detected (hi)"), goto endofloop;);
-				*runner++ = *p;
-				break;
+bool JSONWorker::ReadValue(internalJSONNode * node, json_reader & in) json_nothrow {
+    const json_char * & p = in.p;
+    switch(*p){
+	   case JSON_TEXT('{'):
+	   case JSON_TEXT('['): {
+		  //each level is read by calling down, so there has to be a bottom before the stack runs out
+		  if (json_unlikely(in.depth == JSON_MAX_DEPTH)){
+			 JSON_FAIL(JSON_TEXT("Nested too deep"));
+			 return false;
 		  }
+		  ++in.depth;
+		  const bool read = (*p == JSON_TEXT('{')) ? ReadNode(node, in) : ReadArray(node, in);
+		  --in.depth;
+		  return read;
 	   }
-	   #ifdef JSON_SAFE
-		  endofloop:
+	   case JSON_TEXT('\"'): {
+		  json_span span;
+		  if (json_unlikely(!ReadString(in, span))) return false;
+		  node -> _type = JSON_STRING;
+		  if (json_likely(!span.escaped)){  //nothing to unescape, so it's done
+			 node -> _string.assign(span.start + 1, span.length - 2);
+			 return true;
+		  }
+		  node -> _string.assign(span.start, span.length);  //kept as it was written, with the quotes, until it's used
+		  #ifdef JSON_PREPARSE
+			 node -> FetchString();
+		  #else
+			 node -> SetFetched(false);
+		  #endif
+		  return true;
+	   }
+	   case JSON_TEXT('t'):
+	   #ifndef JSON_STRICT
+		  case JSON_TEXT('T'):
 	   #endif
-	   #if defined JSON_DEBUG || defined JSON_SAFE
-		  last = *(runner - 1);
+		  if (json_unlikely(!ReadLiteral(p, JSON_TEXT("true")))) break;
+		  node -> Set(true);
+		  return true;
+	   case JSON_TEXT('f'):
+	   #ifndef JSON_STRICT
+		  case JSON_TEXT('F'):
 	   #endif
-	   *runner = JSON_TEXT('\0');
-	   return result;
+		  if (json_unlikely(!ReadLiteral(p, JSON_TEXT("false")))) break;
+		  node -> Set(false);
+		  return true;
+	   case JSON_TEXT('n'):
+	   #ifndef JSON_STRICT
+		  case JSON_TEXT('N'):
+	   #endif
+		  if (json_unlikely(!ReadLiteral(p, JSON_TEXT("null")))) break;
+		  node -> Nullify();
+		  return true;
+	   #ifndef JSON_STRICT
+		  case JSON_TEXT(','):  //null in libjson
+		  case JSON_TEXT(']'):  //null in libjson
+		  case JSON_TEXT('}'):  //null in libjson
+			 node -> Nullify();
+			 return true;
+	   #endif
+	   default: {
+		  const json_char * start = p;
+		  json_number res;
+		  if (json_unlikely(!NumberToString::_parse(p, res))) break;
+		  node -> _type = JSON_NUMBER;
+		  node -> _value._number = res;
+		  node -> _string.assign(start, (size_t)(p - start));  //so that it's written back the way it was read
+		  return true;
+	   }
     }
+    JSON_FAIL(JSON_TEXT("unknown JSON literal"));
+    return false;
+}
+#endif
+
+#ifndef JSON_STRICT
+//stops on the last character of the comment, so that one at the very end doesn't step over the terminator
+inline void SingleLineComment(const json_char * & p) json_nothrow {
+    while((*(p + 1)) && (*(p + 1) != JSON_TEXT('\n'))) ++p;
+}
 #endif
 
 json_string JSONWorker::RemoveWhiteSpaceAndComments(const json_string & value_t) json_nothrow {
@@ -259,8 +356,9 @@ json_string JSONWorker::RemoveWhiteSpaceAndComments(const json_string & value_t)
 				JSON_ASSERT_SAFE(*p, JSON_TEXT("Null terminator inside of a quotation"), goto endofloop;);
 				switch(*p){
 				    case JSON_TEXT('\\'):
+					   JSON_ASSERT_SAFE(*(p + 1), JSON_TEXT("Null terminator after an escape"), goto endofloop;);
 					   result += JSON_TEXT('\\');
-					   result += (*++p == JSON_TEXT('\"')) ? JSON_TEXT('\1') : *p;  //an escaped quote will reak havoc will all of my searching functions, so change it into an illegal character in JSON for convertion later on
+					   result += *++p;
 					   break;
 				    default:
 					   result += *p;
@@ -371,7 +469,7 @@ void JSONWorker::SpecialChar(const json_char * & pos, json_string & res) json_no
 	   convert these escaped characters into C characters
 	*/
     switch(*pos){
-	   case JSON_TEXT('\1'):  //quote character (altered by RemoveWhiteSpace)
+	   case JSON_TEXT('\"'):  //quote character
 		  res += JSON_TEXT('\"');
 		  break;
 	   case JSON_TEXT('t'):	//tab character
@@ -407,6 +505,7 @@ void JSONWorker::SpecialChar(const json_char * & pos, json_string & res) json_no
 		  break;
 	   #ifndef JSON_STRICT
 		  case JSON_TEXT('x'):   //hexidecimal ascii code
+			 if (json_unlikely(!isHex(*(pos + 1)) || !isHex(*(pos + 2)))) goto shortescape;  //Hex reads two without looking
 			 res += Hex(++pos);
 			 break;
 
@@ -423,8 +522,11 @@ void JSONWorker::SpecialChar(const json_char * & pos, json_string & res) json_no
 			 case JSON_TEXT('6'):
 			 case JSON_TEXT('7'):
 		  #endif
+			 if (json_unlikely(!isOctal(*(pos + 1)) || !isOctal(*(pos + 2)))) goto shortescape;  //so does FromOctal with three
 			 res += FromOctal(pos);
 			 break;
+		  shortescape:
+			 JSON_FAIL(JSON_TEXT("Escape is too short"));
 		  default:
 			 res += *pos;
 			 break;
@@ -524,158 +626,328 @@ void JSONWorker::SpecialChar(const json_char * & pos, json_string & res) json_no
 
 json_string JSONWorker::UnfixString(const json_string & value_t, bool flag) json_nothrow {
     if (!flag) return value_t;
-    //Re-escapes a json_string so that it can be written out into a JSON file
     json_string res;
     res.reserve(value_t.length());  //since it goes one character at a time, want to reserve it first so that it doens't have to reallocating
+    UnfixString(value_t, flag, res);
+    return res;
+}
+
+//Re-escapes a json_string so that it can be written out into a JSON file, onto the end of what's already been written
+void JSONWorker::UnfixString(const json_string & value_t, bool flag, json_string & output) json_nothrow {
+    if (!flag){
+	   output += value_t;
+	   return;
+    }
     for(const json_char * p = value_t.c_str(); *p; ++p){
 	   switch(*p){
 		  case JSON_TEXT('\"'):  //quote character
-			 res += JSON_TEXT("\\\"");
+			 output += JSON_TEXT("\\\"");
 			 break;
 		  case JSON_TEXT('\\'):	//backslash
-			 res += JSON_TEXT("\\\\");
+			 output += JSON_TEXT("\\\\");
 			 break;
 		  #ifdef JSON_ESCAPE_WRITES
 			 case JSON_TEXT('\t'):	//tab character
-				res += JSON_TEXT("\\t");
+				output += JSON_TEXT("\\t");
 				break;
 			 case JSON_TEXT('\n'):	//newline character
-				res += JSON_TEXT("\\n");
+				output += JSON_TEXT("\\n");
 				break;
 			 case JSON_TEXT('\r'):	//return character
-				res += JSON_TEXT("\\r");
+				output += JSON_TEXT("\\r");
 				break;
 			 case JSON_TEXT('/'):	//forward slash
-				res += JSON_TEXT("\\/");
+				output += JSON_TEXT("\\/");
 				break;
 			 case JSON_TEXT('\b'):	//backspace
-				res += JSON_TEXT("\\b");
+				output += JSON_TEXT("\\b");
 				break;
 			 case JSON_TEXT('\f'):	//formfeed
-				res += JSON_TEXT("\\f");
+				output += JSON_TEXT("\\f");
 				break;
 			 default:
 				if (json_unlikely(((json_uchar)(*p) < 32) || ((json_uchar)(*p) > 126))){
-				    res += toUTF8((json_uchar)(*p));
+				    output += toUTF8((json_uchar)(*p));
 				} else {
-				    res += *p;
+				    output += *p;
 				}
 				break;
 		  #else
 			 default:
-				res += *p;
+				output += *p;
 				break;
 		  #endif
 	   }
     }
+}
+
+size_t JSONWorker::UnfixedLength(const json_string & value_t, bool flag) json_nothrow {
+    if (!flag) return value_t.length();
+    size_t res = 0;
+    for(const json_char * p = value_t.c_str(); *p; ++p){
+	   switch(*p){
+		  case JSON_TEXT('\"'):
+		  case JSON_TEXT('\\'):
+		  #ifdef JSON_ESCAPE_WRITES
+			 case JSON_TEXT('\t'):
+			 case JSON_TEXT('\n'):
+			 case JSON_TEXT('\r'):
+			 case JSON_TEXT('/'):
+			 case JSON_TEXT('\b'):
+			 case JSON_TEXT('\f'):
+		  #endif
+			 res += 2;
+			 break;
+		  default:
+			 #ifdef JSON_ESCAPE_WRITES
+				if (json_unlikely(((json_uchar)(*p) < 32) || ((json_uchar)(*p) > 126))){
+				    #ifdef JSON_UNICODE
+					   res += ((json_uchar)(*p) > 0xFFFF) ? 12 : 6;  //a surrogate pair, or \uXXXX
+				    #else
+					   res += 6;  //\u00XX
+				    #endif
+				    break;
+				}
+			 #endif
+			 ++res;
+			 break;
+	   }
+    }
     return res;
 }
 
 #ifdef JSON_READ_PRIORITY
-//Create a childnode
+//Create a childnode, attached straight away so that it goes with the parent if the rest can't be read
 #ifdef JSON_COMMENTS
-    #define ARRAY_PARAM bool array  //Just to supress warnings
+    internalJSONNode * JSONWorker::NewChild(internalJSONNode * parent, json_char first, json_string & comment) json_nothrow {
 #else
-    #define ARRAY_PARAM bool
+    internalJSONNode * JSONWorker::NewChild(internalJSONNode * parent, json_char first) json_nothrow {
 #endif
-inline void JSONWorker::NewNode(const internalJSONNode * parent, const json_string & name, const json_string & value, ARRAY_PARAM) json_nothrow {
+    internalJSONNode * child = internalJSONNode::newInternal((first == JSON_TEXT('{')) ? JSON_NODE : ((first == JSON_TEXT('[')) ? JSON_ARRAY : JSON_NULL));
     #ifdef JSON_COMMENTS
-	   JSONNode * child;
-	   START_MEM_SCOPE
-		  json_string _comment;
-		  START_MEM_SCOPE
-			 const json_char * runner = ((array) ? value.c_str() : name.c_str());
-			 if (json_unlikely(*runner == '\5')){  //multiple comments will be consolidated into one
-				newcomment:
-				while(*(++runner) != '\5'){
-				    JSON_ASSERT(*runner, JSON_TEXT("Removing white space failed"));
-				    _comment += *runner;
-				}
-				if (json_unlikely(*(++runner) == '\5')){ //step past the trailing tag
-				    _comment += '\n';
-				    goto newcomment;
-				}
-			 }
-			 internalJSONNode * myinternal;
-			 if (array){
-				myinternal = internalJSONNode::newInternal(name, runner);
-			 } else {
-				myinternal = internalJSONNode::newInternal(++runner, value);
-			 }
-			 child = JSONNode::newJSONNode(myinternal);
-		  END_MEM_SCOPE
-		  child -> set_comment(_comment);
-	   END_MEM_SCOPE
-	   const_cast<internalJSONNode*>(parent) -> CHILDREN -> push_back(child);   //attach it to the parent node
-    #else
-	if (name.empty()){
-	   	const_cast<internalJSONNode*>(parent) -> CHILDREN -> push_back(JSONNode::newJSONNode(internalJSONNode::newInternal(name.c_str(), value)));	    //attach it to the parent node
-	} else {
-		const_cast<internalJSONNode*>(parent) -> CHILDREN -> push_back(JSONNode::newJSONNode(internalJSONNode::newInternal(name.c_str() + 1, value)));	    //attach it to the parent node
-	}
+	   child -> _comment.swap(comment);  //whatever was said since the last child belongs to this one
     #endif
+    parent -> CHILDREN -> push_back(JSONNode::newJSONNode(child));
+    return child;
 }
 
-//Create a subarray
-void JSONWorker::DoArray(const internalJSONNode * parent, const json_string & value_t) json_nothrow {
-    //This takes an array and creates nodes out of them
-    JSON_ASSERT(!value_t.empty(), JSON_TEXT("DoArray is empty"));
-    JSON_ASSERT_SAFE(value_t[0] == JSON_TEXT('['), JSON_TEXT("DoArray is not an array"), parent -> Nullify(); return;);
-    if (json_unlikely(value_t.length() <= 2)) return;  // just a [] (blank array)
+#ifdef JSON_COMMENTS
+    #define AND_COMMENT ,comment
+#else
+    #define AND_COMMENT
+#endif
 
-    #ifdef JSON_SAFE
-	   json_string newValue;  //share this so it has a reserved buffer
+//Create a subarray
+bool JSONWorker::ReadArray(internalJSONNode * parent, json_reader & in) json_nothrow {
+    const json_char * & p = in.p;
+    #ifdef JSON_COMMENTS
+	   json_string comment;
     #endif
-    size_t starting = 1;  //ignore the [
+    ++p;  //step past the [
+    SKIP_WHITE_SPACE(p);
+    if (*p == JSON_TEXT(']')){  //just a [] (blank array)
+	   ++p;
+	   return true;
+    }
+    while(true){
+	   if (json_unlikely(!ReadValue(NewChild(parent, *p AND_COMMENT), in))) return false;
+	   SKIP_WHITE_SPACE(p);
+	   if (json_likely(*p == JSON_TEXT(','))){
+		  ++p;
+		  SKIP_WHITE_SPACE(p);
+	   } else if (json_likely(*p == JSON_TEXT(']'))){
+		  ++p;
+		  return true;
+	   } else {
+		  JSON_FAIL(JSON_TEXT("Missing ]"));
+		  return false;
+	   }
+    }
+}
 
-    //Not sure what's in the array, so we have to use commas
-    for(size_t ending = FindNextRelevant(JSON_TEXT(','), value_t, 1);
-	   ending != json_string::npos;
-	   ending = FindNextRelevant(JSON_TEXT(','), value_t, starting)){
+//Create all child nodes
+bool JSONWorker::ReadNode(internalJSONNode * parent, json_reader & in) json_nothrow {
+    const json_char * & p = in.p;
+    #ifdef JSON_COMMENTS
+	   json_string comment;
+    #endif
+    ++p;  //step past the {
+    SKIP_WHITE_SPACE(p);
+    if (*p == JSON_TEXT('}')){  //just a {} (blank node)
+	   ++p;
+	   return true;
+    }
+    json_span name;
+    while(true){
+	   if (json_unlikely(!ReadString(in, name))){
+		  JSON_FAIL(JSON_TEXT("Missing name"));
+		  return false;
+	   }
+	   SKIP_WHITE_SPACE(p);
+	   if (json_unlikely(*p != JSON_TEXT(':'))){
+		  JSON_FAIL(JSON_TEXT("Missing :"));
+		  return false;
+	   }
+	   ++p;
+	   SKIP_WHITE_SPACE(p);
 
-	   #ifdef JSON_SAFE
-		  newValue.assign(value_t.begin() + starting, value_t.begin() + ending);
-		  JSON_ASSERT_SAFE(FindNextRelevant(JSON_TEXT(':'), newValue, 0) == json_string::npos, JSON_TEXT("Key/Value pairs are not allowed in arrays"), parent -> Nullify(); return;);
-		  NewNode(parent, EMPTY_JSON_STRING, newValue, true);
-	   #else
-		  NewNode(parent, EMPTY_JSON_STRING, json_string(value_t.begin() + starting, value_t.begin() + ending), true);
-	   #endif
-		  starting = ending + 1;
+	   internalJSONNode * child = NewChild(parent, *p AND_COMMENT);
+	   if (json_likely(!name.escaped)){
+		  child -> _name.assign(name.start + 1, name.length - 2);
+	   } else {
+		  #ifdef JSON_LESS_MEMORY
+			 child -> _name = FixString(json_string(name.start + 1, name.length - 2), child, true);
+		  #else
+			 child -> _name = FixString(json_string(name.start + 1, name.length - 2), child -> _name_encoded);
+		  #endif
+	   }
+	   if (json_unlikely(!ReadValue(child, in))) return false;
+
+	   SKIP_WHITE_SPACE(p);
+	   if (json_likely(*p == JSON_TEXT(','))){
+		  ++p;
+		  SKIP_WHITE_SPACE(p);
+	   } else if (json_likely(*p == JSON_TEXT('}'))){
+		  ++p;
+		  return true;
+	   } else {
+		  JSON_FAIL(JSON_TEXT("Missing }"));
+		  return false;
+	   }
     }
-    //since the last one will not find the comma, we have to add it here, but ignore the final ]
+}
 
-    #ifdef JSON_SAFE
-	   newValue.assign(value_t.begin() + starting, value_t.end() - 1);
-	   JSON_ASSERT_SAFE(FindNextRelevant(JSON_TEXT(':'), newValue, 0) == json_string::npos, JSON_TEXT("Key/Value pairs are not allowed in arrays"), parent -> Nullify(); return;);
-	   NewNode(parent, EMPTY_JSON_STRING, newValue, true);
-    #else
-	   NewNode(parent, EMPTY_JSON_STRING, json_string(value_t.begin() + starting, value_t.end() - 1), true);
+/*
+    The same reading as above, but onto a JSONDocument's tape instead of into nodes.
+    Nothing is recursive, each open object or array keeps where its parent is in its
+    own word until it's closed, and then it's given where it ends instead
+*/
+bool JSONWorker::ReadTape(JSONDocument & doc) json_nothrow {
+    if (json_unlikely(doc.text.length() > 0xFFFFFFFFu)){
+	   JSON_FAIL(JSON_TEXT("Too much text for a tape"));
+	   return false;
+    }
+    #ifdef JSON_COMMENTS
+	   json_string comment;  //the tape has nowhere to keep them
     #endif
-}
+    json_reader in;
+    JSONIndexer indexer;
+    StartReading(in, indexer, doc.text.c_str(), doc.text.length());
+    const json_char * & p = in.p;
+    const json_char * const text = in.text;
+    const size_t none = 0xFFFFFFFFu;
+    size_t open = none;  //the innermost object or array that hasn't been closed
+    json_span span;
+    json_char close;
+
+    SKIP_WHITE_SPACE(p);
+    if (json_unlikely((*p != JSON_TEXT('{')) && (*p != JSON_TEXT('[')))) return false;
+    while(true){
+	   switch(*p){
+		  case JSON_TEXT('{'):
+		  case JSON_TEXT('['):
+			 doc.push(JSON_TAPE_WORD(*p, open));  //where its parent is, until it's closed
+			 open = doc.count - 1;
+			 close = (*p == JSON_TEXT('{')) ? JSON_TEXT('}') : JSON_TEXT(']');
+			 ++p;
+			 SKIP_WHITE_SPACE(p);
+			 if (*p == close) goto closed;
+			 if (close == JSON_TEXT('}')) goto name;
+			 continue;
+		  case JSON_TEXT('\"'):
+			 if (json_unlikely(!ReadString(in, span))) return false;
+			 doc.push(JSON_TAPE_WORD(JSON_TEXT('\"'), span.start + 1 - text) | (span.escaped ? JSON_TAPE_ESCAPED : 0));
+			 doc.push((uint64_t)(span.length - 2));
+			 break;
+		  case JSON_TEXT('t'):
+		  #ifndef JSON_STRICT
+			 case JSON_TEXT('T'):
+		  #endif
+			 doc.push(JSON_TAPE_WORD(JSON_TEXT('t'), p - text));
+			 if (json_unlikely(!ReadLiteral(p, JSON_TEXT("true")))) goto unknown;
+			 break;
+		  case JSON_TEXT('f'):
+		  #ifndef JSON_STRICT
+			 case JSON_TEXT('F'):
+		  #endif
+			 doc.push(JSON_TAPE_WORD(JSON_TEXT('f'), p - text));
+			 if (json_unlikely(!ReadLiteral(p, JSON_TEXT("false")))) goto unknown;
+			 break;
+		  case JSON_TEXT('n'):
+		  #ifndef JSON_STRICT
+			 case JSON_TEXT('N'):
+		  #endif
+			 doc.push(JSON_TAPE_WORD(JSON_TEXT('n'), p - text));
+			 if (json_unlikely(!ReadLiteral(p, JSON_TEXT("null")))) goto unknown;
+			 break;
+		  #ifndef JSON_STRICT
+			 case JSON_TEXT(','):  //null in libjson
+			 case JSON_TEXT(']'):  //null in libjson
+			 case JSON_TEXT('}'):  //null in libjson
+				doc.push(JSON_TAPE_WORD(JSON_TEXT('n'), p - text));
+				break;
+		  #endif
+		  default: {
+			 const json_char * start = p;
+			 json_number res;
+			 if (json_unlikely(!NumberToString::_parse(p, res))) goto unknown;
+			 uint64_t bits = 0;
+			 std::memcpy(&bits, &res, sizeof(res));
+			 doc.push(JSON_TAPE_WORD(JSON_TEXT('0'), start - text));
+			 doc.push(bits);
+			 break;
+		  }
+	   }
 
+	   //a value has been read, so it's counted and whatever comes after it is looked at
+	   while(true){
+		  SKIP_WHITE_SPACE(p);
+		  if (JSON_TAPE_CHILDREN(doc.tape[open]) != JSON_TAPE_MANY) doc.tape[open] += JSON_TAPE_CHILD;
+		  close = (JSON_TAPE_TAG(doc.tape[open]) == JSON_TEXT('{')) ? JSON_TEXT('}') : JSON_TEXT(']');
+		  if (json_likely(*p == JSON_TEXT(','))){
+			 ++p;
+			 SKIP_WHITE_SPACE(p);
+			 if (close == JSON_TEXT('}')) goto name;
+			 break;
+		  }
+		  if (json_unlikely(*p != close)){
+			 JSON_FAIL((close == JSON_TEXT('}')) ? JSON_TEXT("Missing }") : JSON_TEXT("Missing ]"));
+			 return false;
+		  }
+	   closed: {  //*p is the closing bracket of open
+			 const size_t parent = (size_t)JSON_TAPE_AT(doc.tape[open]);
+			 doc.push(JSON_TAPE_WORD(close, open));
+			 doc.tape[open] = (doc.tape[open] & ~(uint64_t)0xFFFFFFFFULL) | (uint64_t)doc.count;
+			 ++p;
+			 if (parent == none){
+				SKIP_WHITE_SPACE(p);
+				if (json_likely(*p == JSON_TEXT('\0'))) return true;
+				JSON_FAIL(JSON_TEXT("Text after the end of the JSON"));
+				return false;
+			 }
+			 open = parent;
+		  }
+	   }
+	   continue;
 
-//Create all child nodes
-void JSONWorker::DoNode(const internalJSONNode * parent, const json_string & value_t) json_nothrow {
-    //This take a node and creates its members and such
-    JSON_ASSERT(!value_t.empty(), JSON_TEXT("DoNode is empty"));
-    JSON_ASSERT_SAFE(value_t[0] == JSON_TEXT('{'), JSON_TEXT("DoNode is not an node"), parent -> Nullify(); return;);
-    if (json_unlikely(value_t.length() <= 2)) return;  // just a {} (blank node)
-
-    size_t name_ending = FindNextRelevant(JSON_TEXT(':'), value_t, 1);  //find where the name ends
-    JSON_ASSERT_SAFE(name_ending != json_string::npos, JSON_TEXT("Missing :"), parent -> Nullify(); return;);
-    json_string name(value_t.begin() + 1, value_t.begin() + name_ending - 1);	  //pull the name out
-    for (size_t value_ending = FindNextRelevant(JSON_TEXT(','), value_t, name_ending),  //find the end of the value
-	    name_starting = 1;  //ignore the {
-	    value_ending != json_string::npos;
-	    value_ending = FindNextRelevant(JSON_TEXT(','), value_t, name_ending)){
-
-	   NewNode(parent, name, json_string(value_t.begin() + name_ending + 1, value_t.begin() + value_ending), false);
-	   name_starting = value_ending + 1;
-	   name_ending = FindNextRelevant(JSON_TEXT(':'), value_t, name_starting);
-	   JSON_ASSERT_SAFE(name_ending != json_string::npos, JSON_TEXT("Missing :"), parent -> Nullify(); return;);
-	   name.assign(value_t.begin() + name_starting, value_t.begin() + name_ending - 1);
+    name:
+	   if (json_unlikely(!ReadString(in, span))){
+		  JSON_FAIL(JSON_TEXT("Missing name"));
+		  return false;
+	   }
+	   doc.push(JSON_TAPE_WORD(JSON_TEXT('\"'), span.start + 1 - text) | (span.escaped ? JSON_TAPE_ESCAPED : 0));
+	   doc.push((uint64_t)(span.length - 2));
+	   SKIP_WHITE_SPACE(p);
+	   if (json_unlikely(*p != JSON_TEXT(':'))){
+		  JSON_FAIL(JSON_TEXT("Missing :"));
+		  return false;
+	   }
+	   ++p;
+	   SKIP_WHITE_SPACE(p);
     }
-    //since the last one will not find the comma, we have to add it here
-    NewNode(parent, name, json_string(value_t.begin() + name_ending + 1, value_t.end() - 1), false);
+
+unknown:
+    JSON_FAIL(JSON_TEXT("unknown JSON literal"));
+    return false;
 }
 #endif
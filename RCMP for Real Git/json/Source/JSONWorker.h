@@ -2,6 +2,27 @@
 #define JSON_WORKER_H
 
 #include "JSONNode.h"
+#include <stdint.h>
+
+#ifdef JSON_READ_PRIORITY
+    //where a quoted string sits in the text being read, it's only copied once a node keeps it
+    struct json_span {
+	   const json_char * start;  //the opening quote
+	   size_t length;  //including both quotes
+	   bool escaped;  //has to go through FixString
+    };
+
+    //where reading is up to, and what the JSONIndexer found ahead of it
+    struct json_reader {
+	   const json_char * p;
+	   const json_char * text;  //what the indexer's offsets count from
+	   const uint32_t * next;  //the first one that hasn't been passed
+	   const uint32_t * last;
+	   size_t depth;  //how many objects and arrays are open around p
+    };
+#endif
+
+class JSONDocument;
 
 class JSONWorker {
 public:
@@ -10,21 +31,9 @@ public:
     #ifdef JSON_READ_PRIORITY
 	   static JSONNode parse(const json_string & json) json_throws(std::invalid_argument) json_read_priority;
 	   static JSONNode parse_unformatted(const json_string & json) json_throws(std::invalid_argument) json_read_priority;
-
-	   #if defined JSON_DEBUG || defined JSON_SAFE
-		  static JSONNode _parse_unformatted(const json_char * json, json_char & lastchar) json_throws(std::invalid_argument) json_read_priority;
-	   #else
-		  static JSONNode _parse_unformatted(const json_char * json) json_throws(std::invalid_argument) json_read_priority;
-	   #endif
-
-	   #if defined JSON_DEBUG || defined JSON_SAFE
-		  static json_char * RemoveWhiteSpace(const json_string & value_t, json_char & last) json_nothrow json_read_priority;
-	   #else
-		  static json_char * RemoveWhiteSpace(const json_string & value_t) json_nothrow json_read_priority;
-	   #endif
-
-	   static void DoArray(const internalJSONNode * parent, const json_string & value_t) json_nothrow json_read_priority;
-	   static void DoNode(const internalJSONNode * parent, const json_string & value_t) json_nothrow json_read_priority;
+	   static JSONNode _parse(const json_char * json, size_t length) json_throws(std::invalid_argument) json_read_priority;
+	   //for text that has been indexed already, it has to end in a null right after the document
+	   static JSONNode _parse(json_reader & in) json_throws(std::invalid_argument) json_read_priority;
 
 	   #ifdef JSON_LESS_MEMORY
 		  #define NAME_ENCODED this, true
@@ -37,10 +46,9 @@ public:
 	   #endif
     #endif
 
-    #if defined(JSON_READ_PRIORITY) || defined(JSON_STREAM)
-	   static size_t FindNextRelevant(json_char ch, const json_string & value_t, const size_t pos) json_nothrow json_read_priority;
-    #endif
     static json_string UnfixString(const json_string & value_t, bool flag) json_nothrow;
+    static void UnfixString(const json_string & value_t, bool flag, json_string & output) json_nothrow;
+    static size_t UnfixedLength(const json_string & value_t, bool flag) json_nothrow;  //how long UnfixString makes it
 JSON_PRIVATE
     #ifdef JSON_READ_PRIORITY
 	   static json_char Hex(const json_char * & pos) json_nothrow;
@@ -57,8 +65,17 @@ JSON_PRIVATE
     #endif
     #ifdef JSON_READ_PRIORITY
 	   static void SpecialChar(const json_char * & pos, json_string & res) json_nothrow;
-	   static void NewNode(const internalJSONNode * parent, const json_string & name, const json_string & value, bool array) json_nothrow;
+	   static bool ReadValue(internalJSONNode * node, json_reader & in) json_nothrow json_read_priority;
+	   static bool ReadNode(internalJSONNode * parent, json_reader & in) json_nothrow json_read_priority;
+	   static bool ReadArray(internalJSONNode * parent, json_reader & in) json_nothrow json_read_priority;
+	   static bool ReadTape(JSONDocument & doc) json_nothrow json_read_priority;
+	   #ifdef JSON_COMMENTS
+		  static internalJSONNode * NewChild(internalJSONNode * parent, json_char first, json_string & comment) json_nothrow;
+	   #else
+		  static internalJSONNode * NewChild(internalJSONNode * parent, json_char first) json_nothrow;
+	   #endif
     #endif
+    friend class JSONDocument;
 };
 
 #endif
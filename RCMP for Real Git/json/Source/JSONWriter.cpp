@@ -23,26 +23,31 @@ const static json_string WRITER_EMPTY;
 	   JSON_ASSERT(result.capacity == amount * INDENT.length(), JSON_TEXT("makeIndent made a string too big"));
 	   return result;
     }
+
+    inline size_t indentLength(unsigned int amount) json_nothrow {
+	   return amount * INDENT.length();
+    }
 #else
     inline json_string makeIndent(unsigned int amount) json_nothrow {
 	   if (amount == 0xFFFFFFFF) return WRITER_EMPTY;
 	   return json_string(amount, JSON_TEXT('\t'));
     }
-#endif
 
-json_string internalJSONNode::WriteName(bool formatted, bool arrayChild) const json_nothrow {
-    if (arrayChild){
-	   return WRITER_EMPTY ;
-    } else {
-	   return json_string(JSON_TEXT("\"")) + JSONWorker::UnfixString(_name, _name_encoded) + ((formatted) ? JSON_TEXT("\" : ") : JSON_TEXT("\":"));
+    inline size_t indentLength(unsigned int amount) json_nothrow {
+	   return amount;
     }
+#endif
+
+void internalJSONNode::WriteName(bool formatted, bool arrayChild, json_string & output) const json_nothrow {
+    if (arrayChild) return;
+    output += JSON_TEXT('\"');
+    JSONWorker::UnfixString(nameref(), _name_encoded, output);
+    output += (formatted) ? JSON_TEXT("\" : ") : JSON_TEXT("\":");
 }
 
-json_string internalJSONNode::WriteChildren(unsigned int indent) const json_nothrow {
+void internalJSONNode::WriteChildren(unsigned int indent, json_string & output) const json_nothrow {
     //Iterate through the children and write them
-    if (json_likely(CHILDREN -> empty())) return WRITER_EMPTY;
-
-    json_string res;
+    if (json_likely(CHILDREN -> empty())) return;
 
     json_string indent_plus_one;
     //handle whether or not it's formatted JSON
@@ -55,23 +60,22 @@ json_string internalJSONNode::WriteChildren(unsigned int indent) const json_noth
     size_t i = 0;
     JSONNode ** it = CHILDREN -> begin();
     for(JSONNode ** it_end = CHILDREN -> end(); it != it_end; ++it, ++i){
-
-	   res += indent_plus_one + (*it) -> internal -> Write(indent, type() == JSON_ARRAY);
-	   if (json_likely(i < size_minus_one)) res += JSON_TEXT(",");  //the last one does not get a comma, but all of the others do
+	   output += indent_plus_one;
+	   (*it) -> internal -> Write(indent, type() == JSON_ARRAY, output);
+	   if (json_likely(i < size_minus_one)) output += JSON_TEXT(',');  //the last one does not get a comma, but all of the others do
     }
     if (indent != 0xFFFFFFFF){
-	   return res + NEW_LINE + makeIndent(indent - 1);
+	   output += NEW_LINE;
+	   output += makeIndent(indent - 1);
     }
-    return res;
 }
 
 #ifdef JSON_ARRAY_SIZE_ON_ONE_LINE
-    json_string internalJSONNode::WriteChildrenOneLine(unsigned int indent) const json_nothrow {
+    void internalJSONNode::WriteChildrenOneLine(unsigned int indent, json_string & output) const json_nothrow {
 	   //Iterate through the children and write them
-	   if (json_likely(CHILDREN -> empty())) return WRITER_EMPTY;
-	   if ((*CHILDREN -> begin()) -> internal -> isContainer()) return WriteChildren(indent);
+	   if (json_likely(CHILDREN -> empty())) return;
+	   if ((*CHILDREN -> begin()) -> internal -> isContainer()) return WriteChildren(indent, output);
 
-	   json_string res;
 	   json_string comma(JSON_TEXT(","));
 	   if (indent != 0xFFFFFFFF){
 		  comma += JSON_TEXT(' ');
@@ -82,10 +86,9 @@ json_string internalJSONNode::WriteChildren(unsigned int indent) const json_noth
 	   size_t i = 0;
 	   JSONNode ** it = CHILDREN -> begin();
 	   for(JSONNode ** it_end = CHILDREN -> end(); it != it_end; ++it, ++i){
-		  res += (*it) -> internal -> Write(indent, type() == JSON_ARRAY);
-		  if (json_likely(i < size_minus_one)) res += comma;  //the last one does not get a comma, but all of the others do
+		  (*it) -> internal -> Write(indent, type() == JSON_ARRAY, output);
+		  if (json_likely(i < size_minus_one)) output += comma;  //the last one does not get a comma, but all of the others do
 	   }
-	   return res;
     }
 #endif
 
@@ -96,91 +99,162 @@ json_string internalJSONNode::WriteChildren(unsigned int indent) const json_noth
 	   const static json_string SINGLELINE(JSON_TEXT("//"));
     #endif
 
-    json_string internalJSONNode::WriteComment(unsigned int indent) const json_nothrow {
-	   if (indent == 0xFFFFFFFF) return WRITER_EMPTY;
-	   if (json_likely(_comment.empty())) return WRITER_EMPTY;
+    void internalJSONNode::WriteComment(unsigned int indent, json_string & output) const json_nothrow {
+	   if (indent == 0xFFFFFFFF) return;
+	   if (json_likely(_comment.empty())) return;
 	   size_t pos = _comment.find(JSON_TEXT('\n'));
 	   if (json_likely(pos == json_string::npos)){  //Single line comment
-		  return NEW_LINE + makeIndent(indent) + SINGLELINE + _comment + NEW_LINE + makeIndent(indent);
+		  output += NEW_LINE + makeIndent(indent) + SINGLELINE + _comment + NEW_LINE + makeIndent(indent);
+		  return;
 	   }
 
 	   /*
 	    Multiline comments
 	    */
 	   #if defined(JSON_WRITE_BASH_COMMENTS) || defined(JSON_WRITE_SINGLE_LINE_COMMENTS)
-		  json_string result(NEW_LINE + makeIndent(indent));
+		  output += NEW_LINE + makeIndent(indent);
 	   #else
-		  json_string result(NEW_LINE + makeIndent(indent) + JSON_TEXT("/*") + NEW_LINE + makeIndent(indent + 1));
+		  output += NEW_LINE + makeIndent(indent) + JSON_TEXT("/*") + NEW_LINE + makeIndent(indent + 1);
 	   #endif
 	   size_t old = 0;
 	   while(pos != json_string::npos){
 		  if (json_unlikely(pos && _comment[pos - 1] == JSON_TEXT('\r'))) --pos;
 		  #if defined(JSON_WRITE_BASH_COMMENTS) || defined(JSON_WRITE_SINGLE_LINE_COMMENTS)
-			 result += SINGLELINE;
+			 output += SINGLELINE;
 		  #endif
-		  result.append(_comment.begin() + old, _comment.begin() + pos);
-		  result += NEW_LINE;
+		  output.append(_comment.begin() + old, _comment.begin() + pos);
+		  output += NEW_LINE;
 		  #if defined(JSON_WRITE_BASH_COMMENTS) || defined(JSON_WRITE_SINGLE_LINE_COMMENTS)
-			 result += makeIndent(indent);
+			 output += makeIndent(indent);
 		  #else
-			 result += makeIndent(indent + 1);
+			 output += makeIndent(indent + 1);
 		  #endif
 		  old = (_comment[pos] == JSON_TEXT('\r')) ? pos + 2 : pos + 1;
 		  pos = _comment.find(JSON_TEXT('\n'), old);
 	   }
 	   #if defined(JSON_WRITE_BASH_COMMENTS) || defined(JSON_WRITE_SINGLE_LINE_COMMENTS)
-		  result += SINGLELINE;
+		  output += SINGLELINE;
 	   #endif
-	   result.append(_comment.begin() + old, _comment.end());
-	   result += NEW_LINE;
-	   result += makeIndent(indent);
-	   #if defined(JSON_WRITE_BASH_COMMENTS) || defined(JSON_WRITE_SINGLE_LINE_COMMENTS)
-		  return result;
-	   #else
-		  return result + JSON_TEXT("*/") + NEW_LINE + makeIndent(indent);
+	   output.append(_comment.begin() + old, _comment.end());
+	   output += NEW_LINE;
+	   output += makeIndent(indent);
+	   #if !defined(JSON_WRITE_BASH_COMMENTS) && !defined(JSON_WRITE_SINGLE_LINE_COMMENTS)
+		  output += JSON_TEXT("*/") + NEW_LINE + makeIndent(indent);
 	   #endif
     }
 #else
-    inline json_string internalJSONNode::WriteComment(unsigned int) const json_nothrow {
-	   return WRITER_EMPTY;
-    }
+    inline void internalJSONNode::WriteComment(unsigned int, json_string &) const json_nothrow {}
 #endif
 
-json_string internalJSONNode::Write(unsigned int indent, bool arrayChild) const json_nothrow {
+void internalJSONNode::Write(unsigned int indent, bool arrayChild, json_string & output) const json_nothrow {
     const bool formatted = indent != 0xFFFFFFFF;
 
     #if !defined(JSON_PREPARSE) && defined(JSON_READ_PRIORITY)
 	   if (!(formatted || fetched)){  //It's not formatted or fetched, just do a raw dump
-		  return WriteComment(indent) + WriteName(false, arrayChild) + _string;
+		  WriteName(false, arrayChild, output);
+		  output += _string;
+		  return;
 	   }
     #endif
 
     //It's either formatted or fetched
+    if (isContainer()) Fetch();
+    WriteComment(indent, output);
+    WriteName(formatted, arrayChild, output);
     switch (type()){
 	   case JSON_NODE:   //got members, write the members
-		  Fetch();
-            return WriteComment(indent) + WriteName(formatted, arrayChild) + JSON_TEXT("{") + WriteChildren(indent) + JSON_TEXT("}");
-	   case JSON_ARRAY:	   //write out the child nodes int he array
-		  Fetch();
+		  output += JSON_TEXT('{');
+		  WriteChildren(indent, output);
+		  output += JSON_TEXT('}');
+		  return;
+	   case JSON_ARRAY:       //write out the child nodes int he array
+		  output += JSON_TEXT('[');
 		  #ifdef JSON_ARRAY_SIZE_ON_ONE_LINE
 			 if (size() <= JSON_ARRAY_SIZE_ON_ONE_LINE){
-				return WriteComment(indent) + WriteName(formatted, arrayChild) + JSON_TEXT("[") + WriteChildrenOneLine(indent) + JSON_TEXT("]");
-			 }
+				WriteChildrenOneLine(indent, output);
+			 } else
 		  #endif
-            return WriteComment(indent) + WriteName(formatted, arrayChild) + JSON_TEXT("[") + WriteChildren(indent) + JSON_TEXT("]");
+		  WriteChildren(indent, output);
+		  output += JSON_TEXT(']');
+		  return;
 	   case JSON_NUMBER:   //write out a literal, without quotes
 	   case JSON_NULL:
 	   case JSON_BOOL:
-            return WriteComment(indent) + WriteName(formatted, arrayChild) + _string;
+		  output += _string;
+		  return;
     }
 
-    JSON_ASSERT_SAFE(type() == JSON_STRING, JSON_TEXT("Writing an unknown JSON node type"), return JSON_TEXT(""););
+    JSON_ASSERT_SAFE(type() == JSON_STRING, JSON_TEXT("Writing an unknown JSON node type"), return;);
     //If it go here, then it's a json_string
     #if !defined(JSON_PREPARSE) && defined(JSON_READ_PRIORITY)
-	   if (json_likely(fetched)) return WriteComment(indent) + WriteName(formatted, arrayChild) + JSON_TEXT("\"") + JSONWorker::UnfixString(_string, _string_encoded) + JSON_TEXT("\"");  //It's already been fetched, meaning that it's unescaped
-	   return WriteComment(indent) + WriteName(formatted, arrayChild) + _string;  //it hasn't yet been fetched, so it's already unescaped, just do a dump
-    #else
-	   return WriteComment(indent) + WriteName(formatted, arrayChild) + JSON_TEXT("\"") + JSONWorker::UnfixString(_string, _string_encoded) + JSON_TEXT("\"");
+	   if (json_unlikely(!fetched)){  //it hasn't yet been fetched, so it's already unescaped, just do a dump
+		  output += _string;
+		  return;
+	   }
     #endif
+    output += JSON_TEXT('\"');
+    JSONWorker::UnfixString(_string, _string_encoded, output);
+    output += JSON_TEXT('\"');
+}
+
+//counts what Write would, escapes and all, so that the output only has to be allocated once
+size_t internalJSONNode::EstimatedWriteSize(unsigned int indent, bool arrayChild) const json_nothrow {
+    const bool formatted = indent != 0xFFFFFFFF;
+    size_t res = arrayChild ? 0 : 1 + JSONWorker::UnfixedLength(nameref(), _name_encoded) + (formatted ? 4 : 2);
+
+    #if !defined(JSON_PREPARSE) && defined(JSON_READ_PRIORITY)
+	   if (!(formatted || fetched)){
+		  return res + _string.length();
+	   }
+    #endif
+
+    if (isContainer()) Fetch();
+    #ifdef JSON_COMMENTS
+	   if (json_unlikely(formatted && !_comment.empty())){  //rare enough to just write it
+		  json_string comment;
+		  WriteComment(indent, comment);
+		  res += comment.length();
+	   }
+    #endif
+
+    switch (type()){
+	   case JSON_NODE:
+	   case JSON_ARRAY:
+		  res += 2;
+		  break;
+	   case JSON_STRING:
+		  #if !defined(JSON_PREPARSE) && defined(JSON_READ_PRIORITY)
+			 if (json_unlikely(!fetched)) return res + _string.length();
+		  #endif
+		  return res + 2 + JSONWorker::UnfixedLength(_string, _string_encoded);
+	   default:
+		  return res + _string.length();
+    }
+
+    if (json_likely(CHILDREN -> empty())) return res;
+    const size_t count = CHILDREN -> size();
+    const bool array = type() == JSON_ARRAY;
+    #ifdef JSON_ARRAY_SIZE_ON_ONE_LINE
+	   if (array && count <= JSON_ARRAY_SIZE_ON_ONE_LINE && !(*CHILDREN -> begin()) -> internal -> isContainer()){
+		  res += (count - 1) * (formatted ? 2 : 1);
+		  JSONNode ** it = CHILDREN -> begin();
+		  for(JSONNode ** it_end = CHILDREN -> end(); it != it_end; ++it){
+			 res += (*it) -> internal -> EstimatedWriteSize(indent, true);
+		  }
+		  return res;
+	   }
+    #endif
+
+    //the commas, then each child on its own line when it's formatted
+    res += count - 1;
+    const unsigned int child_indent = formatted ? indent + 1 : indent;
+    if (formatted){
+	   res += (count + 1) * NEW_LINE.length() + count * indentLength(child_indent) + indentLength(indent);
+    }
+    JSONNode ** it = CHILDREN -> begin();
+    for(JSONNode ** it_end = CHILDREN -> end(); it != it_end; ++it){
+	   res += (*it) -> internal -> EstimatedWriteSize(child_indent, array);
+    }
+    return res;
 }
 #endif
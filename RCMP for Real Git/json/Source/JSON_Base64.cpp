@@ -2,100 +2,418 @@
 
 #if defined(JSON_BINARY) || defined(JSON_EXPOSE_BASE64)  //if this is not needed, don't waste space and time compiling it
 
+#include <cstring>
+
+//x86 vector versions are picked at run time, so the library still runs on anything it was built for
+#if !defined(JSON_UNICODE) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || JSON_GCC_VERSION >= 40900)
+    #define JSON_BASE64_SIMD
+    #include <immintrin.h>
+#endif
+
 static const json_char * chars64(JSON_TEXT("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"));
 
-json_string JSONBase64::json_encode64(const unsigned char * binary, size_t bytes) json_nothrow {
-    size_t misaligned = bytes % 3;
-    json_string result;
-    result.reserve((size_t)(((float)bytes) * 1.37f) + 4);
-
-    //do all of the ones that are 3 byte aligned
-    for (size_t i = 0, aligned((bytes - misaligned) / 3); i < aligned; ++i){
-	   result += chars64[(binary[0] & 0xFC) >> 2];
-	   result += chars64[((binary[0] & 0x03) << 4) + ((binary[1] & 0xF0) >> 4)];
-	   result += chars64[((binary[1] & 0x0F) << 2) + ((binary[2] & 0xC0) >> 6)];
-	   result += chars64[binary[2] & 0x3F];
-	   binary += 3;
+//the six bits each character stands for, 0xFF if it isn't Base64
+static const unsigned char decode64[256] = {
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 62, 255, 255, 255, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 255, 255, 255, 255, 255, 255,
+    255, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 255, 255, 255, 255, 255,
+    255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255
+};
+
+static inline unsigned int toBinary(json_char c) json_pure;
+static inline unsigned int toBinary(json_char c) json_nothrow {
+    #ifdef JSON_UNICODE
+	   if (json_unlikely((unsigned long)c > 0xFF)) return 0xFF;
+    #endif
+    return decode64[(unsigned char)c];
+}
+
+#ifdef JSON_BASE64_SIMD
+    enum { SIMD_NONE, SIMD_SSSE3, SIMD_AVX2 };
+
+    static int detectSimd(void) json_nothrow {
+	   __builtin_cpu_init();
+	   if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+	   if (__builtin_cpu_supports("ssse3")) return SIMD_SSSE3;
+	   return SIMD_NONE;
+    }
+
+    #ifdef JSON_UNIT_TEST
+	   static int forcedLevel = -1;
+    #endif
+
+    static inline int simdLevel(void) json_nothrow {
+	   static const int level = detectSimd();
+	   #ifdef JSON_UNIT_TEST
+		  if (forcedLevel >= 0) return forcedLevel;
+	   #endif
+	   return level;
+    }
+
+    //encoding after Wojciech Mula, "Base64 encoding with SIMD instructions"
+
+    //12 bytes spread out to 16 six bit indexes
+    __attribute__((target("ssse3")))
+    static inline __m128i encodeSplit(__m128i in) json_nothrow {
+	   in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+	   const __m128i first = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+	   const __m128i second = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+	   return _mm_or_si128(first, second);
+    }
+
+    //each index plus the offset to its character: 0-25 'A', 26-51 'a', 52-61 '0', 62 '+', 63 '/'
+    __attribute__((target("ssse3")))
+    static inline __m128i encodeLookup(__m128i indexes) json_nothrow {
+	   __m128i range = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+	   range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indexes), _mm_set1_epi8(13)));
+	   const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+								   '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	   return _mm_add_epi8(indexes, _mm_shuffle_epi8(offsets, range));
     }
 
-    if (json_likely(misaligned != 0)){
-	   //copy the rest into a temporary buffer
-	   unsigned char temp[3];
-	   for (unsigned int i = 0; i < misaligned; ++i){
-		  temp[i] = *binary++;
+    __attribute__((target("ssse3")))
+    static size_t encodeSSSE3(const unsigned char * binary, size_t groups, json_char * out) json_nothrow {
+	   size_t done = 0;
+	   for(; groups - done >= 6; done += 4){  //reads 16 bytes to use 12
+		  const __m128i in = _mm_loadu_si128((const __m128i *)binary);
+		  _mm_storeu_si128((__m128i *)out, encodeLookup(encodeSplit(in)));
+		  binary += 12;
+		  out += 16;
 	   }
-	   for (unsigned int i = (unsigned int)misaligned; i < 3; ++i){
-		  temp[i] = '\0';
+	   return done;
+    }
+
+    __attribute__((target("avx2")))
+    static size_t encodeAVX2(const unsigned char * binary, size_t groups, json_char * out) json_nothrow {
+	   const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+									   1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	   const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+									    '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+									    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+									    '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	   size_t done = 0;
+	   for(; groups - done >= 10; done += 8){  //reads 28 bytes to use 24
+		  __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)binary)),
+									    _mm_loadu_si128((const __m128i *)(binary + 12)), 1);
+		  in = _mm256_shuffle_epi8(in, spread);
+		  const __m256i first = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+		  const __m256i second = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+		  const __m256i indexes = _mm256_or_si256(first, second);
+		  __m256i range = _mm256_subs_epu8(indexes, _mm256_set1_epi8(51));
+		  range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indexes), _mm256_set1_epi8(13)));
+		  _mm256_storeu_si256((__m256i *)out, _mm256_add_epi8(indexes, _mm256_shuffle_epi8(offsets, range)));
+		  binary += 24;
+		  out += 32;
 	   }
+	   return done;
+    }
 
-	   //now do the final three bytes
-	   result += chars64[(temp[0] & 0xFC) >> 2];
-	   result += chars64[((temp[0] & 0x03) << 4) + ((temp[1] & 0xF0) >> 4)];
-	   if (misaligned == 2){
-		  result += chars64[((temp[1] & 0x0F) << 2) + ((temp[2] & 0xC0) >> 6)];
-		  result += JSON_TEXT('=');
-	   } else {
-		  result += JSON_TEXT("==");
+    //decoding after Mula and Lemire, "Faster Base64 Encoding and Decoding using AVX2 Instructions"
+    //a character is Base64 if the bit for its high nibble is set in the mask for its low nibble
+    #define DECODE_MASKS (char)0xA8, (char)0xF8, (char)0xF8, (char)0xF8, (char)0xF8, (char)0xF8, (char)0xF8, (char)0xF8,\
+					 (char)0xF8, (char)0xF8, (char)0xF0, 0x54, 0x50, 0x50, 0x50, 0x54
+    #define DECODE_BITS 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80, 0, 0, 0, 0, 0, 0, 0, 0
+    //what to add to get back to six bits, by high nibble; '/' is the odd one out in 0x2_
+    #define DECODE_SHIFTS 0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+
+    __attribute__((target("ssse3")))
+    static size_t decodeSSSE3(const json_char * encoded, size_t groups, unsigned char * out) json_nothrow {
+	   const __m128i masks = _mm_setr_epi8(DECODE_MASKS);
+	   const __m128i bits = _mm_setr_epi8(DECODE_BITS);
+	   const __m128i shifts = _mm_setr_epi8(DECODE_SHIFTS);
+	   const __m128i nibble = _mm_set1_epi8(0x0F);
+	   size_t done = 0;
+	   for(; groups - done >= 6; done += 4){  //writes 16 bytes to fill 12
+		  const __m128i in = _mm_loadu_si128((const __m128i *)encoded);
+		  const __m128i high = _mm_and_si128(_mm_srli_epi32(in, 4), nibble);
+		  const __m128i low = _mm_and_si128(in, nibble);
+		  const __m128i valid = _mm_and_si128(_mm_shuffle_epi8(masks, low), _mm_shuffle_epi8(bits, high));
+		  if (_mm_movemask_epi8(_mm_cmpeq_epi8(valid, _mm_setzero_si128()))) break;  //let the scalar code sort it out
+		  __m128i shift = _mm_shuffle_epi8(shifts, high);
+		  shift = _mm_add_epi8(shift, _mm_and_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('/')), _mm_set1_epi8(-3)));
+		  const __m128i values = _mm_add_epi8(in, shift);
+		  const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+		  const __m128i packed = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+		  _mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)));
+		  encoded += 16;
+		  out += 12;
 	   }
+	   return done;
     }
-    JSON_ASSERT((size_t)(((float)bytes) * 1.37f) + 4 >= result.length(), JSON_TEXT("Didn't reserve enough space for a one-time go"));
-    return result;
+
+    __attribute__((target("avx2")))
+    static size_t decodeAVX2(const json_char * encoded, size_t groups, unsigned char * out) json_nothrow {
+	   const __m256i masks = _mm256_setr_epi8(DECODE_MASKS, DECODE_MASKS);
+	   const __m256i bits = _mm256_setr_epi8(DECODE_BITS, DECODE_BITS);
+	   const __m256i shifts = _mm256_setr_epi8(DECODE_SHIFTS, DECODE_SHIFTS);
+	   const __m256i order = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+									   2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	   const __m256i nibble = _mm256_set1_epi8(0x0F);
+	   size_t done = 0;
+	   for(; groups - done >= 11; done += 8){  //writes 32 bytes to fill 24
+		  const __m256i in = _mm256_loadu_si256((const __m256i *)encoded);
+		  const __m256i high = _mm256_and_si256(_mm256_srli_epi32(in, 4), nibble);
+		  const __m256i low = _mm256_and_si256(in, nibble);
+		  const __m256i valid = _mm256_and_si256(_mm256_shuffle_epi8(masks, low), _mm256_shuffle_epi8(bits, high));
+		  if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(valid, _mm256_setzero_si256()))) break;
+		  __m256i shift = _mm256_shuffle_epi8(shifts, high);
+		  shift = _mm256_add_epi8(shift, _mm256_and_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('/')), _mm256_set1_epi8(-3)));
+		  const __m256i values = _mm256_add_epi8(in, shift);
+		  const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+		  const __m256i packed = _mm256_shuffle_epi8(_mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000)), order);
+		  _mm256_storeu_si256((__m256i *)out, _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7)));
+		  encoded += 32;
+		  out += 24;
+	   }
+	   return done;
+    }
+#endif
+
+//whole groups of three bytes
+static void encodeGroups(const unsigned char * binary, size_t groups, json_char * out) json_nothrow {
+    #ifdef JSON_BASE64_SIMD
+	   size_t done = 0;
+	   switch(simdLevel()){
+		  case SIMD_AVX2:
+			 done = encodeAVX2(binary, groups, out);
+			 break;
+		  case SIMD_SSSE3:
+			 done = encodeSSSE3(binary, groups, out);
+			 break;
+	   }
+	   binary += done * 3;
+	   out += done * 4;
+	   groups -= done;
+    #endif
+    for(; groups; --groups){
+	   const unsigned int triple = (binary[0] << 16) | (binary[1] << 8) | binary[2];
+	   out[0] = chars64[triple >> 18];
+	   out[1] = chars64[(triple >> 12) & 0x3F];
+	   out[2] = chars64[(triple >> 6) & 0x3F];
+	   out[3] = chars64[triple & 0x3F];
+	   binary += 3;
+	   out += 4;
+    }
+}
+
+//the last one or two bytes, padded out to a group
+static void encodeTail(const unsigned char * binary, size_t misaligned, json_char * out) json_nothrow {
+    const unsigned int second = (misaligned == 2) ? binary[1] : 0;
+    out[0] = chars64[(binary[0] & 0xFC) >> 2];
+    out[1] = chars64[((binary[0] & 0x03) << 4) + ((second & 0xF0) >> 4)];
+    out[2] = (misaligned == 2) ? chars64[(second & 0x0F) << 2] : JSON_TEXT('=');
+    out[3] = JSON_TEXT('=');
+}
+
+//whole groups of four characters with no padding, false if any of them aren't Base64
+static bool decodeGroups(const json_char * encoded, size_t groups, unsigned char * out) json_nothrow {
+    #ifdef JSON_BASE64_SIMD
+	   size_t done = 0;
+	   switch(simdLevel()){
+		  case SIMD_AVX2:
+			 done = decodeAVX2(encoded, groups, out);
+			 break;
+		  case SIMD_SSSE3:
+			 done = decodeSSSE3(encoded, groups, out);
+			 break;
+	   }
+	   encoded += done * 4;
+	   out += done * 3;
+	   groups -= done;
+    #endif
+    unsigned int bad = 0;
+    for(; groups; --groups){
+	   const unsigned int first = toBinary(encoded[0]);
+	   const unsigned int second = toBinary(encoded[1]);
+	   const unsigned int third = toBinary(encoded[2]);
+	   const unsigned int fourth = toBinary(encoded[3]);
+	   bad |= first | second | third | fourth;
+	   const unsigned int triple = (first << 18) | (second << 12) | (third << 6) | fourth;
+	   out[0] = (unsigned char)(triple >> 16);
+	   out[1] = (unsigned char)(triple >> 8);
+	   out[2] = (unsigned char)triple;
+	   encoded += 4;
+	   out += 3;
+    }
+    return !(bad & 0x80);
+}
+
+//the group that may end in = padding, returns how many bytes it made
+static size_t decodeLast(const json_char * encoded, unsigned char * out, bool & ok) json_nothrow {
+    const unsigned int first = toBinary(encoded[0]);
+    const unsigned int second = toBinary(encoded[1]);
+    unsigned int bad = first | second;
+    out[0] = (unsigned char)((first << 2) + ((second & 0x30) >> 4));
+    if (encoded[2] == JSON_TEXT('=')){  //two = pads
+	   ok &= (encoded[3] == JSON_TEXT('=')) && !(bad & 0x80);
+	   return 1;
+    }
+    const unsigned int third = toBinary(encoded[2]);
+    bad |= third;
+    out[1] = (unsigned char)(((second & 0xF) << 4) + ((third & 0x3C) >> 2));
+    if (encoded[3] == JSON_TEXT('=')){
+	   ok &= !(bad & 0x80);
+	   return 2;
+    }
+    const unsigned int fourth = toBinary(encoded[3]);
+    bad |= fourth;
+    out[2] = (unsigned char)(((third & 0x3) << 6) + fourth);
+    ok &= !(bad & 0x80);
+    return 3;
 }
 
+void JSONBase64::json_encode64(const unsigned char * binary, size_t bytes, json_char * out) json_nothrow {
+    const size_t groups = bytes / 3;
+    encodeGroups(binary, groups, out);
+    if (json_likely(bytes % 3 != 0)){
+	   encodeTail(binary + groups * 3, bytes % 3, out + groups * 4);
+    }
+}
 
-//define it first for the pure qualifier
+json_string JSONBase64::json_encode64(const unsigned char * binary, size_t bytes) json_nothrow {
+    json_string result;
+    if (json_likely(bytes != 0)){
+	   result.resize(encodedSize(bytes));
+	   json_encode64(binary, bytes, &result[0]);
+    }
+    return result;
+}
 
-//generated array initialization.  If there is a bug in toBinary, regenerate this array
-const json_uchar binaryConvert[80] = {62,48,49,50,63,52,53,54,55,56,57,58,59,60,61,249,250,251,252,253,254,255,0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,20,21,22,23,24,25,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47,48,49,50,51};
+size_t JSONBase64::decodedSize(const json_char * encoded, size_t length) json_nothrow {
+    const size_t groups = length / 4;  //anything after the last whole group is ignored
+    if (json_unlikely(groups == 0)) return 0;
+    const json_char * last = encoded + (groups - 1) * 4;
+    if (last[2] == JSON_TEXT('=')) return groups * 3 - 2;
+    if (last[3] == JSON_TEXT('=')) return groups * 3 - 1;
+    return groups * 3;
+}
 
-inline json_uchar toBinary(json_uchar c) json_pure;
-inline json_uchar toBinary(json_uchar c) json_nothrow {
-    JSON_ASSERT_SAFE(c >= 43, JSON_TEXT("Encoded outside low range"), return JSON_TEXT('0'););
-    JSON_ASSERT_SAFE(c <= 122, JSON_TEXT("Encoded outside high range"), return JSON_TEXT('0'););
-    return binaryConvert[c - 43];
+bool JSONBase64::json_decode64(const json_char * encoded, size_t length, unsigned char * out) json_nothrow {
+    const size_t groups = length / 4;
+    bool ok = true;
+    if (json_likely(groups != 0)){
+	   ok = decodeGroups(encoded, groups - 1, out);
+	   decodeLast(encoded + (groups - 1) * 4, out + (groups - 1) * 3, ok);
+    }
+    for(size_t i = groups * 4; i < length; ++i){
+	   ok &= !(toBinary(encoded[i]) & 0x80);
+    }
+    return ok;
 }
 
 std::string JSONBase64::json_decode64(const json_string & encoded) json_nothrow {
     const size_t length = encoded.length();
-    #if defined JSON_DEBUG || defined JSON_SAFE
-	   size_t pos = encoded.find_first_not_of(chars64);
-	   if (json_unlikely(pos != json_string::npos)){
-		  JSON_ASSERT_SAFE(encoded[pos] == JSON_TEXT('='), JSON_TEXT("Not Base64"), return EMPTY_STD_STRING;);
-		  if (pos != length - 1){
-			 JSON_ASSERT_SAFE(pos == length - 2, JSON_TEXT("Not Base64"), return EMPTY_STD_STRING;);
-			 JSON_ASSERT_SAFE(encoded[pos + 1] == JSON_TEXT('='), JSON_TEXT("Not Base64"), return EMPTY_STD_STRING;);
-		  }
-	   }
-    #endif
-    const json_char * runner = encoded.c_str();
-    size_t aligned = length / 4; //don't do the last ones as they might be = padding
     std::string result;
-    if (json_likely(aligned != 0)){
-	   --aligned;
-	   result.reserve((size_t)((float)length / 1.37) + 1);
-
-	   //first do the ones that can not have any padding
-	   for (unsigned int i = 0; i < aligned; ++i){
-		  const json_char second = toBinary(runner[1]);
-		  const json_char third = toBinary(runner[2]);
-		  result += (toBinary(runner[0]) << 2) + ((second & 0x30) >> 4);
-		  result += ((second & 0xf) << 4) + ((third & 0x3c) >> 2);
-		  result += ((third & 0x3) << 6) + toBinary(runner[3]);
-		  runner += 4;
+    result.resize(decodedSize(encoded.data(), length));
+    if (json_likely(!result.empty())){
+	   if (json_unlikely(!json_decode64(encoded.data(), length, (unsigned char *)&result[0]))){
+		  JSON_FAIL_SAFE(JSON_TEXT("Not Base64"), return EMPTY_STD_STRING;);
 	   }
+    }
+    return result;
+}
 
-	   //now do the ones that might have padding, the first two characters can not be padding, so do them quickly
-	   const json_char second = toBinary(runner[1]);
-	   result += (toBinary(runner[0]) << 2) + ((second & 0x30) >> 4);
-	   if (runner[2] != '='){  //not two = pads
-		  const json_char third = toBinary(runner[2]);
-		  result += ((second & 0xf) << 4) + ((third & 0x3c) >> 2);
-		  if (runner[3] != '='){  //no padding
-			 result += ((third & 0x3) << 6) + toBinary(runner[3]);
-		  }
+#ifdef JSON_UNIT_TEST
+    bool JSONBase64::forceSimdLevel(int level) json_nothrow {
+	   #ifdef JSON_BASE64_SIMD
+		  forcedLevel = -1;
+		  if (level > simdLevel()) return false;
+		  forcedLevel = level;
+		  return true;
+	   #else
+		  return level <= 0;
+	   #endif
+    }
+#endif
+
+size_t JSONBase64Encoder::write(const unsigned char * binary, size_t bytes, json_char * out) json_nothrow {
+    json_char * const start = out;
+    if (pending != 0){
+	   if (pending + bytes < 3){
+		  while(bytes--) carry[pending++] = *binary++;
+		  return 0;
 	   }
+	   unsigned char group[3];
+	   std::memcpy(group, carry, pending);
+	   std::memcpy(group + pending, binary, 3 - pending);
+	   binary += 3 - pending;
+	   bytes -= 3 - pending;
+	   pending = 0;
+	   encodeGroups(group, 1, out);
+	   out += 4;
     }
-    return result;
+    const size_t groups = bytes / 3;
+    encodeGroups(binary, groups, out);
+    out += groups * 4;
+    pending = bytes % 3;
+    std::memcpy(carry, binary + groups * 3, pending);
+    return out - start;
+}
+
+size_t JSONBase64Encoder::finish(json_char * out) json_nothrow {
+    if (pending == 0) return 0;
+    encodeTail(carry, pending, out);
+    pending = 0;
+    return 4;
+}
+
+size_t JSONBase64Decoder::write(const json_char * encoded, size_t length, unsigned char * out) json_nothrow {
+    unsigned char * const start = out;
+
+    //finish the groups from last time, as long as there's another group behind them
+    while(pending % 4 && length){
+	   carry[pending++] = *encoded++;
+	   --length;
+    }
+    size_t used = 0;
+    while(used + 4 <= pending && pending - (used + 4) + length >= 4){
+	   ok &= decodeGroups(carry + used, 1, out);
+	   out += 3;
+	   used += 4;
+    }
+    pending -= used;
+    std::memmove(carry, carry + used, pending * sizeof(json_char));
+    if (pending != 0){
+	   std::memcpy(carry + pending, encoded, length * sizeof(json_char));
+	   pending += length;
+	   return out - start;
+    }
+
+    //then everything but the last group straight from the input
+    const size_t groups = length / 4;
+    if (groups > 1){
+	   ok &= decodeGroups(encoded, groups - 1, out);
+	   out += (groups - 1) * 3;
+	   encoded += (groups - 1) * 4;
+	   length -= (groups - 1) * 4;
+    }
+    std::memcpy(carry, encoded, length * sizeof(json_char));
+    pending = length;
+    return out - start;
+}
+
+size_t JSONBase64Decoder::finish(unsigned char * out) json_nothrow {
+    size_t res = 0;
+    if (pending >= 4){
+	   res = decodeLast(carry, out, ok);
+    }
+    for(size_t i = (pending / 4) * 4; i < pending; ++i){
+	   ok &= !(toBinary(carry[i]) & 0x80);
+    }
+    pending = 0;
+    return res;
 }
 
 #endif
@@ -9,8 +9,53 @@
 
 class JSONBase64 {
 public:
-    static json_string json_encode64(const unsigned char * binary, size_t bytes) json_nothrow json_cold;
-    static std::string json_decode64(const json_string & encoded) json_nothrow json_cold;
+    static json_string json_encode64(const unsigned char * binary, size_t bytes) json_nothrow;
+    static std::string json_decode64(const json_string & encoded) json_nothrow;
+
+    //out must have room for exactly encodedSize(bytes) characters
+    static void json_encode64(const unsigned char * binary, size_t bytes, json_char * out) json_nothrow;
+    //out must have room for decodedSize(encoded, length) bytes, false if it wasn't Base64
+    static bool json_decode64(const json_char * encoded, size_t length, unsigned char * out) json_nothrow;
+
+    static inline size_t encodedSize(size_t bytes) json_nothrow {
+	   return ((bytes + 2) / 3) * 4;
+    }
+    static size_t decodedSize(const json_char * encoded, size_t length) json_nothrow;
+
+    #ifdef JSON_UNIT_TEST
+	   //0 for the plain code, 1 for SSSE3 and 2 for AVX2, so each can be checked against the others,
+	   //-1 goes back to the best there is, and false if this build or cpu can't run it
+	   static bool forceSimdLevel(int level) json_nothrow;
+    #endif
+};
+
+//for data that is too big to hold twice, it comes in however it is read and goes out in whole groups
+class JSONBase64Encoder {
+public:
+    JSONBase64Encoder(void) json_nothrow : pending(0) {}
+
+    //out needs room for JSONBase64::encodedSize(bytes + 2) characters, returns how many it wrote
+    size_t write(const unsigned char * binary, size_t bytes, json_char * out) json_nothrow;
+    //the last group and its padding, at most 4 characters
+    size_t finish(json_char * out) json_nothrow;
+JSON_PRIVATE
+    unsigned char carry[2];
+    size_t pending;
+};
+
+class JSONBase64Decoder {
+public:
+    JSONBase64Decoder(void) json_nothrow : pending(0), ok(true) {}
+
+    //out needs room for (length / 4 + 1) * 3 bytes, returns how many it wrote
+    size_t write(const json_char * encoded, size_t length, unsigned char * out) json_nothrow;
+    //the last group, which may be padded, at most 3 bytes
+    size_t finish(unsigned char * out) json_nothrow;
+    inline bool valid(void) const json_nothrow { return ok; }
+JSON_PRIVATE
+    json_char carry[8];  //the last group is held back in case it is padded, plus the next one as it fills
+    size_t pending;
+    bool ok;
 };
 
 #endif
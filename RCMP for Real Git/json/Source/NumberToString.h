@@ -2,344 +2,422 @@
 #define NUMBERTOSTRING_H
 
 #include "JSONDebug.h"
-#ifdef JSON_LESS_MEMORY
-    #include "JSONMemory.h"
-#endif
-#include <cstdio>
-#ifdef JSON_STRICT
-    #include <cmath>
-#endif
-template <unsigned int GETLENSIZE>
-struct getLenSize{
-    char tmp[GETLENSIZE == 16];  // compile time assertion
-    enum {GETLEN = 41};
-};
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdint.h>
+static inline bool _floatsAreEqual(const json_number & one, const json_number & two) json_pure;
+static inline bool _floatsAreEqual(const json_number & one, const json_number & two) json_nothrow {
+    return (one > two) ? (one - two) < JSON_FLOAT_THRESHHOLD : (one - two) > -JSON_FLOAT_THRESHHOLD;
+}
 
-template<>
-struct getLenSize<1>{
-    enum {GETLEN = 5};
+//the unsigned type that can hold the magnitude of any T
+template <typename T>
+struct json_unsigned_of {
+    typedef unsigned long type;
 };
 
-template <>
-struct getLenSize<2>{
-    enum {GETLEN = 7};
+#ifndef JSON_ISO_STRICT
+    template <>
+    struct json_unsigned_of<long long> {
+	   typedef unsigned long long type;
+    };
+
+    template <>
+    struct json_unsigned_of<unsigned long long> {
+	   typedef unsigned long long type;
+    };
+#endif
+
+//a floating point number with a 64 bit significand, value = f * 2^e
+struct json_diy_fp {
+    json_diy_fp(void) json_nothrow : f(0), e(0) {}
+    json_diy_fp(uint64_t F, int E) json_nothrow : f(F), e(E) {}
+    uint64_t f;
+    int e;
 };
 
-template <>
-struct getLenSize<4>{
-    enum {GETLEN = 12};
+//the raw bits of a float or a double
+template <size_t SIZE>
+struct json_float_bits {
+    typedef uint64_t type;
 };
 
 template <>
-struct getLenSize<8>{
-    enum {GETLEN = 22};
+struct json_float_bits<4> {
+    typedef uint32_t type;
 };
 
-static inline bool _floatsAreEqual(const json_number & one, const json_number & two) json_pure;
-static inline bool _floatsAreEqual(const json_number & one, const json_number & two) json_nothrow {
-    return (one > two) ? (one - two) < JSON_FLOAT_THRESHHOLD : (one - two) > -JSON_FLOAT_THRESHHOLD;
-}
-
-#ifdef JSON_LESS_MEMORY
-    #define num_str_result s.ptr
-#endif
-
 class NumberToString {
 public:
     template<typename T>
     static json_string _itoa(T val) json_nothrow {
-	   #ifdef JSON_LESS_MEMORY
-		  json_auto<json_char> s(getLenSize<sizeof(T)>::GETLEN);
-	   #else
-		  json_char num_str_result[getLenSize<sizeof(T)>::GETLEN];
-	   #endif
-	   num_str_result[getLenSize<sizeof(T)>::GETLEN - 1] = JSON_TEXT('\0'); //null terminator
-	   json_char * runner = &num_str_result[getLenSize<sizeof(T)>::GETLEN - 2];
-	   bool negative;
-
-	   START_MEM_SCOPE
-	   long value = (long)val;
-	   //first thing, check if it's negative, if so, make it positive
-	   if (value < 0){
-		  value = -value;
-		  negative = true;
-	   } else {
-		  negative = false;
-	   }
-
-	   //create the string
-	   do {
-		  *runner-- = (json_char)(value % 10) + JSON_TEXT('0');
-	   } while(value /= 10);
-	   END_MEM_SCOPE
+	   json_string res;
+	   _itoa<T>(val, res);
+	   return res;
+    }
 
-	   //if it's negative, add the negation
-	   if (negative){
-		  *runner = JSON_TEXT('-');
-		  return json_string(runner);
-	   }
-	   return json_string(runner + 1);
+    //writes val over whatever is in out, reusing its memory
+    template<typename T>
+    static void _itoa(T val, json_string & out) json_nothrow {
+	   typedef typename json_unsigned_of<T>::type U;
+	   //done in the unsigned type so that the most negative number doesn't overflow
+	   const bool negative = val < 0;
+	   const U value = negative ? (U)0 - (U)val : (U)val;
+	   const size_t digits = _countDigits<U>(value);
+	   out.resize(digits + negative);
+	   json_char * start = &out[0];
+	   if (negative) *start = JSON_TEXT('-');
+	   _writeDigits<U>(value, start + negative + digits);
     }
 
     #ifndef JSON_LIBRARY
 	   template<typename T>
 	   static json_string _uitoa(T val) json_nothrow {
-		  #ifdef JSON_LESS_MEMORY
-			 json_auto<json_char> s(getLenSize<sizeof(T)>::GETLEN);
-		  #else
-			 json_char num_str_result[getLenSize<sizeof(T)>::GETLEN];
-		  #endif
-		  num_str_result[getLenSize<sizeof(T)>::GETLEN - 1] = JSON_TEXT('\0'); //null terminator
-		  json_char * runner = &num_str_result[getLenSize<sizeof(T)>::GETLEN - 2];
-
-		  //create the string
-		  START_MEM_SCOPE
-			 unsigned long value = (unsigned long)val;
-			 do {
-				*runner-- = (json_char)(value % 10) + JSON_TEXT('0');
-			 } while(value /= 10);
-		  END_MEM_SCOPE
-
-		  return json_string(runner + 1);
+		  json_string res;
+		  _uitoa<T>(val, res);
+		  return res;
 	   }
-    #endif
 
-    #ifdef JSON_ISO_STRICT
-	   #define EXTRA_LONG
-	   #define FLOAT_STRING "%f"
-	   #define LFLOAT_STRING L"%f"
-    #else
-	   #define EXTRA_LONG long
-	   #define FLOAT_STRING "%Lf"
-	   #define LFLOAT_STRING L"%Lf"
+	   template<typename T>
+	   static void _uitoa(T val, json_string & out) json_nothrow {
+		  typedef typename json_unsigned_of<T>::type U;
+		  const U value = (U)val;
+		  const size_t digits = _countDigits<U>(value);
+		  out.resize(digits);
+		  _writeDigits<U>(value, &out[0] + digits);
+	   }
     #endif
 
     static json_string _ftoa(json_number value) json_nothrow {
-	   #ifndef JSON_LIBRARY
-		  if (json_unlikely(value > 0.0 && _floatsAreEqual(value, (json_number)((unsigned EXTRA_LONG long)value)))){
-			 return _uitoa<unsigned EXTRA_LONG long>((unsigned EXTRA_LONG long)value);
-		  } else
-	   #endif
-		  if (json_unlikely(_floatsAreEqual(value, (json_number)((long EXTRA_LONG)value)))){
-			 return _itoa<long EXTRA_LONG>((long EXTRA_LONG)value);
-		  }
+	   json_string res;
+	   _ftoa(value, res);
+	   return res;
+    }
 
-	   #ifdef JSON_LESS_MEMORY
-		  json_auto<json_char> s(64);
-	   #else
-		  json_char num_str_result[64];
-	   #endif
-	   #ifdef JSON_UNICODE
-		  swprintf(num_str_result, 63, LFLOAT_STRING, (EXTRA_LONG double)value);
-	   #else
-		  //Thanks to Salvor Hardin for this Visual C++ fix
-		  #ifdef _MSC_VER
-			 _snprintf_s(num_str_result, 63, 63, FLOAT_STRING, (EXTRA_LONG double)value); //yes, 63 appears twice using _snprintf_s()
-		  #else
-			 snprintf(num_str_result, 63, FLOAT_STRING, (EXTRA_LONG double)value);
-		  #endif
-	   #endif
-	   //strip the trailing zeros
-	   for(json_char * pos = &num_str_result[0]; *pos; ++pos){
-		  if (json_unlikely(*pos == '.')){  //only care about after the decimal
-			 for(json_char * runner = pos + 1; *runner; ++runner){
-				if (json_likely(*runner != JSON_TEXT('0'))) pos = runner + 1;  //have to go to the end 1.0001
-			 }
-			 *pos = JSON_TEXT('\0');
-			 break;
-		  }
+    //writes the shortest text that reads back as exactly value (Grisu2)
+    static void _ftoa(json_number value, json_string & out) json_nothrow {
+	   //whole numbers that fit in a long are exact, and _itoa is faster
+	   if (json_likely(value < _intLimit() && value > -_intLimit() && value == (json_number)(long)value)){
+		  _itoa<long>((long)value, out);
+		  return;
+	   }
+
+	   typedef json_float_bits<sizeof(json_number)>::type bits_t;
+	   const int precision = std::numeric_limits<json_number>::digits;
+	   const int bias = std::numeric_limits<json_number>::max_exponent - 1 + (precision - 1);
+	   const bits_t hidden = (bits_t)1 << (precision - 1);
+	   const bits_t exponentMask = (bits_t)(std::numeric_limits<json_number>::max_exponent * 2 - 1);
+
+	   bits_t bits;
+	   std::memcpy(&bits, &value, sizeof(bits));
+	   const bool negative = (bits >> (sizeof(bits_t) * 8 - 1)) != 0;
+	   const bits_t biased = (bits >> (precision - 1)) & exponentMask;
+	   const bits_t fraction = bits & (hidden - 1);
+
+	   if (json_unlikely(biased == exponentMask)){  //not representable in JSON, keep what printf used to say
+		  if (fraction) out = JSON_TEXT("nan");
+		  else out = negative ? JSON_TEXT("-inf") : JSON_TEXT("inf");
+		  return;
+	   }
+
+	   //v and the halfway points to its neighbours, m- and m+
+	   json_diy_fp v;
+	   if (biased == 0){
+		  v = json_diy_fp(fraction, 1 - bias);
+	   } else {
+		  v = json_diy_fp(fraction + hidden, (int)biased - bias);
+	   }
+	   const bool lowerCloser = (fraction == 0) && (biased > 1);
+
+	   json_char buffer[32];
+	   json_char * runner = buffer;
+	   if (negative) *runner++ = JSON_TEXT('-');
+
+	   //big whole numbers have whole halfway points, so the shortest one between them can be found exactly
+	   if (v.e >= 2 && v.e + precision <= 63){
+		  runner = _shortestWhole(runner, v, lowerCloser);
+		  out.assign(buffer, runner - buffer);
+		  return;
 	   }
-	   return json_string(num_str_result);
+
+	   json_diy_fp mPlus = _normalize(json_diy_fp((v.f << 1) + 1, v.e - 1));
+	   json_diy_fp mMinus = lowerCloser ? json_diy_fp((v.f << 2) - 1, v.e - 2) : json_diy_fp((v.f << 1) - 1, v.e - 1);
+	   mMinus.f <<= mMinus.e - mPlus.e;
+	   mMinus.e = mPlus.e;
+	   v = _normalize(v);
+
+	   json_char digits[20];
+	   int length = 0;
+	   int exponent = 0;
+	   _grisu2(digits, length, exponent, mMinus, v, mPlus);
+	   runner = _prettify(runner, digits, length, exponent);
+	   out.assign(buffer, runner - buffer);
     }
 
-    #if defined(JSON_SAFE) || defined(JSON_DEBUG)
-	   static bool isNumeric(const json_string & str) json_nothrow {
-		  const json_char * p = str.c_str();
-		  bool decimal = false;
-		  bool scientific = false;
-
-		  //first letter is weird
-		  switch(*p){
-			 case '\0':
-				return false;
-		  #ifndef JSON_STRICT
-			 case '.':
-				decimal = true;
-				break;
-			 case '+':
-		  #endif
-			 case '-':
-			 case '1':
-			 case '2':
-			 case '3':
-			 case '4':
-			 case '5':
-			 case '6':
-			 case '7':
-			 case '8':
-			 case '9':
-				break;
-			 case '0':
-				++p;
-				switch(*p){
-				    case '.':
-					   decimal = true;
-					   break;
-				    case 'e':
-				    case 'E':
-					   scientific = true;
-					   ++p;
-					   switch(*p){
-						  case '\0':
-							 return false;
-						  case '-':
-						  case '+':
-						  case '0':
-						  case '1':
-						  case '2':
-						  case '3':
-						  case '4':
-						  case '5':
-						  case '6':
-						  case '7':
-						  case '8':
-						  case '9':
-							 break;
-						  default:
-							 return false;
-					   }
-					   break;
-				    #ifndef JSON_STRICT
-					   case 'x':
-						  return (str.find_first_not_of(JSON_TEXT("0123456789ABCDEFabcdef"), 2) == json_string::npos);
-					   case '1':
-					   case '2':
-					   case '3':
-					   case '4':
-					   case '5':
-					   case '6':
-					   case '7':
-						  return (str.find_first_not_of(JSON_TEXT("01234567"), 1) == json_string::npos);
-				    #endif
-				    case '\0':  //just 0
-					   return true;
-				    default:
-					   return false;
-				}
-				break;
-			 default:
-				return false;
-		  }
-		  ++p;
-
-		  //next digits
-		  while (*p){
-			 switch(*p){
-				case '.':
-				    if (json_unlikely(decimal)) return false; //multiple decimals
-				    if (json_unlikely(scientific)) return false;
-				    decimal = true;
-				    break;
-				case 'e':
-				case 'E':
-				    if (json_unlikely(scientific)) return false;
-				    scientific = true;
-				    ++p;
-				    switch(*p){
-					   case '\0':
-						  return false;
-					   case '-':
-					   case '+':
-					   case '0':
-					   case '1':
-					   case '2':
-					   case '3':
-					   case '4':
-					   case '5':
-					   case '6':
-					   case '7':
-					   case '8':
-					   case '9':
-						  break;
-					   default:
-						  return false;
-				    }
-				    break;
-				case '0':
-				case '1':
-				case '2':
-				case '3':
-				case '4':
-				case '5':
-				case '6':
-				case '7':
-				case '8':
-				case '9':
-				    break;
-				default:
-				    return false;
-			 }
-			 ++p;
-		  }
-		  return true;
+    //reads the number at ptr and leaves ptr just past it, false if it isn't one
+    static bool _parse(const json_char * & ptr, json_number & value) json_nothrow json_read_priority;
+
+JSON_PRIVATE
+    static inline json_number _intLimit(void) json_nothrow {
+	   //every whole number below 2^digits is exact, so it is also the shortest text for itself
+	   static const json_number limit = (json_number)std::ldexp(1.0,
+		  std::numeric_limits<json_number>::digits < std::numeric_limits<long>::digits ?
+		  std::numeric_limits<json_number>::digits : std::numeric_limits<long>::digits);
+	   return limit;
+    }
+
+    static inline json_diy_fp _normalize(json_diy_fp x) json_nothrow {
+	   while(!(x.f >> 63)){
+		  x.f <<= 1;
+		  --x.e;
 	   }
-    #endif
+	   return x;
+    }
 
-    #ifdef JSON_STRICT
-	   //much faster because no octal or hex support
-	   json_number _atof (json_char * num){
-		  json_number sign = (json_number)1.0;
+    //the upper 64 bits of the 128 bit product, rounded
+    static inline json_diy_fp _multiply(const json_diy_fp & x, const json_diy_fp & y) json_nothrow {
+	   const uint64_t mask = 0xFFFFFFFFu;
+	   const uint64_t a = x.f >> 32, b = x.f & mask;
+	   const uint64_t c = y.f >> 32, d = y.f & mask;
+	   const uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+	   const uint64_t middle = (bd >> 32) + (ad & mask) + (bc & mask) + (1u << 31);
+	   return json_diy_fp(ac + (ad >> 32) + (bc >> 32) + (middle >> 32), x.e + y.e + 64);
+    }
 
-		  //sign
-		  if (*num==JSON_TEXT('-')){
-			 sign = -1.0;
-			 ++num;
-		  }
+    struct cached_power {
+	   uint32_t hi, lo;
+	   int e;  //binary exponent
+	   int k;  //decimal exponent
+    };
 
-		  //skip leading zeros
-		  while (*num == JSON_TEXT('0')){
-			 ++num;
+    //10^k for every eighth k from -300 to 324, normalized to 64 bits
+    static inline json_diy_fp _cachedPower(int e, int & k) json_nothrow {
+	   static const cached_power powers[] = {
+		  { 0xAB70FE17, 0xC79AC6CA, -1060, -300 }, { 0xFF77B1FC, 0xBEBCDC4F, -1034, -292 },
+		  { 0xBE5691EF, 0x416BD60C, -1007, -284 }, { 0x8DD01FAD, 0x907FFC3C, -980, -276 },
+		  { 0xD3515C28, 0x31559A83, -954, -268 }, { 0x9D71AC8F, 0xADA6C9B5, -927, -260 },
+		  { 0xEA9C2277, 0x23EE8BCB, -901, -252 }, { 0xAECC4991, 0x4078536D, -874, -244 },
+		  { 0x823C1279, 0x5DB6CE57, -847, -236 }, { 0xC2109436, 0x4DFB5637, -821, -228 },
+		  { 0x9096EA6F, 0x3848984F, -794, -220 }, { 0xD77485CB, 0x25823AC7, -768, -212 },
+		  { 0xA086CFCD, 0x97BF97F4, -741, -204 }, { 0xEF340A98, 0x172AACE5, -715, -196 },
+		  { 0xB23867FB, 0x2A35B28E, -688, -188 }, { 0x84C8D4DF, 0xD2C63F3B, -661, -180 },
+		  { 0xC5DD4427, 0x1AD3CDBA, -635, -172 }, { 0x936B9FCE, 0xBB25C996, -608, -164 },
+		  { 0xDBAC6C24, 0x7D62A584, -582, -156 }, { 0xA3AB6658, 0x0D5FDAF6, -555, -148 },
+		  { 0xF3E2F893, 0xDEC3F126, -529, -140 }, { 0xB5B5ADA8, 0xAAFF80B8, -502, -132 },
+		  { 0x87625F05, 0x6C7C4A8B, -475, -124 }, { 0xC9BCFF60, 0x34C13053, -449, -116 },
+		  { 0x964E858C, 0x91BA2655, -422, -108 }, { 0xDFF97724, 0x70297EBD, -396, -100 },
+		  { 0xA6DFBD9F, 0xB8E5B88F, -369, -92 }, { 0xF8A95FCF, 0x88747D94, -343, -84 },
+		  { 0xB9447093, 0x8FA89BCF, -316, -76 }, { 0x8A08F0F8, 0xBF0F156B, -289, -68 },
+		  { 0xCDB02555, 0x653131B6, -263, -60 }, { 0x993FE2C6, 0xD07B7FAC, -236, -52 },
+		  { 0xE45C10C4, 0x2A2B3B06, -210, -44 }, { 0xAA242499, 0x697392D3, -183, -36 },
+		  { 0xFD87B5F2, 0x8300CA0E, -157, -28 }, { 0xBCE50864, 0x92111AEB, -130, -20 },
+		  { 0x8CBCCC09, 0x6F5088CC, -103, -12 }, { 0xD1B71758, 0xE219652C, -77, -4 },
+		  { 0x9C400000, 0x00000000, -50, 4 }, { 0xE8D4A510, 0x00000000, -24, 12 },
+		  { 0xAD78EBC5, 0xAC620000, 3, 20 }, { 0x813F3978, 0xF8940984, 30, 28 },
+		  { 0xC097CE7B, 0xC90715B3, 56, 36 }, { 0x8F7E32CE, 0x7BEA5C70, 83, 44 },
+		  { 0xD5D238A4, 0xABE98068, 109, 52 }, { 0x9F4F2726, 0x179A2245, 136, 60 },
+		  { 0xED63A231, 0xD4C4FB27, 162, 68 }, { 0xB0DE6538, 0x8CC8ADA8, 189, 76 },
+		  { 0x83C7088E, 0x1AAB65DB, 216, 84 }, { 0xC45D1DF9, 0x42711D9A, 242, 92 },
+		  { 0x924D692C, 0xA61BE758, 269, 100 }, { 0xDA01EE64, 0x1A708DEA, 295, 108 },
+		  { 0xA26DA399, 0x9AEF774A, 322, 116 }, { 0xF209787B, 0xB47D6B85, 348, 124 },
+		  { 0xB454E4A1, 0x79DD1877, 375, 132 }, { 0x865B8692, 0x5B9BC5C2, 402, 140 },
+		  { 0xC83553C5, 0xC8965D3D, 428, 148 }, { 0x952AB45C, 0xFA97A0B3, 455, 156 },
+		  { 0xDE469FBD, 0x99A05FE3, 481, 164 }, { 0xA59BC234, 0xDB398C25, 508, 172 },
+		  { 0xF6C69A72, 0xA3989F5C, 534, 180 }, { 0xB7DCBF53, 0x54E9BECE, 561, 188 },
+		  { 0x88FCF317, 0xF22241E2, 588, 196 }, { 0xCC20CE9B, 0xD35C78A5, 614, 204 },
+		  { 0x98165AF3, 0x7B2153DF, 641, 212 }, { 0xE2A0B5DC, 0x971F303A, 667, 220 },
+		  { 0xA8D9D153, 0x5CE3B396, 694, 228 }, { 0xFB9B7CD9, 0xA4A7443C, 720, 236 },
+		  { 0xBB764C4C, 0xA7A44410, 747, 244 }, { 0x8BAB8EEF, 0xB6409C1A, 774, 252 },
+		  { 0xD01FEF10, 0xA657842C, 800, 260 }, { 0x9B10A4E5, 0xE9913129, 827, 268 },
+		  { 0xE7109BFB, 0xA19C0C9D, 853, 276 }, { 0xAC2820D9, 0x623BF429, 880, 284 },
+		  { 0x80444B5E, 0x7AA7CF85, 907, 292 }, { 0xBF21E440, 0x03ACDD2D, 933, 300 },
+		  { 0x8E679C2F, 0x5E44FF8F, 960, 308 }, { 0xD433179D, 0x9C8CB841, 986, 316 },
+		  { 0x9E19DB92, 0xB4E31BA9, 1013, 324 }
+	   };
+	   //the smallest 10^k that scales 2^e into [2^-60, 2^-32], so that the digits fit in 32 bits
+	   const int target = -60 - e - 1;
+	   const int guess = (target * 78913) / (1 << 18) + (target > 0);
+	   const cached_power & power = powers[(300 + guess + 7) / 8];
+	   k = power.k;
+	   return json_diy_fp(((uint64_t)power.hi << 32) | power.lo, power.e);
+    }
+
+    //the whole number with the most trailing zeros that still reads back as v, closest to v on a tie
+    static json_char * _shortestWhole(json_char * runner, const json_diy_fp & v, bool lowerCloser) json_nothrow {
+	   const uint64_t whole = v.f << v.e;
+	   const uint64_t half = (uint64_t)1 << (v.e - 1);
+	   uint64_t low = whole - (lowerCloser ? half >> 1 : half);
+	   uint64_t high = whole + half;
+	   if (v.f & 1){  //halfway rounds to even, so the ends only belong to v when it is even
+		  ++low;
+		  --high;
+	   }
+
+	   uint64_t best = whole;
+	   for(uint64_t unit = 10; unit <= high; unit *= 10){
+		  const uint64_t down = whole / unit * unit;
+		  const uint64_t up = down + unit;
+		  if (down >= low){
+			 best = (up <= high && up - whole < whole - down) ? up : down;
+		  } else if (up <= high){
+			 best = up;
+		  } else {
+			 break;
 		  }
+		  if (unit > ((uint64_t)-1) / 10) break;
+	   }
+
+	   const size_t digits = _countDigits<uint64_t>(best);
+	   _writeDigits<uint64_t>(best, runner + digits);
+	   return runner + digits;
+    }
+
+    //digits and exponent of a decimal strictly between m- and m+, as close to v as it gets
+    static void _grisu2(json_char * digits, int & length, int & exponent, json_diy_fp mMinus, json_diy_fp v, json_diy_fp mPlus) json_nothrow {
+	   int k;
+	   const json_diy_fp power = _cachedPower(mPlus.e, k);
+	   const json_diy_fp w = _multiply(v, power);
+	   json_diy_fp low = _multiply(mMinus, power);
+	   json_diy_fp high = _multiply(mPlus, power);
+	   //the products may be off by one, so stay clear of the ends
+	   ++low.f;
+	   --high.f;
+	   exponent = -k;
+
+	   uint64_t delta = high.f - low.f;
+	   uint64_t dist = high.f - w.f;
+	   const int shift = -high.e;
+	   const uint64_t one = (uint64_t)1 << shift;
+	   uint32_t integral = (uint32_t)(high.f >> shift);
+	   uint64_t fractional = high.f & (one - 1);
 
-		  // Number
-		  json_number n = (json_number)0.0
-		  if (json_likely(*num >= JSON_TEXT('1') && *num <= JSON_TEXT('9'))){
-			 do {
-				n = (n * 10.0) + (*num++ - JSON_TEXT('0'));
-			 } while (*num >= JSON_TEXT('0') && *num <= JSON_TEXT('9'));
+	   uint32_t divisor = 1000000000;
+	   int places = 10;
+	   while(divisor > integral && places > 1){
+		  divisor /= 10;
+		  --places;
+	   }
+
+	   length = 0;
+	   while(places > 0){
+		  digits[length++] = (json_char)(JSON_TEXT('0') + integral / divisor);
+		  integral %= divisor;
+		  --places;
+		  const uint64_t rest = ((uint64_t)integral << shift) + fractional;
+		  if (rest <= delta){
+			 exponent += places;
+			 _grisu2Round(digits, length, dist, delta, rest, (uint64_t)divisor << shift);
+			 return;
 		  }
+		  divisor /= 10;
+	   }
 
-		  // Fractional part
-		  json_number scale = (json_number)0.0;
-		  if (*num==JSON_TEXT('.')) {
-			 ++num;
-			 do {
-				n = (n * 10.0) + (*num++ - JSON_TEXT('0'));
-				--scale;
-			 } while (*num>=JSON_TEXT('0') && *num<=JSON_TEXT('9'));
+	   for(;;){
+		  fractional *= 10;
+		  delta *= 10;
+		  dist *= 10;
+		  digits[length++] = (json_char)(JSON_TEXT('0') + (fractional >> shift));
+		  fractional &= one - 1;
+		  --exponent;
+		  if (fractional <= delta){
+			 _grisu2Round(digits, length, dist, delta, fractional, one);
+			 return;
 		  }
+	   }
+    }
 
-		  // Exponent
-		  int subscale = 0, signsubscale = 1;
-		  if (json_unlikely(*num == JSON_TEXT('e') || *num == JSON_TEXT('E'))){
-			 ++num;
-			 switch(*num){
-				case JSON_TEXT('+'):
-				    ++num;
-				    break;
-				case JSON_TEXT('-'):
-				    signsubscale = -1;
-				    ++num;
-				    break;
-			 }
-			 while (*num >= JSON_TEXT('0') && *num <= JSON_TEXT('9')){
-				subscale=(subscale * 10) + (*num++ - JSON_TEXT('0'));
-			 }
+    //walks the last digit down towards v while it stays inside the interval
+    static inline void _grisu2Round(json_char * digits, int length, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t unit) json_nothrow {
+	   while(rest < dist && delta - rest >= unit && (rest + unit < dist || dist - rest > rest + unit - dist)){
+		  --digits[length - 1];
+		  rest += unit;
+	   }
+    }
+
+    //digits * 10^exponent as plain notation where it is short, scientific otherwise
+    static json_char * _prettify(json_char * runner, const json_char * digits, int length, int exponent) json_nothrow {
+	   const int point = length + exponent;  //where the decimal point goes, counted from the first digit
+	   if (exponent >= 0 && point <= 21){  //whole number, 1230
+		  std::memcpy(runner, digits, length * sizeof(json_char));
+		  runner += length;
+		  for(int i = 0; i < exponent; ++i) *runner++ = JSON_TEXT('0');
+	   } else if (point > 0 && point <= 21){  //1.23
+		  std::memcpy(runner, digits, point * sizeof(json_char));
+		  runner += point;
+		  *runner++ = JSON_TEXT('.');
+		  std::memcpy(runner, digits + point, (length - point) * sizeof(json_char));
+		  runner += length - point;
+	   } else if (point > -6 && point <= 0){  //0.00123
+		  *runner++ = JSON_TEXT('0');
+		  *runner++ = JSON_TEXT('.');
+		  for(int i = point; i < 0; ++i) *runner++ = JSON_TEXT('0');
+		  std::memcpy(runner, digits, length * sizeof(json_char));
+		  runner += length;
+	   } else {  //1.23e+45
+		  *runner++ = digits[0];
+		  if (length > 1){
+			 *runner++ = JSON_TEXT('.');
+			 std::memcpy(runner, digits + 1, (length - 1) * sizeof(json_char));
+			 runner += length - 1;
 		  }
+		  *runner++ = JSON_TEXT('e');
+		  int scale = point - 1;
+		  if (scale < 0){
+			 *runner++ = JSON_TEXT('-');
+			 scale = -scale;
+		  } else {
+			 *runner++ = JSON_TEXT('+');
+		  }
+		  const size_t scaleDigits = _countDigits<unsigned long>((unsigned long)scale);
+		  runner += scaleDigits;
+		  _writeDigits<unsigned long>((unsigned long)scale, runner);
+	   }
+	   return runner;
+    }
+
+    //"00" through "99", so that two digits come out of every division
+    static inline const json_char * _digitPairs(void) json_nothrow {
+	   static const json_char pairs[201] = JSON_TEXT("00010203040506070809")
+		  JSON_TEXT("10111213141516171819") JSON_TEXT("20212223242526272829")
+		  JSON_TEXT("30313233343536373839") JSON_TEXT("40414243444546474849")
+		  JSON_TEXT("50515253545556575859") JSON_TEXT("60616263646566676869")
+		  JSON_TEXT("70717273747576777879") JSON_TEXT("80818283848586878889")
+		  JSON_TEXT("90919293949596979899");
+	   return pairs;
+    }
 
-		  return sign * n * pow(10.0, scale + subscale * signsubscale);	// number = +/- number.fraction * 10^+/- exponent
+    template<typename U>
+    static inline size_t _countDigits(U value) json_nothrow {
+	   size_t res = 1;
+	   for(;;){
+		  if (value < 10) return res;
+		  if (value < 100) return res + 1;
+		  if (value < 1000) return res + 2;
+		  if (value < 10000) return res + 3;
+		  value /= 10000;
+		  res += 4;
 	   }
-    #endif
+    }
+
+    //fills in the digits of value backwards from end, which is one past the last digit
+    template<typename U>
+    static inline void _writeDigits(U value, json_char * end) json_nothrow {
+	   const json_char * pairs = _digitPairs();
+	   while(value >= 100){
+		  const size_t pos = (size_t)(value % 100) * 2;
+		  value /= 100;
+		  *--end = pairs[pos + 1];
+		  *--end = pairs[pos];
+	   }
+	   if (value >= 10){
+		  const size_t pos = (size_t)value * 2;
+		  *--end = pairs[pos + 1];
+		  *--end = pairs[pos];
+	   } else {
+		  *--end = (json_char)(JSON_TEXT('0') + value);
+	   }
+    }
 };
 
 #endif
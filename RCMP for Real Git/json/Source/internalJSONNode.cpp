@@ -25,7 +25,8 @@ internalJSONNode::internalJSONNode(const internalJSONNode & orig) json_nothrow :
     initializeRefCount(1)
     initializeFetch(orig.fetched)
     initializeComment(orig._comment)
-    initializeChildren(0){
+    initializeChildren(0)
+    initializeKey(orig._key){
 
 
     incinternalAllocCount();
@@ -43,126 +44,6 @@ internalJSONNode::internalJSONNode(const internalJSONNode & orig) json_nothrow :
     #endif
 }
 
-#ifdef JSON_PREPARSE
-    #define SetFetchedFalseOrDo(code) code
-#else
-    #define SetFetchedFalseOrDo(code) SetFetched(false)
-#endif
-
-//this one is specialized because the root can only be array or node
-#ifdef JSON_READ_PRIORITY
-internalJSONNode::internalJSONNode(const json_string & unparsed) json_nothrow : _type(), _name(),_name_encoded(false), _string(unparsed), _string_encoded(), _value()
-    initializeMutex(0)
-    initializeRefCount(1)
-    initializeFetch(false)
-    initializeComment(EMPTY_JSON_STRING)
-    initializeChildren(0){
-
-    incinternalAllocCount();
-    switch (unparsed[0]){
-	   case JSON_TEXT('{'):  //node
-		  _type = JSON_NODE;
-		  CHILDREN = jsonChildren::newChildren();
-		  #ifdef JSON_PREPARSE
-			 FetchNode();
-		  #endif
-		  break;
-	   case JSON_TEXT('['):  //array
-		  _type = JSON_ARRAY;
-		  CHILDREN = jsonChildren::newChildren();
-		  #ifdef JSON_PREPARSE
-			 FetchArray();
-		  #endif
-		  break;
-	   default:
-		  JSON_FAIL_SAFE(JSON_TEXT("root not starting with either { or ["), Nullify(););
-		  break;
-    }
-}
-
-#ifndef JSON_STRICT
-    #define LETTERCASE(x, y)\
-	   case JSON_TEXT(x):\
-	   case JSON_TEXT(y)
-#else
-    #define LETTERCASE(x, y)\
-	   case JSON_TEXT(x)
-#endif
-
-internalJSONNode::internalJSONNode(const json_string & name_t, const json_string & value_t) json_nothrow : _type(), _name_encoded(), _name(JSONWorker::FixString(name_t, NAME_ENCODED)), _string(), _string_encoded(), _value()
-    initializeMutex(0)
-    initializeRefCount(1)
-    initializeFetch(false)
-    initializeComment(EMPTY_JSON_STRING)
-    initializeChildren(0){
-
-    incinternalAllocCount();
-
-    #ifdef JSON_STRICT
-	   JSON_ASSERT_SAFE(!value_t.empty(), JSON_TEXT("empty node"), Nullify(NOTVALID); return;);
-    #else
-	   if (json_unlikely(value_t.empty())){
-		  _type = JSON_NULL;
-		  SetFetched(true);
-		  return;
-	   }
-    #endif
-
-    _string = value_t;
-    #ifdef JSON_LESS_MEMORY
-	   JSON_ASSERT(_string.capacity() == _string.length(), JSON_TEXT("_string object too large"));
-    #endif
-
-    const json_char firstchar = value_t[0];
-    #if defined JSON_DEBUG || defined JSON_SAFE
-	   const json_char lastchar = value_t[value_t.length() - 1];
-    #endif
-
-    switch (firstchar){
-        case JSON_TEXT('\"'):  //a json_string literal, still escaped and with leading and trailing quotes
-            JSON_ASSERT_SAFE(lastchar == JSON_TEXT('\"'), JSON_TEXT("Unterminated quote"), Nullify(); return;);
-            _type = JSON_STRING;
-		  SetFetchedFalseOrDo(FetchString());
-            break;
-        case JSON_TEXT('{'):  //a child node, or set of children
-            JSON_ASSERT_SAFE(lastchar == JSON_TEXT('}'), JSON_TEXT("Missing }"), Nullify(); return;);
-            _type = JSON_NODE;
-		  CHILDREN = jsonChildren::newChildren();
-		  SetFetchedFalseOrDo(FetchNode());
-            break;
-        case JSON_TEXT('['):  //an array
-            JSON_ASSERT_SAFE(lastchar == JSON_TEXT(']'), JSON_TEXT("Missing ]"), Nullify(); return;);
-            _type = JSON_ARRAY;
-		  CHILDREN = jsonChildren::newChildren();
-		  SetFetchedFalseOrDo(FetchArray());
-            break;
-        LETTERCASE('t', 'T'):
-            JSON_ASSERT_SAFE(value_t == JSON_TEXT("true"), json_string(json_string(JSON_TEXT("unknown JSON literal: ")) + value_t).c_str(), Nullify(); return;);
-            _value._bool = true;
-            _type = JSON_BOOL;
-		  SetFetched(true);
-            break;
-        LETTERCASE('f', 'F'):
-            JSON_ASSERT_SAFE(value_t == JSON_TEXT("false"), json_string(json_string(JSON_TEXT("unknown JSON literal: ")) + value_t).c_str(), Nullify(); return;);
-            _value._bool = false;
-            _type = JSON_BOOL;
-		  SetFetched(true);
-            break;
-        LETTERCASE('n', 'N'):
-            JSON_ASSERT_SAFE(value_t == JSON_TEXT("null"), json_string(json_string(JSON_TEXT("unknown JSON literal: ")) + value_t).c_str(), Nullify(); return;);
-            _type = JSON_NULL;
-		  SetFetched(true);
-            break;
-        default:
-            JSON_ASSERT_SAFE(NumberToString::isNumeric(value_t), json_string(json_string(JSON_TEXT("unknown JSON literal: ")) + value_t).c_str(), Nullify(); return;);
-		  _type = JSON_NUMBER;
-		  SetFetchedFalseOrDo(FetchNumber());
-            break;
-    }
-}
-#endif
-
-
 internalJSONNode::~internalJSONNode(void) json_nothrow {
     decinternalAllocCount();
     #ifdef JSON_MUTEX_CALLBACKS
@@ -181,59 +62,14 @@ internalJSONNode::~internalJSONNode(void) json_nothrow {
 		  JSON_ASSERT(_string.capacity() == _string.length(), JSON_TEXT("_string object too large 2"));
 	   #endif
     }
-
-    void internalJSONNode::FetchNode(void) const json_nothrow {
-	   JSON_ASSERT_SAFE(!_string.empty(), JSON_TEXT("JSON node type is empty?"), Nullify(); return;);
-	   JSON_ASSERT_SAFE(_string[0] == JSON_TEXT('{'), JSON_TEXT("JSON node type doesn't start with a bracket?"), Nullify(); return;);
-	   JSON_ASSERT_SAFE(_string[_string.length() - 1] == JSON_TEXT('}'), JSON_TEXT("JSON node type doesn't end with a bracket?"), Nullify(); return;);
-	   JSONWorker::DoNode(this, _string);
-	   clearString(_string);
-    }
-
-    void internalJSONNode::FetchArray(void) const json_nothrow {
-	   JSON_ASSERT_SAFE(!_string.empty(), JSON_TEXT("JSON node type is empty?"), Nullify(); return;);
-	   JSON_ASSERT_SAFE(_string[0] == JSON_TEXT('['), JSON_TEXT("JSON node type doesn't start with a square bracket?"), Nullify(); return;);
-	   JSON_ASSERT_SAFE(_string[_string.length() - 1] == JSON_TEXT(']'), JSON_TEXT("JSON node type doesn't end with a square bracket?"), Nullify(); return;);
-	   JSONWorker::DoArray(this, _string);
-	   clearString(_string);
-    }
-
 #endif
 
 //This one is used by as_int and as_float, so even non-readers need it
 void internalJSONNode::FetchNumber(void) const json_nothrow {
-    #ifdef JSON_STRICT
-	   _value._number = NumberToString::_atof(_string.c_str())
-    #else
-	   #ifdef JSON_UNICODE
-		  const size_t len = _string.length();
-		  #if defined(_MSC_VER) && defined(JSON_SAFE)
-			 const size_t bytes = (len * (sizeof(json_char) / sizeof(char))) + 1;
-			 json_auto<char> temp(bytes);
-			 size_t res;
-			 errno_t err = wcstombs_s(&res, temp.ptr, bytes, _string.c_str(), len);
-			 if (err != 0){
-				_value._number = (json_number)0.0;
-				return;
-			 }
-		  #elif defined(JSON_SAFE)
-			 const size_t bytes = (len * (sizeof(json_char) / sizeof(char))) + 1;
-			 json_auto<char> temp(bytes);
-			 size_t res = wcstombs(temp.ptr, _string.c_str(), len);
-			 if (res == -1){
-				_value._number = (json_number)0.0;
-				return;
-			 }
-		  #else
-			 json_auto<char> temp(len + 1);
-			 size_t res = wcstombs(temp.ptr, _string.c_str(), len);
-		  #endif
-		  temp.ptr[res] = '\0';
-		  _value._number = (json_number)atof(temp.ptr);
-	   #else
-		  _value._number = (json_number)atof(_string.c_str());
-	   #endif
-    #endif
+    const json_char * runner = _string.c_str();
+    json_number res;
+    if (json_unlikely(!NumberToString::_parse(runner, res))) res = (json_number)0.0;
+    _value._number = res;
 }
 
 #if !defined(JSON_PREPARSE) && defined(JSON_READ_PRIORITY)
@@ -243,12 +79,6 @@ void internalJSONNode::FetchNumber(void) const json_nothrow {
 		  case JSON_STRING:
 			 FetchString();
 			 break;
-		  case JSON_NODE:
-			 FetchNode();
-			 break;
-		  case JSON_ARRAY:
-			 FetchArray();
-			 break;
 		  case JSON_NUMBER:
 			 FetchNumber();
 			 break;
@@ -275,7 +105,7 @@ void internalJSONNode::Set(const json_string & val) json_nothrow {
 	   makeNotContainer();
 	   _type = JSON_NUMBER;
 	   _value._number = (json_number)val;
-	   _string = NumberToString::_itoa<json_int_t>(val);
+	   NumberToString::_itoa<json_int_t>(val, _string);
 	   SetFetched(true);
     }
 
@@ -283,7 +113,7 @@ void internalJSONNode::Set(const json_string & val) json_nothrow {
 	   makeNotContainer();
 	   _type = JSON_NUMBER;
 	   _value._number = val;
-	   _string = NumberToString::_ftoa(val);
+	   NumberToString::_ftoa(val, _string);
 	   SetFetched(true);
     }
 #else
@@ -292,7 +122,7 @@ void internalJSONNode::Set(const json_string & val) json_nothrow {
 		  makeNotContainer();\
 		  _type = JSON_NUMBER;\
 		  _value._number = (json_number)val;\
-		  _string = NumberToString::converter<type>(val);\
+		  NumberToString::converter<type>(val, _string);\
 		  SetFetched(true);\
 	   }
     #define SET_INTEGER(type) SET(_itoa, type) SET(_uitoa, unsigned type)
@@ -301,7 +131,7 @@ void internalJSONNode::Set(const json_string & val) json_nothrow {
 		  makeNotContainer();\
 		  _type = JSON_NUMBER;\
 		  _value._number = (json_number)val;\
-		  _string = NumberToString::_ftoa(_value._number);\
+		  NumberToString::_ftoa(_value._number, _string);\
 		  SetFetched(true);\
 	   }
 
@@ -329,7 +159,7 @@ void internalJSONNode::Set(bool val) json_nothrow {
 bool internalJSONNode::IsEqualTo(const internalJSONNode * val) const json_nothrow {
     if (this == val) return true;  //same internal object, so they must be equal (not only for ref counting)
     if (type() != val -> type()) return false;	 //aren't even same type
-    if (_name != val -> _name) return false;  //names aren't the same
+    if (nameref() != val -> nameref()) return false;  //names aren't the same
     if (type() == JSON_NULL) return true;  //both null, can't be different
     #if !defined(JSON_PREPARSE) && defined(JSON_READ_PRIORITY)
 	   Fetch();
@@ -387,6 +217,16 @@ void internalJSONNode::push_back(const JSONNode & node) json_nothrow {
     #endif
 }
 
+#if !defined(JSON_LIBRARY) && defined(JSON_RVALUE_REFS)
+    void internalJSONNode::push_back(JSONNode && node) json_nothrow {
+	   JSON_ASSERT_SAFE(isContainer(), JSON_TEXT("calling push_back on non-container type"), return;);
+	   #ifdef JSON_MUTEX_CALLBACKS
+		  if (mylock != 0) node.set_mutex(mylock);
+	   #endif
+	   CHILDREN -> push_back(json_move(node));
+    }
+#endif
+
 void internalJSONNode::push_front(const JSONNode & node) json_nothrow {
     JSON_ASSERT_SAFE(isContainer(), JSON_TEXT("calling at on non-container type"), return;);
     CHILDREN -> push_front(JSONNode::newJSONNode(node   JSON_MUTEX_COPY));
@@ -425,13 +265,34 @@ JSONNode * internalJSONNode::pop_back(const json_string & name_t) json_nothrow {
 JSONNode ** internalJSONNode::at(const json_string & name_t) json_nothrow {
     JSON_ASSERT_SAFE(isContainer(), JSON_TEXT("calling at on non-container type"), return 0;);
     Fetch();
-    json_foreach(CHILDREN, myrunner){
-	   JSON_ASSERT(*myrunner != NULL, JSON_TEXT("a null pointer within the children"));
-	   if (json_unlikely((*myrunner) -> name() == name_t)) return myrunner;
-    }
-    return 0;
+    #ifdef JSON_CHILDREN_INDEX
+	   return CHILDREN -> find(name_t);
+    #else
+	   json_foreach(CHILDREN, myrunner){
+		  JSON_ASSERT(*myrunner != NULL, JSON_TEXT("a null pointer within the children"));
+		  if (json_unlikely((*myrunner) -> internal -> nameref() == name_t)) return myrunner;
+	   }
+	   return 0;
+    #endif
 }
 
+#ifdef JSON_INTERNED_KEYS
+    JSONNode ** internalJSONNode::at(const json_key & key) json_nothrow {
+	   JSON_ASSERT_SAFE(isContainer(), JSON_TEXT("calling at (key) on non-container type"), return 0;);
+	   Fetch();
+	   #ifdef JSON_CHILDREN_INDEX
+		  if (CHILDREN -> size() >= JSON_CHILDREN_INDEX) return CHILDREN -> find(key.str());
+	   #endif
+	   json_foreach(CHILDREN, myrunner){
+		  JSON_ASSERT(*myrunner != NULL, JSON_TEXT("a null pointer within the children"));
+		  const internalJSONNode * child = (*myrunner) -> internal;
+		  if (json_unlikely(child -> _key == key.mystr)) return myrunner;  //interned names are only equal if they're the same one
+		  if (child -> _key == 0 && child -> _name == *key.mystr) return myrunner;
+	   }
+	   return 0;
+    }
+#endif
+
 #ifdef JSON_CASE_INSENSITIVE_FUNCTIONS
     bool internalJSONNode::AreEqualNoCase(const json_char * ch_one, const json_char * ch_two) json_nothrow {
 	   while (*ch_one){  //only need to check one, if the other one terminates early, the check will cause it to fail
@@ -458,7 +319,7 @@ JSONNode ** internalJSONNode::at(const json_string & name_t) json_nothrow {
 	   Fetch();
 	   json_foreach(CHILDREN, myrunner){
 		  JSON_ASSERT(*myrunner, JSON_TEXT("a null pointer within the children"));
-		  if (json_unlikely(AreEqualNoCase((*myrunner) -> name().c_str(), name_t.c_str()))) return myrunner;
+		  if (json_unlikely(AreEqualNoCase((*myrunner) -> internal -> nameref().c_str(), name_t.c_str()))) return myrunner;
 	   }
 	   return 0;
     }
@@ -669,7 +530,7 @@ internalJSONNode::operator bool() const json_nothrow {
 
 		  JSONNode str(JSON_NODE);
 		  str.set_name(JSON_TEXT("_name"));
-		  str.push_back(JSON_NEW(JSONNode(json_string(JSON_TEXT("value")), _name)));
+		  str.push_back(JSON_NEW(JSONNode(json_string(JSON_TEXT("value")), nameref())));
 		  str.push_back(JSON_NEW(JSONNode(JSON_TEXT("length"), _name.length())));
 		  str.push_back(JSON_NEW(JSONNode(JSON_TEXT("capactiy"), _name.capacity())));
 
@@ -4,6 +4,7 @@
 #include "JSONDebug.h"
 #include "JSONChildren.h"
 #include "JSONMemory.h"
+#include "JSONKeys.h"
 #ifdef JSON_DEBUG
     #include <climits>  //to check int value
 #endif
@@ -59,10 +60,17 @@ class JSONNode;  //forward declaration
 #endif
 
 #ifndef JSON_UNIT_TEST
-    #define incAllocCount() (void)0
-    #define decAllocCount() (void)0
-    #define incinternalAllocCount() (void)0
-    #define decinternalAllocCount() (void)0
+    #ifdef JSON_STATS
+	   #define incAllocCount() JSONStats::made(JSONStats::STAT_NODES)
+	   #define decAllocCount() JSONStats::gone(JSONStats::STAT_NODES)
+	   #define incinternalAllocCount() JSONStats::made(JSONStats::STAT_INTERNALS)
+	   #define decinternalAllocCount() JSONStats::gone(JSONStats::STAT_INTERNALS)
+    #else
+	   #define incAllocCount() (void)0
+	   #define decAllocCount() (void)0
+	   #define incinternalAllocCount() (void)0
+	   #define decinternalAllocCount() (void)0
+    #endif
 #endif
 
 #ifdef JSON_LESS_MEMORY
@@ -83,22 +91,20 @@ class JSONNode;  //forward declaration
     #define initializeChildren(x) ,CHILDREN(x)
 #endif
 
+#ifdef JSON_INTERNED_KEYS
+    #define initializeKey(x) ,_key(x)
+#else
+    #define initializeKey(x)
+#endif
+
 class internalJSONNode {
 public:
     internalJSONNode(char mytype = JSON_NULL) json_nothrow json_hot;
-    #ifdef JSON_READ_PRIORITY
-	   internalJSONNode(const json_string & unparsed) json_nothrow json_hot;
-	   internalJSONNode(const json_string & name_t, const json_string & value_t) json_nothrow json_read_priority;
-    #endif
     internalJSONNode(const internalJSONNode & orig) json_nothrow json_hot;
     internalJSONNode & operator = (const internalJSONNode &) json_nothrow json_hot;
     ~internalJSONNode(void) json_nothrow json_hot;
 
     static internalJSONNode * newInternal(char mytype = JSON_NULL) json_hot;
-    #ifdef JSON_READ_PRIORITY
-	   static internalJSONNode * newInternal(const json_string & unparsed) json_hot;
-	   static internalJSONNode * newInternal(const json_string & name_t, const json_string & value_t) json_hot;
-    #endif
     static internalJSONNode * newInternal(const internalJSONNode & orig) json_hot;  //not copyable, only by this class
     static void deleteInternal(internalJSONNode * ptr) json_nothrow json_hot;
 
@@ -107,7 +113,11 @@ public:
     unsigned char type(void) const json_nothrow json_read_priority;
 
     json_string name(void) const json_nothrow json_read_priority;
+    const json_string & nameref(void) const json_nothrow json_read_priority;  //without copying it
     void setname(const json_string & newname) json_nothrow json_write_priority;
+    #ifdef JSON_INTERNED_KEYS
+	   void setkey(const json_key & key) json_nothrow json_write_priority;
+    #endif
     #ifdef JSON_COMMENTS
 	   void setcomment(const json_string & comment) json_nothrow;
 	   json_string getcomment(void) const json_nothrow;
@@ -121,11 +131,19 @@ public:
 	   void push_back(JSONNode * node) json_nothrow;
     #else
 	   void push_back(const JSONNode & node) json_nothrow;
+	   #ifdef JSON_RVALUE_REFS
+		  void push_back(JSONNode && node) json_nothrow;
+	   #endif
+	   template <typename N, typename T>
+	   void emplace_back(const N & name_t, const T & value_t) json_nothrow;  //implemented in JSONNode.h
     #endif
     void reserve(json_index_t siz) json_nothrow;
     void push_front(const JSONNode & node) json_nothrow;
     JSONNode * pop_back(json_index_t pos) json_nothrow;
     JSONNode * pop_back(const json_string & name_t) json_nothrow;
+    #ifdef JSON_INTERNED_KEYS
+	   JSONNode ** at(const json_key & key) json_nothrow;
+    #endif
     #ifdef JSON_CASE_INSENSITIVE_FUNCTIONS
 	   JSONNode * pop_back_nocase(const json_string & name_t) json_nothrow;
     #endif
@@ -198,13 +216,15 @@ public:
     #endif
 
     #ifdef JSON_WRITE_PRIORITY
-	   json_string WriteName(bool formatted, bool arrayChild) const json_nothrow json_write_priority;
+	   void WriteName(bool formatted, bool arrayChild, json_string & output) const json_nothrow json_write_priority;
 	   #ifdef JSON_ARRAY_SIZE_ON_ONE_LINE
-		  json_string WriteChildrenOneLine(unsigned int indent) const json_nothrow json_write_priority;
+		  void WriteChildrenOneLine(unsigned int indent, json_string & output) const json_nothrow json_write_priority;
 	   #endif
-	   json_string WriteChildren(unsigned int indent) const json_nothrow json_write_priority;
-	   json_string WriteComment(unsigned int indent) const json_nothrow json_write_priority;
-	   json_string Write(unsigned int indent, bool arrayChild) const json_nothrow json_write_priority;
+	   void WriteChildren(unsigned int indent, json_string & output) const json_nothrow json_write_priority;
+	   void WriteComment(unsigned int indent, json_string & output) const json_nothrow json_write_priority;
+	   void Write(unsigned int indent, bool arrayChild, json_string & output) const json_nothrow json_write_priority;
+	   //never less than what Write appends, and the same for anything without comments
+	   size_t EstimatedWriteSize(unsigned int indent, bool arrayChild) const json_nothrow json_write_priority;
     #endif
 
 
@@ -237,8 +257,6 @@ public:
 
     #ifdef JSON_READ_PRIORITY
 	   void FetchString(void) const json_nothrow json_read_priority;
-	   void FetchNode(void) const json_nothrow json_read_priority;
-	   void FetchArray(void) const json_nothrow json_read_priority;
     #endif
     void FetchNumber(void) const json_nothrow json_read_priority;
 
@@ -248,6 +266,9 @@ public:
 
     inline void clearname(void) json_nothrow {
 	   clearString(_name);
+	   #ifdef JSON_INTERNED_KEYS
+		  _key = 0;
+	   #endif
     }
 
     #ifdef JSON_DEBUG
@@ -295,6 +316,10 @@ public:
     #ifndef JSON_LESS_MEMORY
 	   jsonChildren * CHILDREN;
     #endif
+
+    #ifdef JSON_INTERNED_KEYS
+	   const json_string * _key;  //an interned name, _name is left empty while this is set
+    #endif
 };
 
 inline internalJSONNode::internalJSONNode(char mytype) json_nothrow : _type(mytype), _name(), _name_encoded(), _string(), _string_encoded(), _value()
@@ -302,7 +327,8 @@ inline internalJSONNode::internalJSONNode(char mytype) json_nothrow : _type(myty
     initializeRefCount(1)
     initializeFetch(true)
     initializeComment(EMPTY_JSON_STRING)
-    initializeChildren((_type == JSON_NODE || _type == JSON_ARRAY) ? jsonChildren::newChildren() : 0){
+    initializeChildren((_type == JSON_NODE || _type == JSON_ARRAY) ? jsonChildren::newChildren() : 0)
+    initializeKey(0){
 
     incinternalAllocCount();
 
@@ -340,6 +366,13 @@ inline unsigned char internalJSONNode::type(void) const json_nothrow {
 }
 
 inline json_string internalJSONNode::name(void) const json_nothrow {
+    return nameref();
+}
+
+inline const json_string & internalJSONNode::nameref(void) const json_nothrow {
+    #ifdef JSON_INTERNED_KEYS
+	   if (_key != 0) return *_key;
+    #endif
     return _name;
 }
 
@@ -349,8 +382,20 @@ inline void internalJSONNode::setname(const json_string & newname) json_nothrow
     #endif
     _name = newname;
     _name_encoded = true;
+    #ifdef JSON_INTERNED_KEYS
+	   _key = 0;
+    #endif
 }
 
+#ifdef JSON_INTERNED_KEYS
+    inline void internalJSONNode::setkey(const json_key & key) json_nothrow {
+	   JSON_ASSERT(key.mystr != 0, JSON_TEXT("naming a node with an empty key"));
+	   clearString(_name);
+	   _name_encoded = true;
+	   _key = key.mystr;
+    }
+#endif
+
 #ifdef JSON_COMMENTS
     inline void internalJSONNode::setcomment(const json_string & comment) json_nothrow {
 	   #ifdef JSON_LESS_MEMORY
@@ -512,43 +557,25 @@ inline internalJSONNode::operator json_string() const json_nothrow {
 */
 
 inline void internalJSONNode::deleteInternal(internalJSONNode * ptr) json_nothrow {
-    #ifdef JSON_MEMORY_CALLBACKS
+    #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
 	   ptr -> ~internalJSONNode();
-	   libjson_free<internalJSONNode>(ptr);
+	   json_pool_free<internalJSONNode>(ptr, 1);
     #else
 	   delete ptr;
     #endif
 }
 
 inline internalJSONNode * internalJSONNode::newInternal(char mytype) {
-    #ifdef JSON_MEMORY_CALLBACKS
-	   return new(json_malloc<internalJSONNode>(1)) internalJSONNode(mytype);
+    #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
+	   return new(json_pool_malloc<internalJSONNode>(1)) internalJSONNode(mytype);
     #else
 	   return new internalJSONNode(mytype);
     #endif
 }
 
-#ifdef JSON_READ_PRIORITY
-inline internalJSONNode * internalJSONNode::newInternal(const json_string & unparsed) {
-    #ifdef JSON_MEMORY_CALLBACKS
-	   return new(json_malloc<internalJSONNode>(1)) internalJSONNode(unparsed);
-    #else
-	   return new internalJSONNode(unparsed);
-    #endif
-}
-
-inline internalJSONNode * internalJSONNode::newInternal(const json_string & name_t, const json_string & value_t) {
-    #ifdef JSON_MEMORY_CALLBACKS
-	   return new(json_malloc<internalJSONNode>(1)) internalJSONNode(name_t, value_t);
-    #else
-	   return new internalJSONNode(name_t, value_t);
-    #endif
-}
-#endif
-
 inline internalJSONNode * internalJSONNode::newInternal(const internalJSONNode & orig) {
-    #ifdef JSON_MEMORY_CALLBACKS
-	   return new(json_malloc<internalJSONNode>(1)) internalJSONNode(orig);
+    #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
+	   return new(json_pool_malloc<internalJSONNode>(1)) internalJSONNode(orig);
     #else
 	   return new internalJSONNode(orig);
     #endif
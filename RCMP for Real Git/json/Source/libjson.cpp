@@ -107,7 +107,7 @@
 	   #endif
 	   json_bool_t json_is_valid(json_const json_char * json){
 		  JSON_ASSERT_SAFE(json, JSON_TEXT("null ptr to json_is_valid"), return (json_bool_t)false;);
-		  return (json_bool_t)JSONValidator::isValidRoot(JSONWorker::RemoveWhiteSpaceAndComments(json).c_str());
+		  return (json_bool_t)JSONValidator::isValidDocument(json, json_strlen(json));
 	   }
 
 	   json_bool_t json_is_valid_unformatted(json_const json_char * json){
@@ -188,8 +188,8 @@
     JSONNODE * json_new_a(json_const json_char * name, json_const json_char * value){
 	   if (!name) name = EMPTY_CSTRING;
 	   JSON_ASSERT_SAFE(value, JSON_TEXT("null value to json_new_a"), value = EMPTY_CSTRING;);
-	   #ifdef JSON_MEMORY_CALLBACKS
-		  return MANAGER_INSERT(new(json_malloc<JSONNode>(1)) JSONNode(TOCONST_CSTR(name), json_string(TOCONST_CSTR(value))));
+	   #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
+		  return MANAGER_INSERT(new(json_pool_malloc<JSONNode>(1)) JSONNode(TOCONST_CSTR(name), json_string(TOCONST_CSTR(value))));
 	   #else
 		  return MANAGER_INSERT(new JSONNode(TOCONST_CSTR(name), json_string(TOCONST_CSTR(value))));
 	   #endif
@@ -197,8 +197,8 @@
 
     JSONNODE * json_new_i(json_const json_char * name, json_int_t value){
 	   if (!name) name = EMPTY_CSTRING;
-	   #ifdef JSON_MEMORY_CALLBACKS
-		  return MANAGER_INSERT(new(json_malloc<JSONNode>(1)) JSONNode(TOCONST_CSTR(name), value));
+	   #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
+		  return MANAGER_INSERT(new(json_pool_malloc<JSONNode>(1)) JSONNode(TOCONST_CSTR(name), value));
 	   #else
 		  return MANAGER_INSERT(new JSONNode(TOCONST_CSTR(name), value));
 	   #endif
@@ -206,8 +206,8 @@
 
     JSONNODE * json_new_f(json_const json_char * name, json_number value){
 	   if (!name) name = EMPTY_CSTRING;
-	   #ifdef JSON_MEMORY_CALLBACKS
-		  return MANAGER_INSERT(new(json_malloc<JSONNode>(1)) JSONNode(TOCONST_CSTR(name), value));
+	   #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
+		  return MANAGER_INSERT(new(json_pool_malloc<JSONNode>(1)) JSONNode(TOCONST_CSTR(name), value));
 	   #else
 		  return MANAGER_INSERT(new JSONNode(TOCONST_CSTR(name), value));
 	   #endif
@@ -215,16 +215,16 @@
 
     JSONNODE * json_new_b(json_const json_char * name, json_bool_t value){
 	   if (!name) name = EMPTY_CSTRING;
-	   #ifdef JSON_MEMORY_CALLBACKS
-		  return MANAGER_INSERT(new(json_malloc<JSONNode>(1)) JSONNode(TOCONST_CSTR(name), static_cast<bool>(value)));
+	   #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
+		  return MANAGER_INSERT(new(json_pool_malloc<JSONNode>(1)) JSONNode(TOCONST_CSTR(name), static_cast<bool>(value)));
 	   #else
 		  return MANAGER_INSERT(new JSONNode(TOCONST_CSTR(name), static_cast<bool>(value)));
 	   #endif
     }
 
     JSONNODE * json_new(char type){
-	   #ifdef JSON_MEMORY_CALLBACKS
-		  return MANAGER_INSERT(new(json_malloc<JSONNode>(1)) JSONNode(type));
+	   #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
+		  return MANAGER_INSERT(new(json_pool_malloc<JSONNode>(1)) JSONNode(type));
 	   #else
 		  return MANAGER_INSERT(new JSONNode(type));
 	   #endif
@@ -232,8 +232,8 @@
 
     JSONNODE * json_copy(json_const JSONNODE * orig){
 	   JSON_ASSERT_SAFE(orig, JSON_TEXT("null orig to json_copy"), return 0;);
-	   #ifdef JSON_MEMORY_CALLBACKS
-		  return MANAGER_INSERT(new(json_malloc<JSONNode>(1)) JSONNode(*((JSONNode*)orig)));
+	   #if defined(JSON_MEMORY_CALLBACKS) || defined(JSON_MEMORY_POOL)
+		  return MANAGER_INSERT(new(json_pool_malloc<JSONNode>(1)) JSONNode(*((JSONNode*)orig)));
 	   #else
 		  return MANAGER_INSERT(new JSONNode(*((JSONNode*)orig)));
 	   #endif
@@ -173,6 +173,7 @@
     #include "Source/JSONWorker.h"
     #include "Source/JSONValidator.h"
     #include "Source/JSONStream.h"
+    #include "Source/JSONDocument.h"
     #ifdef JSON_EXPOSE_BASE64
 	   #include "Source/JSON_Base64.h"
     #endif
@@ -203,7 +204,7 @@
 
 		  #ifdef JSON_VALIDATE
 			 inline static bool is_valid(const json_string & json) json_nothrow {
-				return JSONValidator::isValidRoot(JSONWorker::RemoveWhiteSpaceAndComments(json).c_str());
+				return JSONValidator::isValidDocument(json.data(), json.length());
 			 }
 
 			 inline static bool is_valid_unformatted(const json_string & json) json_nothrow {
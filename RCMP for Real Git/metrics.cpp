@@ -0,0 +1,376 @@
+//
+//  metrics.cpp
+//  RCMP for Real Git
+//
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#include "metrics.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+bool metrics_enabled = false;
+
+
+// upper bounds in seconds, there's one more bucket for everything past the last
+static const double bucket_bounds[] =
+{
+	0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+#define BUCKET_COUNT (sizeof(bucket_bounds) / sizeof(bucket_bounds[0]) + 1)
+
+
+/*!
+ \brief latencies, counted into buckets
+ */
+struct histogram
+{
+	uint64_t buckets[BUCKET_COUNT];	// each on its own, they're added up when written
+	uint64_t count;
+	double sum;
+
+	histogram() : count(0), sum(0) { memset(buckets, 0, sizeof(buckets)); }
+
+	void add(uint64_t ns)
+	{
+		double seconds = ns / 1e9;
+		size_t bucket = 0;
+
+		while(bucket < BUCKET_COUNT - 1 && seconds > bucket_bounds[bucket])
+			bucket++;
+		buckets[bucket]++;
+		count++;
+		sum += seconds;
+	}
+};
+
+
+/*!
+ \brief what was counted for one URL
+ */
+struct endpoint_metrics
+{
+	uint64_t raw_bytes;
+	uint64_t encoded_bytes;
+	uint64_t failures;
+	histogram upload;
+
+	endpoint_metrics() : raw_bytes(0), encoded_bytes(0), failures(0) {}
+};
+
+
+/*!
+ \brief every series in the file, in the order they were first seen
+ */
+struct series_set
+{
+	vector<string> keys;
+	vector<double> values;
+	map<string, size_t> index;
+
+	void add(const string &key, double value)
+	{
+		map<string, size_t>::iterator found = index.find(key);
+		if(found != index.end())
+		{
+			values[found->second] += value;
+			return;
+		}
+		index[key] = keys.size();
+		keys.push_back(key);
+		values.push_back(value);
+	}
+};
+
+
+/*!
+ \brief a metric as it's described in the file
+ */
+struct family
+{
+	const char *name;
+	const char *type;
+	const char *help;
+};
+
+
+static const family families[] =
+{
+	{ "rcmp_runs_total", "counter", "Hook runs." },
+	{ "rcmp_payloads_built_total", "counter", "Payloads built, one for each ref." },
+	{ "rcmp_payload_failures_total", "counter", "Refs whose payload couldn't be built." },
+	{ "rcmp_payload_build_seconds", "histogram", "Time to build a payload, from opening the repository on." },
+	{ "rcmp_commits_walked_total", "counter", "Commits walked while building payloads." },
+	{ "rcmp_diffs_total", "counter", "Commits diffed against the one before them." },
+	{ "rcmp_upload_bytes_total", "counter", "Bytes sent to each URL, as JSON and as the form they were encoded to." },
+	{ "rcmp_upload_seconds", "histogram", "Time to upload a payload to each URL." },
+	{ "rcmp_upload_failures_total", "counter", "Uploads that got nothing back." }
+};
+#define FAMILY_COUNT (sizeof(families) / sizeof(families[0]))
+
+
+static string metrics_path;
+static uint64_t payloads;
+static uint64_t payload_failures;
+static uint64_t commits_walked;
+static uint64_t diffs_done;
+static histogram payload_build;
+static vector<endpoint_metrics> endpoint_counts;
+static vector<string> endpoint_names;
+
+
+void metrics_start(const char * const *endpoints, size_t count)
+{
+	const char *path = getenv("RCMP_METRICS_FILE");
+
+	if(path == NULL || *path == '\0') return;
+
+	metrics_path = path;
+	endpoint_names.assign(endpoints, endpoints + count);
+	endpoint_counts.assign(count, endpoint_metrics());
+	metrics_enabled = true;
+}
+
+
+void metrics_payload(uint64_t ns, size_t commits, size_t diffs)
+{
+	if(!metrics_enabled) return;
+
+	payloads++;
+	commits_walked += commits;
+	diffs_done += diffs;
+	payload_build.add(ns);
+}
+
+
+void metrics_payload_failed(void)
+{
+	if(!metrics_enabled) return;
+
+	payload_failures++;
+}
+
+
+void metrics_upload(int endpoint, size_t raw, size_t encoded, uint64_t ns, bool answered)
+{
+	if(!metrics_enabled || endpoint < 0 || (size_t)endpoint >= endpoint_counts.size()) return;
+
+	endpoint_metrics &counts = endpoint_counts[endpoint];
+	counts.raw_bytes += raw;
+	counts.encoded_bytes += encoded;
+	counts.upload.add(ns);
+	if(!answered) counts.failures++;
+}
+
+
+/*!
+ \brief read what earlier runs wrote
+ \param all		where the series go
+
+ Anything that isn't a series is skipped, the descriptions are written fresh.
+ */
+static void read_metrics(series_set &all)
+{
+	FILE *file = fopen(metrics_path.c_str(), "r");
+	char *line = NULL;
+	size_t room = 0;
+	ssize_t length;
+
+	if(file == NULL) return;
+
+	while((length = getline(&line, &room, file)) != -1)
+	{
+		if(length > 0 && line[length - 1] == '\n') line[--length] = '\0';
+		if(length == 0 || line[0] == '#') continue;
+
+		char *space = strrchr(line, ' ');
+		if(space == NULL) continue;
+
+		char *end;
+		double value = strtod(space + 1, &end);
+		if(end == space + 1 || *end != '\0') continue;
+
+		all.add(string(line, space - line), value);
+	}
+
+	free(line);
+	fclose(file);
+}
+
+
+/*!
+ \brief a label's value, quoted the way Prometheus wants it
+ */
+static string label(const char *name, const string &value)
+{
+	string res(name);
+
+	res += "=\"";
+	for(size_t i = 0; i < value.length(); i++)
+	{
+		if(value[i] == '\\' || value[i] == '"')
+			res += '\\';
+		else if(value[i] == '\n')
+		{
+			res += "\\n";
+			continue;
+		}
+		res += value[i];
+	}
+	res += '"';
+	return res;
+}
+
+
+/*!
+ \brief add a histogram's series, buckets counting everything at or below them
+ \param all		where they go
+ \param name		the metric
+ \param labels	any labels besides le, comma separated
+ \param counted	the histogram
+ */
+static void add_histogram(series_set &all, const string &name, const string &labels, const histogram &counted)
+{
+	string prefix = labels.empty() ? "{" : "{" + labels + ",";
+	uint64_t below = 0;
+	char bound[32];
+
+	for(size_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+	{
+		if(bucket < BUCKET_COUNT - 1)
+			snprintf(bound, sizeof(bound), "%g", bucket_bounds[bucket]);
+		else
+			strcpy(bound, "+Inf");
+		below += counted.buckets[bucket];
+		all.add(name + "_bucket" + prefix + "le=\"" + bound + "\"}", below);
+	}
+
+	string suffix = labels.empty() ? "" : "{" + labels + "}";
+	all.add(name + "_sum" + suffix, counted.sum);
+	all.add(name + "_count" + suffix, counted.count);
+}
+
+
+/*!
+ \brief which family a series belongs to, or -1 if it isn't one of them
+ */
+static int family_of(const string &key)
+{
+	string name = key.substr(0, key.find('{'));
+
+	for(size_t which = 0; which < FAMILY_COUNT; which++)
+	{
+		string family_name = families[which].name;
+		if(name == family_name) return which;
+		if(strcmp(families[which].type, "histogram") != 0) continue;
+		if(name == family_name + "_bucket" || name == family_name + "_sum" || name == family_name + "_count")
+			return which;
+	}
+
+	return -1;
+}
+
+
+/*!
+ \brief write the metrics next to the file, then move them over it
+
+ Whatever reads the file sees either the last run's metrics or this one's,
+ never half of them.
+ */
+static void write_metrics(const series_set &all)
+{
+	string temp = metrics_path + ".tmp";
+	FILE *file = fopen(temp.c_str(), "w");
+	vector<int> family(all.keys.size());
+	char value[64];
+
+	if(file == NULL)
+	{
+		perror("can't write metrics");
+		return;
+	}
+
+	for(size_t series = 0; series < all.keys.size(); series++)
+		family[series] = family_of(all.keys[series]);
+
+	// series of a family have to be together, ones from an older version go last
+	for(int which = 0; which <= (int)FAMILY_COUNT; which++)
+	{
+		int wanted = which < (int)FAMILY_COUNT ? which : -1;
+		bool described = wanted == -1;
+
+		for(size_t series = 0; series < all.keys.size(); series++)
+		{
+			if(family[series] != wanted) continue;
+			if(!described)
+			{
+				fprintf(file, "# HELP %s %s\n# TYPE %s %s\n",
+					families[which].name, families[which].help,
+					families[which].name, families[which].type);
+				described = true;
+			}
+			snprintf(value, sizeof(value), "%.15g", all.values[series]);
+			fprintf(file, "%s %s\n", all.keys[series].c_str(), value);
+		}
+	}
+
+	if(fclose(file) != 0 || rename(temp.c_str(), metrics_path.c_str()) != 0)
+	{
+		perror("can't write metrics");
+		unlink(temp.c_str());
+	}
+}
+
+
+void metrics_finish(void)
+{
+	if(!metrics_enabled) return;
+
+	// hooks for different pushes can finish at once, each has to add to what the last one wrote
+	string lock_path = metrics_path + ".lock";
+	int lock = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+	if(lock == -1 || flock(lock, LOCK_EX) == -1)
+		perror("can't lock metrics");
+	else
+	{
+		series_set all;
+
+		read_metrics(all);
+
+		all.add("rcmp_runs_total", 1);
+		all.add("rcmp_payloads_built_total", payloads);
+		all.add("rcmp_payload_failures_total", payload_failures);
+		add_histogram(all, "rcmp_payload_build_seconds", "", payload_build);
+		all.add("rcmp_commits_walked_total", commits_walked);
+		all.add("rcmp_diffs_total", diffs_done);
+
+		for(size_t endpoint = 0; endpoint < endpoint_counts.size(); endpoint++)
+		{
+			const endpoint_metrics &counts = endpoint_counts[endpoint];
+			string url = label("endpoint", endpoint_names[endpoint]);
+
+			all.add("rcmp_upload_bytes_total{" + url + ",encoding=\"raw\"}", counts.raw_bytes);
+			all.add("rcmp_upload_bytes_total{" + url + ",encoding=\"encoded\"}", counts.encoded_bytes);
+			add_histogram(all, "rcmp_upload_seconds", url, counts.upload);
+			all.add("rcmp_upload_failures_total{" + url + "}", counts.failures);
+		}
+
+		write_metrics(all);
+	}
+	if(lock != -1) close(lock);
+
+	metrics_enabled = false;
+	payloads = payload_failures = commits_walked = diffs_done = 0;
+	payload_build = histogram();
+	endpoint_counts.clear();
+	endpoint_names.clear();
+}
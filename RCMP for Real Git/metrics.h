@@ -0,0 +1,67 @@
+//
+//  metrics.h
+//  RCMP for Real Git
+//
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#ifndef __rcmp_metrics_h_
+#define __rcmp_metrics_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*!
+ \brief whether metrics are being kept
+
+ Only set by metrics_start, so that a run without a metrics file pays for one
+ branch per count and never reads the clock for it.
+ */
+extern bool metrics_enabled;
+
+
+/*!
+ \brief turn metrics on if they were asked for
+ \param endpoints	the URLs, endpoint indices count from the first one
+ \param count		how many there are
+
+ Metrics are on when RCMP_METRICS_FILE names a file.  Every run adds what it
+ counted to what is already there and writes it back in Prometheus' text
+ format, so node_exporter's textfile collector can pick it up.
+ */
+void metrics_start(const char * const *endpoints, size_t count);
+
+
+/*!
+ \brief count a payload that was built
+ \param ns		how long it took, from opening the repository on
+ \param commits	how many commits were walked
+ \param diffs		how many of them were diffed
+ */
+void metrics_payload(uint64_t ns, size_t commits, size_t diffs);
+
+
+/*!
+ \brief count a payload that couldn't be built
+ */
+void metrics_payload_failed(void);
+
+
+/*!
+ \brief count an upload to one URL
+ \param endpoint	which URL it was
+ \param raw		how long the JSON was
+ \param encoded	how long the form it was sent as was
+ \param ns		how long the upload took
+ \param answered	whether anything came back
+ */
+void metrics_upload(int endpoint, size_t raw, size_t encoded, uint64_t ns, bool answered);
+
+
+/*!
+ \brief add everything that was counted to the metrics file
+ */
+void metrics_finish(void);
+
+#endif
@@ -0,0 +1,235 @@
+//
+//  replay.cpp
+//  RCMP for Real Git
+//
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#include "replay.h"
+#include "git_hook.h"
+#include "timing.h"
+#include <libAmy/libAmy.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+/*!
+ \brief one push from the log
+ */
+struct recorded_push
+{
+	string path;
+	string old_id;
+	string new_id;
+	string ref;
+};
+
+
+/*!
+ \brief read the pushes to replay
+ \param log		the file, or - for stdin
+ \param pushes	where they go
+ 
+ The path comes first and can have spaces in it, but IDs and ref names can't,
+ so each line is split from the end.  Blank lines and ones starting with # are
+ skipped, and ones that can't be split are skipped with a warning.
+ */
+static bool read_log(const char *log, vector<recorded_push> &pushes)
+{
+	FILE *file = strcmp(log, "-") == 0 ? stdin : fopen(log, "r");
+	char *line = NULL;
+	size_t room = 0, number = 0;
+	ssize_t length;
+	
+	if(file == NULL)
+	{
+		perror("can't open replay log");
+		return false;
+	}
+	
+	while((length = getline(&line, &room, file)) != -1)
+	{
+		number++;
+		while(length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+			line[--length] = '\0';
+		if(length == 0 || line[0] == '#') continue;
+		
+		char *fields[3], *space;
+		int found = 0;
+		while(found < 3 && (space = strrchr(line, ' ')) != NULL)
+		{
+			*space = '\0';
+			fields[2 - found++] = space + 1;
+		}
+		
+		if(found < 3 || *line == '\0')
+		{
+			fprintf(stderr, "%s:%lu: expected a path, two IDs and a ref\n", log, (unsigned long)number);
+			continue;
+		}
+		
+		recorded_push push;
+		push.path = line;
+		push.old_id = fields[0];
+		push.new_id = fields[1];
+		push.ref = fields[2];
+		pushes.push_back(push);
+	}
+	
+	free(line);
+	if(file != stdin) fclose(file);
+	return true;
+}
+
+
+/*!
+ \brief wait for the clock to get to a time
+ */
+static void sleep_until(uint64_t when)
+{
+	uint64_t now;
+	
+	while((now = timing_now()) < when)
+	{
+		struct timespec wait;
+		wait.tv_sec = (when - now) / 1000000000;
+		wait.tv_nsec = (when - now) % 1000000000;
+		nanosleep(&wait, NULL);
+	}
+}
+
+
+/*!
+ \brief the latency below which the given share of the pushes finished
+ */
+static double percentile(const vector<double> &sorted, double share)
+{
+	size_t rank = (size_t)(share * sorted.size() + 0.999999);
+	if(rank == 0) rank = 1;
+	return sorted[min(rank, sorted.size()) - 1];
+}
+
+
+int replay(const char *log, double rate, const char *output, const char * const *endpoints,
+	   size_t count)
+{
+	vector<recorded_push> pushes;
+	vector<WTConnection *> conns;
+	vector<double> latencies;
+	size_t failed = 0, commits = 0, sent = 0;
+	uint64_t written = 0;
+	FILE *payloads = NULL;
+	
+	if(!read_log(log, pushes)) return 1;
+	if(pushes.empty())
+	{
+		fprintf(stderr, "%s has no pushes in it\n", log);
+		return 1;
+	}
+	
+	if(output != NULL)
+	{
+		payloads = strcmp(output, "-") == 0 ? stdout : fopen(output, "w");
+		if(payloads == NULL)
+		{
+			perror("can't open replay output");
+			return 1;
+		}
+	}
+	
+	for(size_t url = 0; url < count; url++)
+	{
+		trace_span connecting("connect", endpoints[url]);
+		WTConnection *conn = new WTConnection(NULL);
+		conn->connect(endpoints[url]);
+		conns.push_back(conn);
+	}
+	
+	JSONArena arena;
+	JSONArena::scope payload_arena(arena);
+	
+	uint64_t interval = rate > 0 ? (uint64_t)(1e9 / rate) : 0;
+	uint64_t started = timing_now();
+	for(size_t next = 0; next < pushes.size(); next++)
+	{
+		const recorded_push &push = pushes[next];
+		uint64_t due = started + next * interval;
+		
+		if(interval != 0)
+			sleep_until(due);
+		else
+			due = timing_now();
+		
+		trace_span handling("ref", push.ref.c_str());
+		timing_ref(push.ref.c_str());
+		JSONNode *node = git_hook_main(push.path.c_str(), push.old_id.c_str(), push.new_id.c_str(),
+					       push.ref.c_str());
+		if(node == NULL)
+		{
+			failed++;
+			continue;
+		}
+		
+		bool delivered = true;
+		if(payloads != NULL)
+		{
+			json_string json = node->write();
+			written += json.length();
+			fputs(json.c_str(), payloads);
+			delivered = fputc('\n', payloads) != EOF;
+		}
+		for(size_t next_conn = 0; next_conn < conns.size(); next_conn++)
+			if(!git_hook_send(conns[next_conn], node, (int)next_conn, endpoints[next_conn], &sent))
+				delivered = false;
+		
+		commits += node->at("commits").size();
+		delete node;
+		arena.release();
+		
+		if(!delivered) failed++;
+		latencies.push_back((timing_now() - due) / 1e9);
+	}
+	double elapsed = (timing_now() - started) / 1e9;
+	
+	while(conns.size() > 0)
+	{
+		conns.back()->disconnect();
+		delete conns.back();
+		conns.pop_back();
+	}
+	if(payloads != NULL && payloads != stdout && fclose(payloads) != 0)
+	{
+		perror("can't write replay output");
+		failed = pushes.size();
+	}
+	
+	// the payloads might be on stdout already
+	FILE *report = payloads == stdout ? stderr : stdout;
+	fprintf(report, "pushes      %lu, %lu failed\n", (unsigned long)pushes.size(), (unsigned long)failed);
+	fprintf(report, "commits     %lu\n", (unsigned long)commits);
+	if(count > 0)
+		fprintf(report, "sent        %lu bytes\n", (unsigned long)sent);
+	if(payloads != NULL)
+		fprintf(report, "written     %llu bytes\n", (unsigned long long)written);
+	if(rate > 0)
+		fprintf(report, "offered     %.1f pushes/s\n", rate);
+	fprintf(report, "elapsed     %.3f s\n", elapsed);
+	fprintf(report, "throughput  %.1f pushes/s, %.0f commits/s, %.2f MB/s\n",
+		pushes.size() / elapsed, commits / elapsed, (sent + written) / elapsed / 1e6);
+	
+	if(!latencies.empty())
+	{
+		sort(latencies.begin(), latencies.end());
+		fprintf(report, "latency     p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+			percentile(latencies, 0.50) * 1000, percentile(latencies, 0.90) * 1000,
+			percentile(latencies, 0.99) * 1000, latencies.back() * 1000);
+	}
+	
+	return failed ? 1 : 0;
+}
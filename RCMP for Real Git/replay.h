@@ -0,0 +1,33 @@
+//
+//  replay.h
+//  RCMP for Real Git
+//
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#ifndef __rcmp_replay_h_
+#define __rcmp_replay_h_
+
+#include <stddef.h>
+
+
+/*!
+ \brief run recorded pushes through the hook again and report how it went
+ \param log		the pushes, one per line as "path old-sha1 new-sha1 refname",
+			or - for stdin
+ \param rate		pushes to start each second, or 0 for as fast as they go
+ \param output		a file to write each payload to as a line of JSON, - for
+			stdout, or NULL
+ \param endpoints	the URLs to send each payload to
+ \param count		how many there are
+ \returns 0 if every push was built and sent, 1 if any weren't
+ 
+ Each push is built and sent exactly the way the hook does it, over
+ connections that are kept open for the whole replay.  Latency is counted from
+ when a push was due to start, so at a fixed rate it includes any time spent
+ waiting for the pushes before it.
+ */
+int replay(const char *log, double rate, const char *output, const char * const *endpoints,
+	   size_t count);
+
+#endif
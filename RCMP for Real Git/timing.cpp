@@ -0,0 +1,420 @@
+//
+//  timing.cpp
+//  RCMP for Real Git
+//
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#include "timing.h"
+#include "config.h"
+#include "json/libjson.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#	include <sys/syscall.h>
+#elif defined(__APPLE__)
+#	include <pthread.h>
+#endif
+
+#if defined(HAVE_CLOCK_GETTIME)
+#	include <time.h>
+#elif defined(__APPLE__)
+#	include <mach/mach_time.h>
+#else
+#	include <sys/time.h>
+#endif
+using namespace std;
+
+
+bool timing_enabled = false;
+bool trace_enabled = false;
+
+
+/*!
+ \brief what was counted for one ref or one URL
+ */
+struct phase_totals
+{
+	string name;
+	uint64_t ns[PHASE_COUNT];
+	uint64_t count[PHASE_COUNT];
+#ifdef JSON_STATS
+	json_stats json;	// peaks and what was allocated while the ref was handled, nothing that was alive
+#endif
+
+	phase_totals()
+	{
+		memset(ns, 0, sizeof(ns));
+		memset(count, 0, sizeof(count));
+#ifdef JSON_STATS
+		memset(&json, 0, sizeof(json));
+#endif
+	}
+};
+
+
+static const char *phase_names[PHASE_COUNT] =
+{
+	"repo_open", "revwalk", "diff", "json", "write", "urlencode", "upload"
+};
+
+static int timing_fd = -1;
+static bool timing_fd_owned = false;
+static uint64_t run_start;
+static vector<phase_totals> ref_totals;
+static vector<phase_totals> endpoint_totals;
+static vector<string> endpoint_names;
+static FILE *trace_file = NULL;
+#ifdef JSON_STATS
+static json_stats ref_start;
+#endif
+
+
+uint64_t timing_now(void)
+{
+#if defined(HAVE_CLOCK_GETTIME)
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#elif defined(__APPLE__)
+	static mach_timebase_info_data_t base;
+	if(base.denom == 0) mach_timebase_info(&base);
+	return mach_absolute_time() * base.numer / base.denom;
+#else
+	// not monotonic, but the best there is
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_usec * 1000;
+#endif
+}
+
+
+/*!
+ \brief open the log named by RCMP_TIMING_LOG or RCMP_TIMING_FD
+ */
+static bool open_timing_log(void)
+{
+	const char *log = getenv("RCMP_TIMING_LOG");
+	const char *fd = getenv("RCMP_TIMING_FD");
+
+	if(log != NULL && *log != '\0')
+	{
+		timing_fd = open(log, O_WRONLY | O_APPEND | O_CREAT, 0644);
+		if(timing_fd == -1)
+		{
+			perror("can't open timing log");
+			return false;
+		}
+		timing_fd_owned = true;
+		return true;
+	}
+	else if(fd != NULL && *fd != '\0')
+	{
+		char *end;
+		long number = strtol(fd, &end, 10);
+		if(*end != '\0' || number < 0 || fcntl((int)number, F_GETFD) == -1)
+		{
+			fprintf(stderr, "RCMP_TIMING_FD is not an open descriptor\n");
+			return false;
+		}
+		timing_fd = (int)number;
+		return true;
+	}
+
+	return false;
+}
+
+
+/*!
+ \brief the thread's ID as the system knows it, so traces from threads line up
+ */
+static long thread_id(void)
+{
+#if defined(__linux__)
+	return (long)syscall(SYS_gettid);
+#elif defined(__APPLE__)
+	uint64_t id;
+	pthread_threadid_np(NULL, &id);
+	return (long)id;
+#else
+	return 0;
+#endif
+}
+
+
+/*!
+ \brief start the trace named by RCMP_TRACE
+
+ Events are written as they happen through stdio's buffer, so the trace never
+ has to be held in memory and writing it costs little more than the copy.
+ */
+static bool open_trace(void)
+{
+	const char *trace = getenv("RCMP_TRACE");
+
+	if(trace == NULL || *trace == '\0') return false;
+
+	trace_file = fopen(trace, "w");
+	if(trace_file == NULL)
+	{
+		perror("can't open trace");
+		return false;
+	}
+
+	setvbuf(trace_file, NULL, _IOFBF, 65536);
+	fprintf(trace_file, "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"args\":{\"name\":\"real-git-rcmp\"}}",
+		(long)getpid());
+	return true;
+}
+
+
+void timing_start(const char * const *endpoints, size_t count)
+{
+	bool logging = open_timing_log();
+
+	trace_enabled = open_trace();
+	timing_enabled = logging || trace_enabled;
+	if(!timing_enabled) return;
+
+	endpoint_names.assign(endpoints, endpoints + count);
+	run_start = timing_now();
+}
+
+
+/*!
+ \brief count what libjson did since the last ref started against that ref
+ */
+static void finish_ref(void)
+{
+#ifdef JSON_STATS
+	if(ref_totals.empty()) return;
+
+	json_stats now = JSONStats::thread();
+	json_stats &json = ref_totals.back().json;
+	json.peak_nodes = now.peak_nodes;
+	json.peak_internals = now.peak_internals;
+	json.peak_children = now.peak_children;
+	json.allocations = now.allocations - ref_start.allocations;
+	json.bytes = now.bytes - ref_start.bytes;
+#endif
+}
+
+
+void timing_ref(const char *ref_name)
+{
+	if(timing_fd == -1) return;
+
+	finish_ref();
+	ref_totals.push_back(phase_totals());
+	ref_totals.back().name.assign(ref_name, strcspn(ref_name, "\n"));
+
+#ifdef JSON_STATS
+	// the hook builds one tree per ref, so the peaks are what that tree took
+	JSONStats::resetPeaks();
+	ref_start = JSONStats::thread();
+#endif
+}
+
+
+void timing_add(timing_phase phase, uint64_t start, uint64_t end, int endpoint)
+{
+	if(!timing_enabled) return;
+
+	if(trace_enabled)
+		trace_add(phase_names[phase], start, end, endpoint < 0 ? NULL : endpoint_names[endpoint].c_str());
+	if(timing_fd == -1) return;
+
+	uint64_t ns = end - start;
+	if(ref_totals.empty()) ref_totals.push_back(phase_totals());
+	ref_totals.back().ns[phase] += ns;
+	ref_totals.back().count[phase]++;
+
+	if(endpoint < 0) return;
+	if(endpoint_totals.size() <= (size_t)endpoint) endpoint_totals.resize(endpoint + 1);
+	endpoint_totals[endpoint].ns[phase] += ns;
+	endpoint_totals[endpoint].count[phase]++;
+}
+
+
+/*!
+ \brief add a string to the line, quoted the way JSON wants it
+ */
+static void append_quoted(string &line, const string &value)
+{
+	line += '"';
+	for(size_t i = 0; i < value.length(); i++)
+	{
+		unsigned char c = value[i];
+		if(c == '"' || c == '\\')
+		{
+			line += '\\';
+			line += c;
+		}
+		else if(c < 0x20)
+		{
+			char escaped[7];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			line += escaped;
+		}
+		else
+			line += c;
+	}
+	line += '"';
+}
+
+
+void trace_add(const char *name, uint64_t start, uint64_t end, const char *detail)
+{
+	if(!trace_enabled) return;
+
+	// complete events, in microseconds, the process name always comes first
+	char event[256];
+	snprintf(event, sizeof(event), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":%ld,\"tid\":%ld",
+		 name,
+		 (unsigned long long)(start / 1000), (unsigned)(start % 1000),
+		 (unsigned long long)((end - start) / 1000), (unsigned)((end - start) % 1000),
+		 (long)getpid(), thread_id());
+	fputs(event, trace_file);
+
+	if(detail != NULL)
+	{
+		string args(",\"args\":{\"detail\":");
+		append_quoted(args, detail);
+		args += '}';
+		fputs(args.c_str(), trace_file);
+	}
+	fputc('}', trace_file);
+}
+
+
+/*!
+ \brief add every phase that was counted, as "phase":{"ns":...,"count":...}
+ */
+static void append_phases(string &line, const phase_totals &totals)
+{
+	char number[64];
+	bool first = true;
+
+	for(int phase = 0; phase < PHASE_COUNT; phase++)
+	{
+		if(totals.count[phase] == 0) continue;
+		snprintf(number, sizeof(number), "%s\"%s\":{\"ns\":%llu,\"count\":%llu}",
+			 first ? "" : ",", phase_names[phase],
+			 (unsigned long long)totals.ns[phase],
+			 (unsigned long long)totals.count[phase]);
+		line += number;
+		first = false;
+	}
+}
+
+
+#ifdef JSON_STATS
+/*!
+ \brief add what libjson did, as "json":{...}
+ */
+static void append_json_stats(string &line, const json_stats &json)
+{
+	char number[192];
+	snprintf(number, sizeof(number), ",\"json\":{\"peak_nodes\":%ld,\"peak_internals\":%ld,\"peak_children\":%ld,\"allocations\":%llu,\"bytes\":%llu}",
+		 (long)json.peak_nodes, (long)json.peak_internals, (long)json.peak_children,
+		 (unsigned long long)json.allocations, (unsigned long long)json.bytes);
+	line += number;
+}
+#endif
+
+
+/*!
+ \brief write the timing line
+ */
+static void write_timing_log(void)
+{
+	phase_totals all;
+	char number[64];
+	string line;
+
+	finish_ref();
+	for(size_t ref = 0; ref < ref_totals.size(); ref++)
+	{
+		for(int phase = 0; phase < PHASE_COUNT; phase++)
+		{
+			all.ns[phase] += ref_totals[ref].ns[phase];
+			all.count[phase] += ref_totals[ref].count[phase];
+		}
+#ifdef JSON_STATS
+		const json_stats &json = ref_totals[ref].json;
+		if(json.peak_nodes > all.json.peak_nodes) all.json.peak_nodes = json.peak_nodes;
+		if(json.peak_internals > all.json.peak_internals) all.json.peak_internals = json.peak_internals;
+		if(json.peak_children > all.json.peak_children) all.json.peak_children = json.peak_children;
+		all.json.allocations += json.allocations;
+		all.json.bytes += json.bytes;
+#endif
+	}
+
+	snprintf(number, sizeof(number), "{\"pid\":%ld,\"run_ns\":%llu,\"totals\":{",
+		 (long)getpid(), (unsigned long long)(timing_now() - run_start));
+	line += number;
+	append_phases(line, all);
+	line += '}';
+#ifdef JSON_STATS
+	append_json_stats(line, all.json);
+#endif
+
+	line += ",\"refs\":[";
+	for(size_t ref = 0; ref < ref_totals.size(); ref++)
+	{
+		line += ref ? ",{\"ref\":" : "{\"ref\":";
+		append_quoted(line, ref_totals[ref].name);
+		line += ",\"phases\":{";
+		append_phases(line, ref_totals[ref]);
+		line += '}';
+#ifdef JSON_STATS
+		append_json_stats(line, ref_totals[ref].json);
+#endif
+		line += '}';
+	}
+
+	line += "],\"endpoints\":[";
+	for(size_t endpoint = 0; endpoint < endpoint_totals.size() && endpoint < endpoint_names.size(); endpoint++)
+	{
+		line += endpoint ? ",{\"url\":" : "{\"url\":";
+		append_quoted(line, endpoint_names[endpoint]);
+		line += ",\"phases\":{";
+		append_phases(line, endpoint_totals[endpoint]);
+		line += "}}";
+	}
+	line += "]}\n";
+
+	// one write, so that lines from hooks running at the same time don't mix
+	if(write(timing_fd, line.data(), line.length()) != (ssize_t)line.length())
+		perror("can't write timing log");
+
+	if(timing_fd_owned) close(timing_fd);
+	timing_fd = -1;
+}
+
+
+void timing_finish(void)
+{
+	if(!timing_enabled) return;
+
+	if(timing_fd != -1) write_timing_log();
+
+	if(trace_enabled)
+	{
+		fputs("\n]}\n", trace_file);
+		fclose(trace_file);
+		trace_file = NULL;
+	}
+
+	timing_enabled = false;
+	trace_enabled = false;
+	ref_totals.clear();
+	endpoint_totals.clear();
+	endpoint_names.clear();
+}
@@ -0,0 +1,152 @@
+//
+//  timing.h
+//  RCMP for Real Git
+//
+//  Copyright (c) 2012 Wilcox Technologies LLC. All rights reserved.
+//
+
+#ifndef __rcmp_timing_h_
+#define __rcmp_timing_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*!
+ \brief the parts of a hook run that are timed
+
+ Each one is counted against the ref being processed, and the ones that happen
+ once per URL are also counted against that URL.
+ */
+enum timing_phase
+{
+	PHASE_REPO_OPEN,
+	PHASE_REVWALK,
+	PHASE_DIFF,
+	PHASE_JSON,
+	PHASE_WRITE,
+	PHASE_URLENCODE,
+	PHASE_UPLOAD,
+	PHASE_COUNT
+};
+
+
+/*!
+ \brief whether anything is being timed
+
+ Only set by timing_start, so that a run without a timing log or a trace pays
+ for one branch per phase and never reads the clock.
+ */
+extern bool timing_enabled;
+
+
+/*!
+ \brief whether spans are being written to a trace
+ */
+extern bool trace_enabled;
+
+
+/*!
+ \brief nanoseconds from a clock that never goes backwards
+ */
+uint64_t timing_now(void);
+
+
+/*!
+ \brief turn timing on if it was asked for
+ \param endpoints	the URLs, endpoint indices count from the first one
+ \param count		how many there are
+
+ Timing is on when RCMP_TIMING_LOG names a file to append to, or when
+ RCMP_TIMING_FD names a descriptor that is already open.  Tracing is on when
+ RCMP_TRACE names a file to write Chrome trace events to, which chrome://tracing
+ and Perfetto can load.
+ */
+void timing_start(const char * const *endpoints, size_t count);
+
+
+/*!
+ \brief start counting phases against a ref
+ \param ref_name	the ref as it was read, a trailing newline is dropped
+ */
+void timing_ref(const char *ref_name);
+
+
+/*!
+ \brief count time against a phase
+ \param phase		what the time was spent on
+ \param start		when it started
+ \param end		when it was done
+ \param endpoint	which URL it was for, or -1 if it wasn't for one
+ */
+void timing_add(timing_phase phase, uint64_t start, uint64_t end, int endpoint = -1);
+
+
+/*!
+ \brief write a span to the trace
+ \param name		what it was
+ \param start		when it started
+ \param end		when it was done
+ \param detail	shown with it in the viewer, can be NULL
+ */
+void trace_add(const char *name, uint64_t start, uint64_t end, const char *detail);
+
+
+/*!
+ \brief write everything that was counted as one line, and close the trace
+ */
+void timing_finish(void);
+
+
+/*!
+ \brief times everything until it goes out of scope or is stopped
+ */
+class phase_timer
+{
+public:
+	phase_timer(timing_phase phase, int endpoint = -1) : phase(phase), endpoint(endpoint), start(timing_enabled ? timing_now() : 0) {}
+	~phase_timer() { stop(); }
+
+	void stop()
+	{
+		if(start == 0) return;
+		timing_add(phase, start, timing_now(), endpoint);
+		start = 0;
+	}
+
+private:
+	timing_phase phase;
+	int endpoint;
+	uint64_t start;
+
+	phase_timer(const phase_timer &);
+	phase_timer &operator=(const phase_timer &);
+};
+
+
+/*!
+ \brief a span that only goes in the trace, for what isn't one of the phases
+ */
+class trace_span
+{
+public:
+	trace_span(const char *name, const char *detail = NULL) : name(name), detail(detail), start(trace_enabled ? timing_now() : 0) {}
+	~trace_span() { stop(); }
+
+	void stop()
+	{
+		if(start == 0) return;
+		trace_add(name, start, timing_now(), detail);
+		start = 0;
+	}
+
+private:
+	const char *name;
+	const char *detail;
+	uint64_t start;
+
+	trace_span(const trace_span &);
+	trace_span &operator=(const trace_span &);
+};
+
+#endif